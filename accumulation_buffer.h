@@ -0,0 +1,106 @@
+#ifndef ACCUMULATION_BUFFER_H
+#define ACCUMULATION_BUFFER_H
+
+#include "framebuffer.h"
+#include "vec3.h"
+
+#include <cstdint>
+#include <vector>
+
+// Acumula as amostras de cada pixel: soma das cores, número de amostras e
+// média/variância da luminância (algoritmo de Welford), que permite estimar
+// o erro do pixel e parar de amostrá-lo quando ele convergir.
+class accumulation_buffer {
+  public:
+    int width  = 0;
+    int height = 0;
+    // Pixel da imagem guardado na primeira posição; só muda com resize_window,
+    // nos buffers que cobrem um tile
+    int x0 = 0;
+    int y0 = 0;
+    std::vector<double>   sum;        // Soma das cores, 3 por pixel
+    std::vector<uint32_t> count;      // Amostras já somadas em cada pixel
+    std::vector<double>   lum_mean;   // Média corrente da luminância
+    std::vector<double>   lum_m2;     // Soma dos quadrados dos desvios da luminância
+    std::vector<uint8_t>  converged;  // 1 quando o pixel já atingiu o erro desejado
+
+    void resize(int w, int h) {
+        width = w;
+        height = h;
+        x0 = 0;
+        y0 = 0;
+        size_t n = size_t(w) * h;
+        sum.assign(n * 3, 0.0);
+        count.assign(n, 0);
+        lum_mean.assign(n, 0.0);
+        lum_m2.assign(n, 0.0);
+        converged.assign(n, 0);
+    }
+
+    // Buffer só para a janela [x, x+w) x [y, y+h) da imagem; index() continua
+    // recebendo as coordenadas na imagem
+    void resize_window(int x, int y, int w, int h) {
+        resize(w, h);
+        x0 = x;
+        y0 = y;
+    }
+
+    size_t index(int i, int j) const { return size_t(j - y0) * width + size_t(i - x0); }
+
+    // Zera os pixels do retângulo [x0,x1) x [y0,y1)
+    void clear_region(int x0, int y0, int x1, int y1) {
+        for (int j = y0; j < y1; j++)
+            for (int i = x0; i < x1; i++) {
+                size_t p = index(i, j);
+                sum[3*p] = sum[3*p + 1] = sum[3*p + 2] = 0.0;
+                count[p] = 0;
+                lum_mean[p] = 0.0;
+                lum_m2[p] = 0.0;
+                converged[p] = 0;
+            }
+    }
+
+    void add(size_t pixel, const color& c) {
+        sum[3*pixel]     += c.x();
+        sum[3*pixel + 1] += c.y();
+        sum[3*pixel + 2] += c.z();
+
+        uint32_t n = ++count[pixel];
+        double lum = luminance(c);
+        double delta = lum - lum_mean[pixel];
+        lum_mean[pixel] += delta / n;
+        lum_m2[pixel] += delta * (lum - lum_mean[pixel]);
+    }
+
+    color mean(size_t pixel) const {
+        if (count[pixel] == 0)
+            return color(0,0,0);
+        double scale = 1.0 / count[pixel];
+        return color(sum[3*pixel] * scale, sum[3*pixel + 1] * scale, sum[3*pixel + 2] * scale);
+    }
+
+    // Erro padrão da média da luminância, relativo ao brilho do pixel. Pixels
+    // muito escuros usam um piso no denominador para não exigirem amostras demais.
+    double relative_error(size_t pixel) const {
+        uint32_t n = count[pixel];
+        if (n < 2)
+            return infinity;
+        double variance = lum_m2[pixel] / (n - 1);
+        double std_error = std::sqrt(variance / n);
+        return std_error / std::fmax(lum_mean[pixel], 0.01);
+    }
+
+    // Copia as médias para um framebuffer (do tamanho do buffer)
+    void resolve(framebuffer& image) const {
+        image.resize(width, height);
+        for (int j = 0; j < height; j++)
+            for (int i = 0; i < width; i++)
+                image.set(i, j, mean(size_t(j) * width + i));
+    }
+
+    static double luminance(const color& c) {
+        return 0.2126*c.x() + 0.7152*c.y() + 0.0722*c.z();
+    }
+};
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include "rtweekend.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+// Arena para montar cenas com muitos objetos: cada objeto é construído em
+// sequência dentro de blocos grandes, em vez de numa alocação própria com o
+// bloco de controle do make_shared. Um milhão de esferas vira algumas dezenas
+// de blocos contíguos, sem cabeçalhos entre elas, e tudo é liberado de uma vez
+// quando a arena é destruída (ou em release()).
+//
+// make() retorna um shared_ptr que não é dono do objeto (construído com o
+// construtor de aliasing e um dono vazio, como scene::root() faz), então
+// funciona com hittable_list, bvh e instance sem mudar nada neles e copiá-lo
+// não toca em contador nenhum. Em troca, a arena precisa viver mais que todos
+// os ponteiros que entregou.
+class object_arena {
+  public:
+    explicit object_arena(size_t block_size = size_t(1) << 20) : block_size(block_size) {}
+
+    ~object_arena() { release(); }
+
+    object_arena(const object_arena&) = delete;
+    object_arena& operator=(const object_arena&) = delete;
+
+    template <typename T, typename... Args>
+    shared_ptr<T> make(Args&&... args) {
+        static_assert(alignof(T) <= block_alignment);
+        T* object = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        if constexpr (!std::is_trivially_destructible_v<T>)
+            destructors.push_back({ object, [](void* p) { static_cast<T*>(p)->~T(); } });
+        objects++;
+        return shared_ptr<T>(shared_ptr<T>(), object);
+    }
+
+    // Destrói todos os objetos (na ordem inversa da criação) e devolve os blocos
+    void release() {
+        for (auto k = destructors.size(); k-- > 0;)
+            destructors[k].destroy(destructors[k].object);
+        destructors.clear();
+        for (auto& b : blocks)
+            ::operator delete(b.data, std::align_val_t(block_alignment));
+        blocks.clear();
+        objects = 0;
+        used = 0;
+    }
+
+    size_t object_count() const { return objects; }
+
+    // Bytes ocupados pelos objetos e bytes reservados nos blocos
+    size_t bytes_used() const { return used; }
+    size_t bytes_reserved() const {
+        size_t total = 0;
+        for (const auto& b : blocks)
+            total += b.size;
+        return total;
+    }
+
+  private:
+    // Alinhamento dos blocos: uma linha de cache, que também basta para os
+    // tipos SIMD
+    static constexpr size_t block_alignment = 64;
+
+    struct block {
+        std::byte* data;
+        size_t size;
+        size_t top;  // Primeiro byte livre
+    };
+
+    struct destructor {
+        void* object;
+        void (*destroy)(void*);
+    };
+
+    size_t block_size;
+    std::vector<block> blocks;
+    std::vector<destructor> destructors;
+    size_t objects = 0;
+    size_t used = 0;
+
+    void* allocate(size_t size, size_t alignment) {
+        static_assert(block_alignment % alignof(std::max_align_t) == 0);
+        if (!blocks.empty()) {
+            block& b = blocks.back();
+            size_t start = (b.top + alignment - 1) & ~(alignment - 1);
+            if (start + size <= b.size) {
+                b.top = start + size;
+                used += size;
+                return b.data + start;
+            }
+        }
+        // Objeto maior que um bloco ganha um bloco só para ele
+        size_t bytes = std::max(block_size, size);
+        auto data = static_cast<std::byte*>(::operator new(bytes, std::align_val_t(block_alignment)));
+        blocks.push_back({ data, bytes, size });
+        used += size;
+        return data;
+    }
+};
+
+#endif
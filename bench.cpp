@@ -0,0 +1,487 @@
+#include "rtweekend.h"
+#include "arena.h"
+#include "bvh.h"
+#include "camera.h"
+#include "hittable_list.h"
+#include "material.h"
+#include "scene.h"
+#include "sphere.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if !defined(_WIN32)
+    #include <unistd.h>
+#endif
+
+// Bateria de benchmarks com saída em JSON, para acompanhar o desempenho entre
+// versões. Renderiza as três cenas de referência (scenes/main*.scene, iguais
+// às de main.cpp, main2.cpp e main3.cpp) com semente e tamanho fixos e mede
+// também as peças mais usadas do traçado isoladamente.
+// Uso:
+//   bench [opções] > resultado.json
+//
+// Opções:
+//   -o <arquivo>       Escreve o JSON no arquivo em vez da saída padrão
+//   -t <threads>       Threads das renderizações (padrão: RT_THREADS ou todos os núcleos)
+//   --width <n>        Largura das imagens (padrão: 200)
+//   --spp <n>          Amostras por pixel (padrão: 16)
+//   --scenes <pasta>   Pasta com as cenas de referência (padrão: scenes)
+//   --min-time <s>     Tempo mínimo de cada micro-benchmark (padrão: 0.25)
+//   --wavefront        Renderiza as cenas com o integrador wavefront
+//   --sort-rays        No wavefront, ordena os raios de cada rebote por coerência (camera::sort_rays)
+//   --build-objects <n> Esferas da medida de montagem de cena (padrão: 1000000)
+//   --allocator <tipo> Alocação medida na montagem: arena, make_shared ou both (padrão). Para
+//                      comparar a memória sem interferência, rode um de cada vez
+//   --no-scenes        Sem as cenas de referência
+//   --no-micro         Sem os micro-benchmarks
+//   --no-build         Sem a medida de montagem de cena
+
+using bench_clock = std::chrono::steady_clock;
+
+static double seconds_since(bench_clock::time_point start) {
+    return std::chrono::duration<double>(bench_clock::now() - start).count();
+}
+
+// Evita que o compilador descarte o trabalho medido
+static volatile double bench_sink;
+
+
+struct bench_options {
+    int    num_threads = 0;
+    int    image_width = 200;
+    int    samples_per_pixel = 16;
+    double min_time = 0.25;
+    std::string scene_dir = "scenes";
+    size_t build_objects = 1000000;
+    std::string allocator = "both";
+    bool   scenes = true;
+    bool   micro = true;
+    bool   build = true;
+    integrator_type integrator = integrator_type::path;
+    bool   sort_rays = false;
+};
+
+struct scene_result {
+    std::string name;
+    int      width, height, samples_per_pixel, threads;
+    double   load_ms, render_s;
+    uint64_t samples, rays;
+};
+
+struct micro_result {
+    std::string name;
+    uint64_t ops;          // Operações medidas
+    double   ns_per_op;
+    double   ns_per_intersection;  // Só nos testes de interseção (0 nos outros)
+};
+
+
+struct build_result {
+    std::string allocator;
+    size_t   objects;
+    double   build_ms;     // Criação dos objetos e da hittable_list
+    double   bvh_ms;       // Construção da BVH sobre a lista
+    double   rss_mb;       // Memória residente acrescentada pelos objetos, pela lista e pela BVH
+    double   ns_per_ray;   // Traçado de raios aleatórios pela BVH
+    double   release_ms;   // Destruição de tudo
+};
+
+
+// Roda 'body(n)' (que executa n operações) com lotes cada vez maiores até
+// passar de min_time segundos. Retorna o tempo por operação em ns.
+template <typename Body>
+static double measure(double min_time, Body&& body, uint64_t& ops) {
+    body(1024);  // Aquece caches e preditores
+    uint64_t n = 1024;
+    for (;;) {
+        auto start = bench_clock::now();
+        body(n);
+        double elapsed = seconds_since(start);
+        if (elapsed >= min_time || n >= (uint64_t(1) << 36)) {
+            ops = n;
+            return elapsed * 1e9 / double(n);
+        }
+        // Estima o lote que atinge o tempo mínimo, no máximo 10x maior
+        double grow = (elapsed > 0) ? std::fmin(10.0, 1.2 * min_time / elapsed) : 10.0;
+        n = uint64_t(double(n) * std::fmax(grow, 2.0));
+    }
+}
+
+
+static bool run_scene(const bench_options& opts, const std::string& name, scene_result& out) {
+    std::string path = opts.scene_dir + "/" + name + ".scene";
+    scene world;
+    std::string error;
+
+    auto start = bench_clock::now();
+    if (!load_scene(path, world, error)) {
+        std::cerr << path << ": " << error << '\n';
+        return false;
+    }
+    double load_ms = seconds_since(start) * 1e3;
+
+    camera& cam = world.cam;
+    cam.image_width = opts.image_width;
+    cam.samples_per_pixel = opts.samples_per_pixel;
+    cam.num_threads = opts.num_threads;
+    cam.seed = 1;
+    cam.adaptive_sampling = false;
+    cam.progressive_passes = 1;
+    cam.integrator = opts.integrator;
+    cam.sort_rays = opts.sort_rays;
+
+    framebuffer image;
+    start = bench_clock::now();
+    cam.render(world.root(), world.materials, image);
+    double render_s = seconds_since(start);
+
+    out.name = name;
+    out.width = image.width;
+    out.height = image.height;
+    out.samples_per_pixel = opts.samples_per_pixel;
+    out.threads = thread_pool(opts.num_threads).size();
+    out.load_ms = load_ms;
+    out.render_s = render_s;
+    out.samples = cam.samples_taken();
+    out.rays = cam.rays_traced();
+    return true;
+}
+
+
+// Raios partindo de fora da esfera unitária na origem, metade deles mirando nela
+static std::vector<ray> make_test_rays(size_t n) {
+    std::vector<ray> rays;
+    rays.reserve(n);
+    for (size_t k = 0; k < n; k++) {
+        point3 origin = 5.0 * random_unit_vector();
+        point3 target = (k % 2 == 0) ? 0.5 * random_unit_vector() : 3.0 * random_unit_vector();
+        rays.push_back(ray(origin, target - origin));
+    }
+    return rays;
+}
+
+static void run_micro(const bench_options& opts, std::vector<micro_result>& results) {
+    seed_random(1);
+    const size_t ray_count = 4096;
+    auto rays = make_test_rays(ray_count);
+
+    auto add = [&](const std::string& name, double ns, uint64_t ops, double per_intersection) {
+        results.push_back({name, ops, ns, per_intersection});
+        std::clog << name << ": " << ns << " ns/op\n";
+    };
+
+    uint64_t ops;
+    double ns;
+
+    // sphere::hit
+    {
+        sphere s(point3(0,0,0), 1.0, 0);
+        ns = measure(opts.min_time, [&](uint64_t n) {
+            hit_record rec;
+            double acc = 0;
+            for (uint64_t k = 0; k < n; k++)
+                if (s.hit(rays[k % ray_count], interval(0.001, infinity), rec))
+                    acc += rec.t;
+            bench_sink = acc;
+        }, ops);
+        add("sphere_hit", ns, ops, ns);
+    }
+
+    // hittable_list::hit com uma lista de esferas espalhadas, sem BVH
+    {
+        const int sphere_count = 64;
+        hittable_list list;
+        for (int k = 0; k < sphere_count; k++)
+            list.add(make_shared<sphere>(point3(random_double(-3,3), random_double(-3,3), random_double(-3,3)),
+                                         random_double(0.05, 0.3), 0));
+        ns = measure(opts.min_time, [&](uint64_t n) {
+            hit_record rec;
+            double acc = 0;
+            for (uint64_t k = 0; k < n; k++)
+                if (list.hit(rays[k % ray_count], interval(0.001, infinity), rec))
+                    acc += rec.t;
+            bench_sink = acc;
+        }, ops);
+        add("hittable_list_hit_64", ns, ops, ns / sphere_count);
+    }
+
+    // material::scatter de cada tipo, num ponto fixo com raios incidentes variados
+    {
+        hit_record rec;
+        rec.p = point3(0,0,0);
+        rec.t = 1;
+        std::vector<ray> incoming;
+        for (size_t k = 0; k < ray_count; k++) {
+            auto d = random_unit_vector();
+            incoming.push_back(ray(point3(0,1,0), vec3(d.x(), -std::fabs(d.y()) - 0.01, d.z())));
+        }
+
+        struct { const char* name; material mat; } materials[] = {
+            {"scatter_lambertian", lambertian(color(0.5, 0.5, 0.5))},
+            {"scatter_metal",      metal(color(0.8, 0.6, 0.2), 0.3)},
+            {"scatter_dielectric", dielectric(1.5)},
+        };
+        for (auto& m : materials) {
+            ns = measure(opts.min_time, [&](uint64_t n) {
+                color attenuation;
+                ray scattered;
+                double acc = 0;
+                for (uint64_t k = 0; k < n; k++) {
+                    const ray& r = incoming[k % ray_count];
+                    rec.set_face_normal(r, vec3(0,1,0));
+                    if (m.mat.scatter(r, rec, attenuation, scattered))
+                        acc += scattered.direction().y();
+                }
+                bench_sink = acc;
+            }, ops);
+            add(m.name, ns, ops, 0);
+        }
+    }
+
+    // Amostradores
+    ns = measure(opts.min_time, [&](uint64_t n) {
+        double acc = 0;
+        for (uint64_t k = 0; k < n; k++)
+            acc += random_unit_vector().x();
+        bench_sink = acc;
+    }, ops);
+    add("random_unit_vector", ns, ops, 0);
+
+    ns = measure(opts.min_time, [&](uint64_t n) {
+        double acc = 0;
+        for (uint64_t k = 0; k < n; k++)
+            acc += random_in_unit_disk().x();
+        bench_sink = acc;
+    }, ops);
+    add("random_in_unit_disk", ns, ops, 0);
+
+    // Amostras de baixa discrepância (Sobol embaralhado), como usadas pela câmera
+    ns = measure(opts.min_time, [&](uint64_t n) {
+        double acc = 0;
+        path_sampler sampler;
+        for (uint64_t k = 0; k < n; k++) {
+            sampler.start(sample_pattern::sobol, 1, k >> 6, uint32_t(k & 63));
+            auto s = sampler.get_2d();
+            acc += sample_unit_sphere(s.u, s.v).x();
+        }
+        bench_sink = acc;
+    }, ops);
+    add("sobol_unit_vector", ns, ops, 0);
+}
+
+
+// Memória residente do processo em MB (0 onde /proc não existe)
+static double resident_mb() {
+#if !defined(_WIN32)
+    std::ifstream statm("/proc/self/statm");
+    double pages_total, pages_resident;
+    if (statm >> pages_total >> pages_resident)
+        return pages_resident * double(sysconf(_SC_PAGESIZE)) / (1024.0 * 1024.0);
+#endif
+    return 0;
+}
+
+// Monta uma cena de esferas soltas (uma alocação por esfera, como nos
+// main*.cpp) numa hittable_list com BVH, alocando as esferas com make_shared
+// ou com uma object_arena, e mede a montagem, a memória, o traçado e a
+// destruição. Com as duas no mesmo processo, a arena é medida primeiro: o
+// heap que o make_shared deixa depois de liberado seria reaproveitado e
+// esconderia a memória da outra.
+static void run_build(const bench_options& opts, std::vector<build_result>& results) {
+    const size_t n = opts.build_objects;
+    const double extent = std::cbrt(double(n)) * 2;
+
+    seed_random(2);
+    const size_t ray_count = 4096;
+    std::vector<ray> rays;
+    for (size_t k = 0; k < ray_count; k++) {
+        point3 origin = extent * random_unit_vector();
+        rays.push_back(ray(origin, extent * 0.5 * random_unit_vector() - origin));
+    }
+
+    for (bool use_arena : { true, false }) {
+        if (opts.allocator != "both" && opts.allocator != (use_arena ? "arena" : "make_shared"))
+            continue;
+        build_result r;
+        r.allocator = use_arena ? "arena" : "make_shared";
+        r.objects = n;
+        seed_random(3);
+        double rss_start = resident_mb();
+
+        auto arena = std::make_unique<object_arena>();
+        auto list = std::make_unique<hittable_list>();
+        auto start = bench_clock::now();
+        list->objects.reserve(n);
+        for (size_t k = 0; k < n; k++) {
+            point3 center(random_double(-extent, extent), random_double(-extent, extent),
+                          random_double(-extent, extent));
+            double radius = random_double(0.1, 0.6);
+            if (use_arena)
+                list->add(arena->make<sphere>(center, radius, 0));
+            else
+                list->add(make_shared<sphere>(center, radius, 0));
+        }
+        r.build_ms = seconds_since(start) * 1e3;
+
+        start = bench_clock::now();
+        auto tree = std::make_unique<bvh>(*list);
+        r.bvh_ms = seconds_since(start) * 1e3;
+        r.rss_mb = resident_mb() - rss_start;
+
+        uint64_t ops;
+        r.ns_per_ray = measure(opts.min_time, [&](uint64_t count) {
+            hit_record rec;
+            double acc = 0;
+            for (uint64_t k = 0; k < count; k++)
+                if (tree->hit(rays[k % ray_count], interval(0.001, infinity), rec))
+                    acc += rec.t;
+            bench_sink = acc;
+        }, ops);
+
+        start = bench_clock::now();
+        tree.reset();
+        list.reset();
+        arena.reset();
+        r.release_ms = seconds_since(start) * 1e3;
+
+        std::clog << "montagem com " << r.allocator << ": " << r.build_ms << " ms, BVH " << r.bvh_ms << " ms, "
+                  << r.rss_mb << " MB, " << r.ns_per_ray << " ns/raio, destruição " << r.release_ms << " ms\n";
+        results.push_back(r);
+    }
+}
+
+
+static void write_json(std::ostream& out, const bench_options& opts,
+                       const std::vector<scene_result>& scenes, const std::vector<micro_result>& micro,
+                       const std::vector<build_result>& builds) {
+    out << "{\n";
+    out << "  \"precision\": \"" << RT_PRECISION_NAME << "\",\n";
+    out << "  \"simd\": \"" << RT_SIMD_NAME << "\",\n";
+    out << "  \"integrator\": \"" << (opts.integrator == integrator_type::path ? "path" : "wavefront") << "\",\n";
+    out << "  \"sort_rays\": " << (opts.sort_rays ? "true" : "false") << ",\n";
+    out << "  \"seed\": 1,\n";
+    out << "  \"min_time_s\": " << opts.min_time << ",\n";
+
+    out << "  \"scenes\": [";
+    for (size_t k = 0; k < scenes.size(); k++) {
+        const auto& s = scenes[k];
+        double mrays = double(s.rays) / s.render_s / 1e6;
+        out << (k ? ",\n" : "\n")
+            << "    {\"name\": \"" << s.name << "\""
+            << ", \"width\": " << s.width
+            << ", \"height\": " << s.height
+            << ", \"samples_per_pixel\": " << s.samples_per_pixel
+            << ", \"threads\": " << s.threads
+            << ", \"load_ms\": " << s.load_ms
+            << ", \"render_s\": " << s.render_s
+            << ", \"samples\": " << s.samples
+            << ", \"rays\": " << s.rays
+            << ", \"samples_per_s\": " << double(s.samples) / s.render_s
+            << ", \"mrays_per_s\": " << mrays
+            << ", \"ns_per_ray\": " << 1e9 * s.render_s / double(s.rays) << "}";
+    }
+    out << (scenes.empty() ? "],\n" : "\n  ],\n");
+
+    out << "  \"micro\": [";
+    for (size_t k = 0; k < micro.size(); k++) {
+        const auto& m = micro[k];
+        out << (k ? ",\n" : "\n")
+            << "    {\"name\": \"" << m.name << "\""
+            << ", \"ops\": " << m.ops
+            << ", \"ns_per_op\": " << m.ns_per_op;
+        if (m.ns_per_intersection > 0)
+            out << ", \"ns_per_intersection\": " << m.ns_per_intersection;
+        out << "}";
+    }
+    out << (micro.empty() ? "],\n" : "\n  ],\n");
+
+    out << "  \"build\": [";
+    for (size_t k = 0; k < builds.size(); k++) {
+        const auto& b = builds[k];
+        out << (k ? ",\n" : "\n")
+            << "    {\"allocator\": \"" << b.allocator << "\""
+            << ", \"objects\": " << b.objects
+            << ", \"build_ms\": " << b.build_ms
+            << ", \"bvh_ms\": " << b.bvh_ms
+            << ", \"rss_mb\": " << b.rss_mb
+            << ", \"ns_per_ray\": " << b.ns_per_ray
+            << ", \"release_ms\": " << b.release_ms << "}";
+    }
+    out << (builds.empty() ? "]\n" : "\n  ]\n");
+    out << "}\n";
+}
+
+
+static void usage() {
+    std::cerr << "Uso: bench [-o saida.json] [-t threads] [--width n] [--spp n] [--scenes pasta]"
+                 " [--min-time s] [--build-objects n] [--allocator arena|make_shared|both] [--no-scenes] [--no-micro] [--no-build] [--wavefront [--sort-rays]]\n";
+}
+
+int main(int argc, char** argv) {
+    bench_options opts;
+    std::string output_path;
+
+    for (int k = 1; k < argc; k++) {
+        std::string arg = argv[k];
+        if (arg == "--no-scenes") { opts.scenes = false; continue; }
+        if (arg == "--no-micro")  { opts.micro = false; continue; }
+        if (arg == "--no-build")  { opts.build = false; continue; }
+        if (arg == "--wavefront") { opts.integrator = integrator_type::wavefront; continue; }
+        if (arg == "--sort-rays") { opts.sort_rays = true; continue; }
+        if (k + 1 >= argc) {
+            usage();
+            return 1;
+        }
+        std::string value = argv[++k];
+
+        if (arg == "-o")              output_path = value;
+        else if (arg == "-t")         opts.num_threads = std::atoi(value.c_str());
+        else if (arg == "--width")    opts.image_width = std::atoi(value.c_str());
+        else if (arg == "--spp")      opts.samples_per_pixel = std::atoi(value.c_str());
+        else if (arg == "--scenes")   opts.scene_dir = value;
+        else if (arg == "--min-time") opts.min_time = std::atof(value.c_str());
+        else if (arg == "--build-objects") opts.build_objects = std::strtoull(value.c_str(), nullptr, 10);
+        else if (arg == "--allocator" && (value == "arena" || value == "make_shared" || value == "both"))
+            opts.allocator = value;
+        else {
+            usage();
+            return 1;
+        }
+    }
+
+    std::vector<scene_result> scenes;
+    if (opts.scenes) {
+        for (const char* name : {"main", "main2", "main3"}) {
+            scene_result result;
+            if (!run_scene(opts, name, result))
+                return 1;
+            std::clog << name << ": " << double(result.rays) / result.render_s / 1e6 << " Mraios/s\n";
+            scenes.push_back(result);
+        }
+    }
+
+    std::vector<micro_result> micro;
+    if (opts.micro)
+        run_micro(opts, micro);
+
+    std::vector<build_result> builds;
+    if (opts.build)
+        run_build(opts, builds);
+
+    if (output_path.empty()) {
+        write_json(std::cout, opts, scenes, micro, builds);
+    } else {
+        std::ofstream file(output_path);
+        write_json(file, opts, scenes, micro, builds);
+        if (!file) {
+            std::cerr << "Erro ao escrever " << output_path << '\n';
+            return 1;
+        }
+    }
+}
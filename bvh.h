@@ -0,0 +1,407 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include "aabb.h"
+#include "hittable.h"
+#include "hittable_list.h"
+#include "render_stats.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+
+// Nó da BVH, guardado num vetor plano em pré-ordem: o filho esquerdo de um nó
+// interno vem logo depois dele e o direito fica em 'offset'. Numa folha,
+// 'offset' é a posição do primeiro primitivo e 'count' é quantos ela tem.
+// Com 64 bytes, cada nó ocupa exatamente uma linha de cache. As caixas usam a
+// precisão do renderizador (real).
+struct alignas(64) bvh_node {
+    real     bmin[3];
+    real     bmax[3];
+    uint32_t offset;
+    uint32_t count;   // 0 para nós internos
+    uint32_t axis;    // Eixo da divisão, usado para visitar primeiro o filho mais próximo
+};
+
+// Estrutura da BVH, independente do tipo de primitivo. É construída a partir das
+// caixas dos primitivos e diz em que ordem eles devem ser guardados, para que
+// cada folha aponte para um trecho contíguo.
+class bvh_tree {
+  public:
+    std::vector<bvh_node> nodes;
+    std::vector<uint32_t> order;  // order[k] = índice original do k-ésimo primitivo
+
+    // Constrói a árvore com a heurística de área de superfície (SAH) avaliada em
+    // compartimentos (binning) ao longo dos três eixos
+    //
+    // group_size > 1 indica que as folhas testam os primitivos em grupos (SIMD):
+    // o custo de uma folha passa a ser o número de grupos, não de primitivos.
+    void build(const std::vector<aabb>& boxes, int max_leaf_size = 4, int group_size = 1) {
+        nodes.clear();
+        order.resize(boxes.size());
+        std::iota(order.begin(), order.end(), 0u);
+        if (boxes.empty())
+            return;
+
+        std::vector<point3> centroids(boxes.size());
+        for (size_t k = 0; k < boxes.size(); k++)
+            centroids[k] = boxes[k].centroid();
+
+        nodes.reserve(2 * boxes.size() / std::max(1, max_leaf_size) + 1);
+
+        // Pilha explícita em vez de recursão, para não estourar a pilha com
+        // milhões de primitivos. O filho direito corrige 'offset' do pai quando
+        // é criado.
+        struct build_task {
+            uint32_t begin, end, parent;
+            bool     right;
+            int      depth;
+        };
+        std::vector<build_task> stack;
+        stack.push_back({0, uint32_t(boxes.size()), 0, false, 0});
+
+        while (!stack.empty()) {
+            auto task = stack.back();
+            stack.pop_back();
+
+            auto index = uint32_t(nodes.size());
+            nodes.emplace_back();
+            if (task.right)
+                nodes[task.parent].offset = index;
+
+            aabb bounds;
+            point3 cmin( infinity,  infinity,  infinity);
+            point3 cmax(-infinity, -infinity, -infinity);
+            for (auto k = task.begin; k < task.end; k++) {
+                bounds = aabb(bounds, boxes[order[k]]);
+                const point3& c = centroids[order[k]];
+                for (int a = 0; a < 3; a++) {
+                    cmin[a] = std::fmin(cmin[a], c[a]);
+                    cmax[a] = std::fmax(cmax[a], c[a]);
+                }
+            }
+
+            bvh_node& node = nodes[index];
+            for (int a = 0; a < 3; a++) {
+                node.bmin[a] = bounds.axis_interval(a).min;
+                node.bmax[a] = bounds.axis_interval(a).max;
+            }
+
+            int axis = 0;
+            auto mid = split(task.begin, task.end, task.depth, max_leaf_size, group_size,
+                             bounds, cmin, cmax, boxes, centroids, axis);
+
+            if (mid == task.begin || mid == task.end) {
+                node.offset = task.begin;
+                node.count  = task.end - task.begin;
+                continue;
+            }
+
+            node.count = 0;
+            node.axis  = uint32_t(axis);
+            stack.push_back({mid, task.end, index, true, task.depth + 1});
+            stack.push_back({task.begin, mid, index, false, task.depth + 1});
+        }
+    }
+
+    // Percorre a árvore visitando só os nós cuja caixa o raio atinge. Para cada
+    // folha atingida chama hit_leaf(first, count, ray_t), que deve testar os
+    // primitivos [first, first+count) e reduzir ray_t.max ao encontrar um acerto.
+    // Com any_hit, o percurso termina no primeiro acerto (raios de sombra).
+    template <bool any_hit = false, typename leaf_fn>
+    bool traverse(const ray& r, interval ray_t, leaf_fn&& hit_leaf) const {
+        if (nodes.empty())
+            return false;
+
+        const point3& orig = r.origin();
+        const vec3& dir = r.direction();
+        const real inv_dir[3] = { 1 / dir[0], 1 / dir[1], 1 / dir[2] };
+        const bool dir_neg[3] = { inv_dir[0] < 0, inv_dir[1] < 0, inv_dir[2] < 0 };
+
+        uint32_t stack[stack_size];
+        int stack_top = 0;
+        uint32_t current = 0;
+        bool hit_anything = false;
+
+        while (true) {
+            const bvh_node& node = nodes[current];
+            RT_STAT(bvh_nodes_visited++);
+
+            if (hit_node(node, orig, inv_dir, ray_t)) {
+                if (node.count > 0) {
+                    if (hit_leaf(node.offset, node.count, ray_t)) {
+                        if constexpr (any_hit)
+                            return true;
+                        hit_anything = true;
+                    }
+                } else {
+                    // Visita primeiro o filho que está mais perto ao longo do raio
+                    if (dir_neg[node.axis]) {
+                        stack[stack_top++] = current + 1;
+                        current = node.offset;
+                    } else {
+                        stack[stack_top++] = node.offset;
+                        current = current + 1;
+                    }
+                    continue;
+                }
+            }
+
+            if (stack_top == 0)
+                break;
+            current = stack[--stack_top];
+        }
+
+        return hit_anything;
+    }
+
+    // Percurso que termina no primeiro acerto: hit_leaf(first, count, ray_t) só
+    // precisa dizer se algum primitivo da folha é atingido dentro de ray_t
+    template <typename leaf_fn>
+    bool occluded(const ray& r, interval ray_t, leaf_fn&& hit_leaf) const {
+        return traverse<true>(r, ray_t, hit_leaf);
+    }
+
+    // Tamanho da pilha de percurso, que limita a profundidade da árvore
+    static constexpr int stack_size = 128;
+
+    aabb bounds() const {
+        if (nodes.empty())
+            return aabb();
+        const bvh_node& root = nodes[0];
+        return aabb(interval(root.bmin[0], root.bmax[0]),
+                    interval(root.bmin[1], root.bmax[1]),
+                    interval(root.bmin[2], root.bmax[2]));
+    }
+
+  private:
+    static constexpr int bin_count = 16;
+    // A partir dessa profundidade a divisão passa a ser pela mediana, que limita
+    // a altura da árvore (e a pilha de percurso) mesmo em cenas degeneradas
+    static constexpr int sah_max_depth = 64;
+
+    // A saída de cada slab é aumentada pelo erro de arredondamento das duas
+    // operações, para que um raio que passa rente à caixa não a perca (o que em
+    // float acontece com frequência visível)
+    static bool hit_node(const bvh_node& node, const point3& orig, const real inv_dir[3], interval ray_t) {
+        constexpr real exit_scale = 1 + 2 * rounding_error<real>(3);
+        for (int a = 0; a < 3; a++) {
+            auto t0 = (node.bmin[a] - orig[a]) * inv_dir[a];
+            auto t1 = (node.bmax[a] - orig[a]) * inv_dir[a];
+            if (t0 > t1) std::swap(t0, t1);
+            t1 *= exit_scale;
+            if (t0 > ray_t.min) ray_t.min = t0;
+            if (t1 < ray_t.max) ray_t.max = t1;
+            if (ray_t.max <= ray_t.min)
+                return false;
+        }
+        return true;
+    }
+
+    // Escolhe onde dividir order[begin, end). Retorna o meio da partição, ou
+    // begin quando o nó deve virar folha.
+    uint32_t split(uint32_t begin, uint32_t end, int depth, int max_leaf_size, int group_size,
+                   const aabb& bounds, const point3& cmin, const point3& cmax,
+                   const std::vector<aabb>& boxes, const std::vector<point3>& centroids,
+                   int& axis)
+    {
+        auto count = end - begin;
+        if (count <= 1)
+            return begin;
+
+        // Centroides todos no mesmo ponto: não há divisão espacial possível
+        int longest = 0;
+        for (int a = 1; a < 3; a++)
+            if (cmax[a] - cmin[a] > cmax[longest] - cmin[longest])
+                longest = a;
+        if (cmax[longest] - cmin[longest] <= 0) {
+            if (count <= uint32_t(max_leaf_size))
+                return begin;
+            axis = longest;
+            return begin + count/2;
+        }
+
+        if (depth >= sah_max_depth)
+            return median_split(begin, end, longest, centroids, axis);
+
+        // Avalia o custo SAH de cada fronteira entre compartimentos, nos três eixos
+        double best_cost = infinity;
+        int best_axis = -1, best_split = 0;
+
+        for (int a = 0; a < 3; a++) {
+            double extent = cmax[a] - cmin[a];
+            if (extent <= 0)
+                continue;
+
+            aabb bin_bounds[bin_count];
+            uint32_t bin_counts[bin_count] = {};
+            for (auto k = begin; k < end; k++) {
+                int b = bin_index(centroids[order[k]][a], cmin[a], extent);
+                bin_counts[b]++;
+                bin_bounds[b] = aabb(bin_bounds[b], boxes[order[k]]);
+            }
+
+            // Varredura da direita para a esquerda acumulando área x contagem
+            double right_cost[bin_count];
+            aabb right_box;
+            uint32_t right_count = 0;
+            for (int b = bin_count - 1; b > 0; b--) {
+                right_box = aabb(right_box, bin_bounds[b]);
+                right_count += bin_counts[b];
+                right_cost[b] = right_box.surface_area() * groups(right_count, group_size);
+            }
+
+            aabb left_box;
+            uint32_t left_count = 0;
+            for (int b = 0; b < bin_count - 1; b++) {
+                left_box = aabb(left_box, bin_bounds[b]);
+                left_count += bin_counts[b];
+                if (left_count == 0 || left_count == count)
+                    continue;
+                double cost = left_box.surface_area() * groups(left_count, group_size) + right_cost[b+1];
+                if (cost < best_cost) {
+                    best_cost = cost;
+                    best_axis = a;
+                    best_split = b + 1;
+                }
+            }
+        }
+
+        if (best_axis < 0)
+            return median_split(begin, end, longest, centroids, axis);
+
+        // Custo relativo: 1 para percorrer o nó + testes esperados nos filhos,
+        // contra os testes da própria folha se o nó não for dividido
+        double area = bounds.surface_area();
+        double leaf_cost = groups(count, group_size);
+        double split_cost = 1.0 + (area > 0 ? best_cost / area : leaf_cost);
+        if (split_cost >= leaf_cost && count <= uint32_t(max_leaf_size))
+            return begin;
+
+        double extent = cmax[best_axis] - cmin[best_axis];
+        auto it = std::partition(order.begin() + begin, order.begin() + end,
+            [&](uint32_t k) {
+                return bin_index(centroids[k][best_axis], cmin[best_axis], extent) < best_split;
+            });
+        auto mid = uint32_t(it - order.begin());
+
+        if (mid == begin || mid == end)
+            return median_split(begin, end, longest, centroids, axis);
+
+        axis = best_axis;
+        return mid;
+    }
+
+    uint32_t median_split(uint32_t begin, uint32_t end, int a,
+                          const std::vector<point3>& centroids, int& axis)
+    {
+        auto mid = begin + (end - begin)/2;
+        std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end,
+            [&](uint32_t i, uint32_t j) { return centroids[i][a] < centroids[j][a]; });
+        axis = a;
+        return mid;
+    }
+
+    static double groups(uint32_t count, int group_size) {
+        return double((count + uint32_t(group_size) - 1) / uint32_t(group_size));
+    }
+
+    static int bin_index(double c, double cmin, double extent) {
+        int b = int(bin_count * ((c - cmin) / extent));
+        return std::min(std::max(b, 0), bin_count - 1);
+    }
+};
+
+// Confere os nós de uma BVH lida de arquivo antes do uso, para que um arquivo
+// corrompido não leve o percurso para fora dos arrays nem a um laço. Refaz o
+// layout em pré-ordem do build(): cada nó cobre um trecho [i, fim) do vetor,
+// o filho esquerdo de um nó interno é i+1 e o direito começa em 'offset',
+// estritamente dentro do trecho. Assim cada nó é alcançado uma vez só, e a
+// profundidade é limitada ao que cabe na pilha de traverse().
+inline bool valid_bvh_nodes(const bvh_node* nodes, size_t node_count, uint64_t primitive_count) {
+    if (node_count == 0)
+        return true;
+
+    struct range { size_t begin, end; int depth; };
+    std::vector<range> pending;
+    pending.push_back({0, node_count, 0});
+    while (!pending.empty()) {
+        auto [i, end, depth] = pending.back();
+        pending.pop_back();
+        const bvh_node& node = nodes[i];
+
+        if (node.count > 0) {
+            if (end != i + 1 || uint64_t(node.offset) + node.count > primitive_count)
+                return false;
+            continue;
+        }
+
+        // Um nó interno na profundidade d deixa d+1 entradas na pilha do percurso
+        if (depth + 1 > bvh_tree::stack_size || node.axis >= 3
+            || i + 1 >= end || node.offset <= i + 1 || node.offset >= end)
+            return false;
+        pending.push_back({i + 1, node.offset, depth + 1});
+        pending.push_back({node.offset, end, depth + 1});
+    }
+    return true;
+}
+
+inline bool valid_bvh_nodes(const std::vector<bvh_node>& nodes, uint64_t primitive_count) {
+    return valid_bvh_nodes(nodes.data(), nodes.size(), primitive_count);
+}
+
+// Hittable que organiza uma lista de objetos numa BVH, para que o custo de
+// cada raio cresça com log(n) em vez de n
+class bvh : public hittable {
+  public:
+    bvh(const hittable_list& list) : bvh(list.objects) {}
+
+    bvh(const std::vector<shared_ptr<hittable>>& src_objects) {
+        std::vector<aabb> boxes;
+        boxes.reserve(src_objects.size());
+        for (const auto& object : src_objects)
+            boxes.push_back(object->bounding_box());
+
+        tree.build(boxes);
+
+        // Guarda os objetos na ordem das folhas
+        objects.reserve(src_objects.size());
+        for (auto index : tree.order)
+            objects.push_back(src_objects[index]);
+
+        bbox = tree.bounds();
+    }
+
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        return tree.traverse(r, ray_t, [&](uint32_t first, uint32_t count, interval& t) {
+            bool hit_anything = false;
+            for (auto k = first; k < first + count; k++) {
+                if (objects[k]->hit(r, t, rec)) {
+                    hit_anything = true;
+                    t.max = rec.t;  // Só aceita acertos mais próximos daqui em diante
+                }
+            }
+            return hit_anything;
+        });
+    }
+
+    bool hit_any(const ray& r, interval ray_t) const override {
+        return tree.occluded(r, ray_t, [&](uint32_t first, uint32_t count, interval& t) {
+            for (auto k = first; k < first + count; k++)
+                if (objects[k]->hit_any(r, t))
+                    return true;
+            return false;
+        });
+    }
+
+    aabb bounding_box() const override { return bbox; }
+
+  private:
+    std::vector<shared_ptr<hittable>> objects;
+    bvh_tree tree;
+    aabb bbox;
+};
+
+#endif
@@ -1,9 +1,40 @@
 #ifndef CAMERA_H
 #define CAMERA_H
 
+#include "accumulation_buffer.h"
+#include "camera_path.h"
+#include "checkpoint.h"
 #include "hittable.h"
 #include "color.h"
+#include "denoiser.h"
+#include "framebuffer.h"
+#include "frame_writer.h"
+#include "image_writer.h"
+#include "lights.h"
 #include "material.h"
+#include "render_stats.h"
+#include "sampler.h"
+#include "streamed_image.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <numeric>
+#include <string>
+#include <vector>
+
+
+// Como os caminhos de cada tile são seguidos: um por vez, do raio da câmera até
+// o fim (path), ou em ondas (wavefront), com o mesmo rebote de muitos caminhos
+// feito junto, etapa por etapa. As duas formas geram a mesma imagem.
+enum class integrator_type {
+    path,
+    wavefront
+};
 
 
 class camera {
@@ -31,39 +62,360 @@ class camera {
       double focus_dist = 10;    // Distância para o plano de foco perfeito
 
 
-      // Renderiza a cena
-      void render(const hittable& world) {
+      // Rebotes antes de a roleta russa poder encerrar um caminho (>= max_depth desliga)
+      int    russian_roulette_depth = 3;  // Rebotes antes de a roleta russa poder encerrar um caminho (>= max_depth desliga)
+      // Multiplica o gradiente do céu (0 deixa só as luzes da cena)
+      double sky_intensity = 1;           // Multiplica o gradiente do céu (0 deixa só as luzes da cena)
+
+      // Amostragem direta das luzes nos acertos difusos, combinada por MIS com a do material
+      bool   light_sampling = true;       // Amostragem direta das luzes nos acertos difusos, combinada por MIS com a do material
+      // Luzes da cena, para a amostragem direta (nulo ou vazio desliga)
+      const light_list* lights = nullptr;  // Luzes da cena, para a amostragem direta (nulo ou vazio desliga)
+
+
+      // Número de threads de renderização (0 = RT_THREADS ou todos os núcleos)
+      int    num_threads = 0;  // Número de threads de renderização (0 = RT_THREADS ou todos os núcleos)
+      // Lado dos tiles quadrados em que a imagem é dividida
+      int    tile_size   = 16; // Lado dos tiles quadrados em que a imagem é dividida
+      // Semente do gerador aleatório; a mesma semente gera a mesma imagem
+      uint64_t seed    = 0;    // Semente do gerador aleatório; a mesma semente gera a mesma imagem
+      // Origem dos números de cada amostra: sequência de Sobol (menos ruído) ou aleatórios independentes
+      sample_pattern sampler = sample_pattern::sobol;  // Origem dos números de cada amostra: sequência de Sobol (menos ruído) ou aleatórios independentes
+
+
+      // Formato da imagem gerada por render(world, materials)
+      image_format output_format = image_format::ppm;  // Formato da imagem gerada por render(world, materials)
+      // Arquivo de saída; vazio escreve na saída padrão
+      std::string  output_file;                        // Arquivo de saída; vazio escreve na saída padrão
+
+
+      // Amostragem adaptativa: cada pixel recebe entre min_samples e samples_per_pixel
+      // amostras e para quando o erro estimado fica abaixo de adaptive_threshold
+      bool   adaptive_sampling  = false; // Amostragem adaptativa por pixel
+      // Amostras mínimas por pixel antes de testar a convergência
+      int    min_samples        = 16;    // Amostras mínimas por pixel antes de testar a convergência
+      // Erro padrão relativo máximo da luminância de um pixel convergido
+      double adaptive_threshold = 0.01;  // Erro padrão relativo máximo da luminância de um pixel convergido
+      // Número de passes progressivos quando a amostragem não é adaptativa
+      int    progressive_passes = 1;     // Número de passes progressivos quando a amostragem não é adaptativa
+
+      // Chamada ao fim de cada passe com a imagem parcial (opcional)
+      std::function<void(const framebuffer& image, int pass)> on_pass;
+
+
+      // Filtro de ruído: guarda o albedo, a normal e a profundidade do primeiro
+      // acerto de cada amostra e filtra a imagem de cada passe guiado por eles
+      bool   denoise = false;         // Filtro de ruído à-trous guiado pelos dados do primeiro acerto
+      // Iterações do filtro; o alcance dobra a cada uma (5 chegam a 62 pixels)
+      int    denoise_iterations = 5;  // Iterações do filtro; o alcance dobra a cada uma (5 chegam a 62 pixels)
+
+
+      // Integrador usado nos tiles
+      integrator_type integrator = integrator_type::path;  // Integrador usado nos tiles
+      // Caminhos seguidos juntos em cada onda do integrador wavefront
+      int    wavefront_size = 4096;  // Caminhos seguidos juntos em cada onda do integrador wavefront
+      // Ordena os raios de cada rebote do wavefront por octante da direção e posição da origem
+      bool   sort_rays = false;  // Ordena os raios de cada rebote do wavefront por octante da direção e posição da origem
+
+
+      // Arquivo JSON com a linha do tempo dos tiles (trace do Chrome); só com RT_STATS
+      std::string trace_file;  // Arquivo JSON com a linha do tempo dos tiles (trace do Chrome); só com RT_STATS
+
+
+      // Checkpoint do buffer de acumulação. Se o arquivo existir, o render continua
+      // de onde ele parou (ou acrescenta amostras, com samples_per_pixel maior); o
+      // arquivo é regravado ao fim de cada passe e a cada checkpoint_interval.
+      std::string checkpoint_file;      // Checkpoint do buffer de acumulação; vazio desativa
+      // Segundos entre checkpoints no meio de um passe (0 = só ao fim dos passes)
+      double   checkpoint_interval = 300;  // Segundos entre checkpoints no meio de um passe (0 = só ao fim dos passes)
+      // Identificação da cena, gravada no checkpoint para não retomar um render de outra cena
+      uint64_t scene_hash = 0;          // Identificação da cena, gravada no checkpoint para não retomar um render de outra cena
+
+
+      // Renderiza a cena e escreve a imagem de uma só vez no final. Com output_file
+      // definido, o arquivo também é reescrito ao fim de cada passe progressivo.
+      // Retorna false se o render não pôde ser feito ou a imagem não foi gravada.
+      bool render(const hittable& world, const material_table& materials) {
+          framebuffer image;
+          bool write_failed = false;
+
+          thread_pool pool(num_threads);
+          bool ok = render_passes(pool, world, materials, image, [&](const framebuffer& partial, int pass) {
+              if (on_pass)
+                  on_pass(partial, pass);
+              if (!output_file.empty() && !write_image(output_file, partial, output_format))
+                  write_failed = true;
+          });
+          if (!ok)
+              return false;
+
+          if (output_file.empty()) {
+              set_stdout_binary();
+              write_image(std::cout, image, output_format);
+          } else if (write_failed) {
+              std::cerr << "Erro ao escrever " << output_file << '\n';
+              return false;
+          }
+          return true;
+      }
+
+      // Renderiza a cena num framebuffer em memória, sem escrever nada
+      bool render(const hittable& world, const material_table& materials, framebuffer& image) {
+          thread_pool pool(num_threads);
+          return render_passes(pool, world, materials, image, on_pass);
+      }
+
+      // Renderiza os quadros [first, last) de uma animação em que a câmera segue
+      // 'path', gravando cada um em frame_file_name(output_pattern, quadro).
+      // A cena, a BVH e as threads são as mesmas em todos os quadros, e a
+      // gravação de um quadro acontece enquanto o seguinte é renderizado.
+      // stats() soma os contadores de todos os quadros, e trace_file recebe
+      // uma linha do tempo só, com os quadros em sequência.
+      // Retorna false se algum quadro não pôde ser gravado.
+      bool render_sequence(const hittable& world, const material_table& materials, const camera_path& path,
+                           const std::string& output_pattern, int first, int last) {
+          thread_pool pool(num_threads);
+          frame_writer writer;
+          framebuffer image;
+
+          // Cada quadro grava o trace em render_passes; aqui ele é gravado uma vez no fim
+          std::string sequence_trace;
+          sequence_trace.swap(trace_file);
+          render_stats sequence_stats;
+          auto sequence_start = std::chrono::steady_clock::now();
+
+          bool ok = true;
+          for (int frame = first; frame < last; frame++) {
+              camera_keyframe key = path.at(frame);
+              lookfrom = key.lookfrom;
+              lookat = key.lookat;
+              vfov = key.vfov;
+              focus_dist = key.focus_dist;
+
+              std::clog << "Quadro " << frame << " (" << (frame - first + 1) << '/' << (last - first) << ")\n";
+              double frame_start = std::chrono::duration<double, std::micro>(
+                  std::chrono::steady_clock::now() - sequence_start).count();
+              if (!render_passes(pool, world, materials, image, on_pass)) {
+                  ok = false;
+                  break;
+              }
+              for (auto& t : last_stats.tiles) {
+                  t.start_us += frame_start;
+                  t.frame = frame;
+              }
+              sequence_stats.merge(last_stats);
+              writer.write(frame_file_name(output_pattern, frame), image, output_format);
+          }
+
+          trace_file.swap(sequence_trace);
+          last_stats = std::move(sequence_stats);
+          if (!ok)
+              return false;
+          if (render_stats_enabled && !trace_file.empty() && !write_chrome_trace(trace_file, last_stats))
+              std::cerr << "Erro ao escrever " << trace_file << '\n';
+
+          if (!writer.finish()) {
+              std::cerr << "Erro ao escrever " << writer.failed_path() << '\n';
+              return false;
+          }
+          return true;
+      }
+
+      // Renderiza direto para o arquivo 'path' (PPM binário ou PFM), para imagens
+      // maiores que a memória. O arquivo é criado com o tamanho final e mapeado
+      // (streamed_image); a imagem é feita em faixas de tile_size linhas, cada
+      // tile com todas as amostras num buffer de acumulação só dele, escrito no
+      // arquivo assim que termina, e cada faixa pronta é gravada no disco e
+      // liberada. A memória usada fica em uma faixa do arquivo mais um tile
+      // por thread, qualquer que seja o tamanho da imagem, e a imagem é
+      // idêntica à de render() (a não ser com amostragem adaptativa, que aqui
+      // decide a convergência num passe só). Não há passes progressivos, filtro de ruído,
+      // checkpoint nem linha do tempo dos tiles.
+      bool render_streamed(const hittable& world, const material_table& materials, const std::string& path,
+                           image_format format) {
           initialize();
-  
-          // Cabeçalho do arquivo PPM
-          std::cout << "P3\n" << image_width << ' ' << image_height << "\n255\n";
-  
-          // Loop através de cada linha de pixels
-          for (int j = 0; j < image_height; j++) {
-              // Mostra progresso
-              std::clog << "\rLinhas restantes: " << (image_height - j) << ' ' << std::flush;
-              
-              // Loop através de cada coluna de pixels
-              for (int i = 0; i < image_width; i++) {
-                  color pixel_color(0,0,0);
-                  // Amostragem por pixel para anti-aliasing
-                  for (int sample = 0; sample < samples_per_pixel; sample++) {
-                      ray r = get_ray(i, j);
-                      pixel_color += ray_color(r, max_depth, world);
-                    }
-                  // Escreve a cor média das amostras
-                  write_color(std::cout, pixel_samples_scale * pixel_color);
+          streamed_image out;
+          std::string error;
+          if (!out.create(path, image_width, image_height, format, error)) {
+              std::cerr << error << '\n';
+              return false;
+          }
+
+          thread_pool pool(num_threads);
+          std::vector<render_stats> worker_stats(size_t(pool.size()));
+          std::atomic<uint64_t> samples{0};
+          std::atomic<uint64_t> rays{0};
+          int band = (tile_size < 1) ? 1 : tile_size;
+
+          for (int y = 0; y < image_height; y += band) {
+              int y1 = std::min(y + band, image_height);
+              auto tiles = make_tiles({0, y, image_width, y1});
+              pool.run(int(tiles.size()), [&](int k, int worker) {
+#ifdef RT_STATS
+                  render_stats_scope scope(worker_stats[size_t(worker)]);
+#else
+                  (void)worker;
+#endif
+                  thread_local accumulation_buffer accum;
+                  thread_local framebuffer pixels;
+                  const tile& t = tiles[size_t(k)];
+                  accum.resize_window(t.x0, t.y0, t.x1 - t.x0, t.y1 - t.y0);
+                  uint64_t tile_rays = 0;
+                  if (integrator == integrator_type::wavefront)
+                      samples += render_tile_wavefront(t, world, materials, accum, samples_per_pixel, tile_rays);
+                  else
+                      samples += render_tile(t, world, materials, accum, samples_per_pixel, tile_rays);
+                  rays += tile_rays;
+                  accum.resolve(pixels);
+                  out.write_tile(t.x0, t.y0, pixels);
+              });
+              if (!out.flush_rows(y, y1)) {
+                  std::cerr << "\nErro ao gravar " << path << '\n';
+                  return false;
               }
+              std::clog << "\rLinhas prontas: " << y1 << '/' << image_height << ' ' << std::flush;
           }
-  
-          std::clog << "\rConcluído.                 \n";
+          if (!out.close()) {
+              std::cerr << "\nErro ao gravar " << path << '\n';
+              return false;
+          }
+
+          total_samples = samples;
+          total_rays = rays;
+          std::clog << "\rConcluído. Amostras: " << total_samples << " ("
+                    << double(total_samples) / (double(image_width) * image_height)
+                    << " por pixel)                 \n";
+          last_stats = render_stats();
+          for (const auto& s : worker_stats)
+              last_stats.merge(s);
+          return true;
       }
-  
+
+      // Renderiza só o retângulo [x0,x1) x [y0,y1) da imagem, com todos os passes,
+      // em 'accum' (redimensionado para a imagem inteira se preciso). É o que
+      // cada worker do render distribuído faz com os blocos que recebe: como
+      // as amostras de um pixel não dependem dos outros pixels, juntar os
+      // blocos dá exatamente a mesma imagem do render local.
+      void render_region(thread_pool& pool, const hittable& world, const material_table& materials,
+                         accumulation_buffer& accum, int x0, int y0, int x1, int y1) {
+          initialize();
+          if (accum.width != image_width || accum.height != image_height)
+              accum.resize(image_width, image_height);
+          x0 = std::max(x0, 0);
+          y0 = std::max(y0, 0);
+          x1 = std::min(x1, image_width);
+          y1 = std::min(y1, image_height);
+          accum.clear_region(x0, y0, x1, y1);
+
+          auto tiles = make_tiles({x0, y0, x1, y1});
+          for (int target : pass_targets()) {
+              std::atomic<uint64_t> samples{0};
+              pool.run(int(tiles.size()), [&](int t, int) {
+                  uint64_t rays = 0;
+                  if (integrator == integrator_type::wavefront)
+                      samples += render_tile_wavefront(tiles[t], world, materials, accum, target, rays);
+                  else
+                      samples += render_tile(tiles[t], world, materials, accum, target, rays);
+              });
+              if (samples == 0)
+                  break;
+          }
+      }
+
+      // Leva os pixels de 'accum' até 'target' amostras, continuando das que
+      // já têm, e deixa a média (filtrada, com denoise) em 'image'. É o passo
+      // da prévia interativa (preview.h), que chama com alvos crescentes; um
+      // 'accum' zerado começa uma vista nova. Se 'cancel' ficar true, as
+      // threads param antes do próximo pixel e a função retorna false sem
+      // tocar em 'image'.
+      bool render_pass(thread_pool& pool, const hittable& world, const material_table& materials,
+                       accumulation_buffer& accum, int target, const std::atomic<bool>& cancel,
+                       framebuffer& image) {
+          initialize();
+          if (accum.width != image_width || accum.height != image_height)
+              accum.resize(image_width, image_height);
+          aov_buffer* aovs = nullptr;
+          if (denoise) {
+              if (last_aovs.width != image_width || last_aovs.height != image_height
+                  || std::all_of(accum.count.begin(), accum.count.end(), [](uint32_t c) { return c == 0; }))
+                  last_aovs.resize(image_width, image_height);
+              aovs = &last_aovs;
+          }
+
+          auto tiles = make_tiles();
+          pool.run(int(tiles.size()), [&](int t, int) {
+              uint64_t rays = 0;
+              if (integrator == integrator_type::wavefront)
+                  render_tile_wavefront(tiles[t], world, materials, accum, target, rays, &cancel, aovs);
+              else
+                  render_tile(tiles[t], world, materials, accum, target, rays, &cancel, aovs);
+          });
+          if (cancel)
+              return false;
+
+          accum.resolve(image);
+          if (denoise) {
+              fill_guides(pool, world, materials, accum, last_aovs);
+              atrous_denoiser filter;
+              filter.iterations = denoise_iterations;
+              filter.run(pool, accum, last_aovs, image);
+          }
+          return true;
+      }
+
+      // Identifica tudo o que define as amostras de cada pixel: a cena (scene_hash),
+      // a resolução, a câmera, a semente, o amostrador e a amostragem das
+      // luzes. Só um checkpoint com a mesma chave pode ser retomado;
+      // samples_per_pixel e os parâmetros da amostragem adaptativa podem mudar
+      // entre uma execução e outra.
+      uint64_t checkpoint_key() const {
+          uint64_t key = hash_u64(scene_hash);
+          auto mix = [&](double x) {
+              uint64_t bits;
+              std::memcpy(&bits, &x, sizeof bits);
+              key = hash_u64(key ^ bits);
+          };
+          for (double x : { aspect_ratio, double(image_width), double(max_depth), vfov, defocus_angle, focus_dist,
+                            double(russian_roulette_depth), double(seed), double(sampler), sky_intensity,
+                            double(light_sampling && lights && !lights->empty()) })
+              mix(x);
+          for (const vec3* v : { &lookfrom, &lookat, &vup })
+              for (int a = 0; a < 3; a++)
+                  mix(double((*v)[a]));
+          return key;
+      }
+
+      // Altura da imagem, calculada a partir de image_width e aspect_ratio
+      int height() const {
+          int h = int(image_width / aspect_ratio);
+          return (h < 1) ? 1 : h;
+      }
+
+      // Total de amostras (raios de câmera) gastas na última renderização
+      uint64_t samples_taken() const { return total_samples; }
+
+      // Total de raios (câmera e rebotes) testados contra a cena na última renderização
+      uint64_t rays_traced() const { return total_rays; }
+
+      // Contadores e tempos da última renderização, somados de todas as threads.
+      // Ficam zerados quando o programa não é compilado com RT_STATS.
+      const render_stats& stats() const { return last_stats; }
+
+      // Albedo, normal e profundidade do primeiro acerto, em média por pixel, da
+      // última renderização com denoise (vazio sem ele)
+      const aov_buffer& aovs() const { return last_aovs; }
+
     private:
       // Altura da imagem renderizada
       int    image_height;         // Altura da imagem renderizada
-      // Fator de escala para a média das amostras de cor
-      double pixel_samples_scale;  // Fator de escala para a média das amostras de cor
+      // Amostras gastas na última renderização
+      uint64_t total_samples = 0;  // Amostras gastas na última renderização
+      // Raios testados contra a cena na última renderização
+      uint64_t total_rays = 0;     // Raios testados contra a cena na última renderização
+      // Instrumentação da última renderização
+      render_stats last_stats;     // Instrumentação da última renderização
+      // Dados do primeiro acerto da última renderização, para o filtro de ruído
+      aov_buffer last_aovs;        // Dados do primeiro acerto da última renderização, para o filtro de ruído
       // Centro da câmera
       point3 center;               // Centro da câmera
       // Localização do pixel (0,0)
@@ -78,39 +430,773 @@ class camera {
       vec3   defocus_disk_u;       // Vetores para o disco de desfoque (profundidade de campo)
       vec3   defocus_disk_v;       // Vetores para o disco de desfoque (profundidade de campo)
 
+      // Retângulo de pixels [x0,x1) x [y0,y1) renderizado como uma unidade de trabalho
+      struct tile {
+          int x0, y0, x1, y1;
+      };
 
-      // Calcula a cor do raio, incluindo reflexões e refrações
-      color ray_color(const ray& r, int depth, const hittable& world) const {
-          // Se excedeu o número máximo de reflexões, não contribui mais com luz
-          if (depth <= 0)
-              return color(0,0,0);
 
+      // Divide a imagem em tiles, em ordem de linhas
+      std::vector<tile> make_tiles() const {
+          return make_tiles({0, 0, image_width, image_height});
+      }
+
+      // Divide um retângulo da imagem em tiles, em ordem de linhas
+      std::vector<tile> make_tiles(const tile& region) const {
+          int size = (tile_size < 1) ? 1 : tile_size;
+          std::vector<tile> tiles;
+          for (int y = region.y0; y < region.y1; y += size)
+              for (int x = region.x0; x < region.x1; x += size)
+                  tiles.push_back({x, y, std::min(x + size, region.x1), std::min(y + size, region.y1)});
+          return tiles;
+      }
+
+      // Número de amostras por pixel a atingir ao fim de cada passe
+      std::vector<int> pass_targets() const {
+          int max_samples = std::max(1, samples_per_pixel);
+          std::vector<int> targets;
+
+          if (adaptive_sampling) {
+              // Começa com min_samples e dobra a cada passe até o máximo
+              int target = std::min(std::max(1, min_samples), max_samples);
+              while (target < max_samples) {
+                  targets.push_back(target);
+                  target *= 2;
+              }
+              targets.push_back(max_samples);
+          } else {
+              int passes = std::min(std::max(1, progressive_passes), max_samples);
+              for (int p = 1; p <= passes; p++)
+                  targets.push_back(int(int64_t(max_samples) * p / passes));
+          }
+          return targets;
+      }
+
+      // Renderiza em passes sobre um buffer de acumulação, chamando pass_done
+      // com a imagem parcial ao fim de cada passe. Retorna false se o
+      // checkpoint existente não puder ser retomado.
+      bool render_passes(thread_pool& pool, const hittable& world, const material_table& materials,
+                         framebuffer& image, const std::function<void(const framebuffer&, int)>& pass_done) {
+          initialize();
+
+          accumulation_buffer accum;
+          accum.resize(image_width, image_height);
+          aov_buffer* aovs = nullptr;
+          last_aovs = aov_buffer();
+          if (denoise) {
+              last_aovs.resize(image_width, image_height);
+              aovs = &last_aovs;
+          }
+          double denoise_ms = 0;
+          auto tiles = make_tiles();
+          auto targets = pass_targets();
+
+          std::mutex progress_mutex;
+          total_samples = 0;
+          total_rays = 0;
+
+          // Retoma o checkpoint, se houver: cada pixel continua do índice de
+          // amostra em que parou
+          uint64_t key = checkpoint_key();
+          uint64_t checkpoint_samples = 0;
+          if (!checkpoint_file.empty()) {
+              accumulation_buffer saved;
+              uint64_t saved_key;
+              std::string error;
+              if (load_checkpoint(checkpoint_file, saved, saved_key, checkpoint_samples, error)) {
+                  if (saved_key != key || saved.width != image_width || saved.height != image_height) {
+                      std::cerr << checkpoint_file << ": checkpoint de outra cena, câmera ou resolução\n";
+                      return false;
+                  }
+                  accum = std::move(saved);
+                  std::clog << "Retomando de " << checkpoint_file << " (" << checkpoint_samples << " amostras)\n";
+              } else if (!error.empty()) {
+                  std::cerr << error << '\n';
+                  return false;
+              }
+          }
+
+          // Pedido de checkpoint no meio de um passe: as threads param entre um
+          // pixel e outro, o buffer é gravado e o passe continua de onde parou
+          std::atomic<bool> checkpoint_due{false};
+          auto last_checkpoint = std::chrono::steady_clock::now();
+          auto write_checkpoint = [&] {
+              uint64_t samples = std::accumulate(accum.count.begin(), accum.count.end(), uint64_t(0));
+              if (!save_checkpoint(checkpoint_file, accum, key, samples))
+                  std::cerr << "\nErro ao gravar o checkpoint " << checkpoint_file << '\n';
+              last_checkpoint = std::chrono::steady_clock::now();
+          };
+
+          // Um registro de instrumentação por thread, somados só no final
+          std::vector<render_stats> worker_stats(size_t(pool.size()));
+          auto render_start = std::chrono::steady_clock::now();
+          auto elapsed_us = [&] {
+              return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - render_start).count();
+          };
+
+          for (int pass = 0; pass < int(targets.size()); pass++) {
+              std::atomic<uint64_t> pass_samples{0};
+              std::atomic<uint64_t> pass_rays{0};
+              double pass_start = elapsed_us();
+
+              // A imagem é dividida em tiles, renderizados em paralelo. Se um
+              // checkpoint interromper o passe, ele é retomado em seguida.
+              do {
+                  if (checkpoint_due) {
+                      write_checkpoint();
+                      checkpoint_due = false;
+                  }
+                  int tiles_remaining = int(tiles.size());
+                  pool.run(int(tiles.size()), [&](int t, int worker) {
+#ifdef RT_STATS
+                      render_stats_scope scope(worker_stats[size_t(worker)]);
+                      double tile_start = elapsed_us();
+#else
+                      (void)worker;
+#endif
+                      uint64_t rays = 0;
+                      uint64_t samples;
+                      if (integrator == integrator_type::wavefront)
+                          samples = render_tile_wavefront(tiles[t], world, materials, accum, targets[pass], rays,
+                                                          &checkpoint_due, aovs);
+                      else
+                          samples = render_tile(tiles[t], world, materials, accum, targets[pass], rays,
+                                                &checkpoint_due, aovs);
+                      pass_samples += samples;
+                      pass_rays += rays;
+#ifdef RT_STATS
+                      worker_stats[size_t(worker)].tiles.push_back({ pass, t, worker, tile_start,
+                                                                     elapsed_us() - tile_start, samples });
+#endif
+
+                      // Mostra progresso
+                      std::lock_guard<std::mutex> lock(progress_mutex);
+                      tiles_remaining--;
+                      std::clog << "\rPasse " << (pass + 1) << '/' << targets.size()
+                                << ", tiles restantes: " << tiles_remaining << ' ' << std::flush;
+
+                      if (!checkpoint_file.empty() && checkpoint_interval > 0
+                          && std::chrono::duration<double>(std::chrono::steady_clock::now() - last_checkpoint).count()
+                             >= checkpoint_interval)
+                          checkpoint_due = true;
+                  });
+              } while (checkpoint_due);
+
+              total_samples += pass_samples;
+              total_rays += pass_rays;
+              if (render_stats_enabled)
+                  worker_stats[0].tiles.push_back({ pass, -1, -1, pass_start, elapsed_us() - pass_start, pass_samples });
+              if (!checkpoint_file.empty())
+                  write_checkpoint();
+              accum.resolve(image);
+              if (denoise) {
+                  auto denoise_start = std::chrono::steady_clock::now();
+                  fill_guides(pool, world, materials, accum, last_aovs);
+                  atrous_denoiser filter;
+                  filter.iterations = denoise_iterations;
+                  filter.run(pool, accum, last_aovs, image);
+                  denoise_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()
+                                                                          - denoise_start).count();
+              }
+              if (pass_done)
+                  pass_done(image, pass);
+
+              // Todos os pixels convergiram antes do máximo de amostras. Um passe
+              // sem amostras também acontece ao retomar um checkpoint que já
+              // passou deste passe, e aí o render continua.
+              if (pass_samples == 0
+                  && std::all_of(accum.converged.begin(), accum.converged.end(), [](uint8_t c) { return c != 0; }))
+                  break;
+          }
+
+          std::clog << "\rConcluído. Amostras: " << total_samples << " ("
+                    << double(total_samples) / (double(image_width) * image_height)
+                    << " por pixel)                 \n";
+          if (denoise)
+              std::clog << "Filtro de ruído: " << denoise_ms << " ms\n";
+
+          last_stats = render_stats();
+          for (const auto& s : worker_stats)
+              last_stats.merge(s);
+          if (render_stats_enabled && !trace_file.empty() && !write_chrome_trace(trace_file, last_stats))
+              std::cerr << "Erro ao escrever " << trace_file << '\n';
+          return true;
+      }
+
+      // Leva cada pixel do tile até 'target' amostras (ou até convergir, na
+      // amostragem adaptativa). Retorna quantas amostras foram feitas e soma
+      // em 'rays' os raios testados contra a cena. Se 'stop' ficar true, para
+      // antes do próximo pixel; cada pixel fica sempre com amostras inteiras.
+      // Com 'aovs', soma nele os dados do primeiro acerto de cada amostra.
+      uint64_t render_tile(const tile& t, const hittable& world, const material_table& materials,
+                           accumulation_buffer& accum, int target, uint64_t& rays,
+                           const std::atomic<bool>* stop = nullptr, aov_buffer* aovs = nullptr) const {
+          uint64_t taken = 0;
+
+          for (int j = t.y0; j < t.y1; j++) {
+              for (int i = t.x0; i < t.x1; i++) {
+                  if (stop && stop->load(std::memory_order_relaxed))
+                      return taken;
+                  auto pixel = accum.index(i, j);
+                  if (accum.converged[pixel])
+                      continue;
+
+                  // Amostragem por pixel para anti-aliasing; o índice da amostra
+                  // continua de onde o passe anterior parou
+                  for (int sample = int(accum.count[pixel]); sample < target; sample++) {
+                      seed_sample(i, j, sample);
+                      ray r = get_ray(i, j);
+                      guide_sample guide;
+                      accum.add(pixel, ray_color(r, max_depth, world, materials, rays, aovs ? &guide : nullptr));
+                      if (aovs)
+                          aovs->add(pixel, guide);
+                      taken++;
+                  }
+
+                  if (adaptive_sampling
+                      && int(accum.count[pixel]) >= min_samples
+                      && accum.relative_error(pixel) <= adaptive_threshold)
+                      accum.converged[pixel] = 1;
+              }
+          }
+
+          return taken;
+      }
+
+
+      // Calcula a cor do raio, incluindo reflexões e refrações. O caminho é seguido
+      // num laço: a cada rebote a atenuação do material multiplica 'throughput', e
+      // a luz que o caminho encontra (o céu quando o raio escapa, as superfícies
+      // emissoras e a amostragem direta das luzes nos acertos difusos) é somada
+      // em 'radiance' ponderada por ela. Com 'guide', guarda nele os dados do
+      // primeiro acerto não especular para o filtro de ruído.
+      color ray_color(const ray& r_in, int depth, const hittable& world, const material_table& materials,
+                      uint64_t& rays, guide_sample* guide = nullptr) const {
+          ray r = r_in;
+          color throughput(1,1,1);
+          color radiance(0,0,0);
+          double bsdf_pdf = 0;  // Densidade com que o rebote anterior gerou r (0: câmera ou especular)
           hit_record rec;
+          bool guide_open = guide != nullptr;
+          if (guide)
+              *guide = guide_sample{ color(1,1,1), vec3(0,0,0), 0 };
+
+          // Cada iteração é um rebote; depois de 'depth' rebotes o caminho não contribui mais
+          for (int bounce = 0; bounce < depth; bounce++) {
+              rays++;
+              RT_STAT(rays++);
+              // Dimensões do amostrador reservadas a este rebote: espalhamento
+              // (2D), escolha do material (1D) e roleta russa (1D)
+              current_sampler().set_dimension(bounce_dimension(bounce));
+
+              // Se o raio não atingir nenhum objeto: gradiente de fundo (céu).
+              // O intervalo começa em 0: os raios que saem de uma superfície já
+              // têm a origem afastada dela (hit_record::spawn_ray)
+              bool hit = world.hit(r, interval(0, infinity), rec);
+              if (guide_open)
+                  guide_open = follow_guide(*guide, r, hit, rec, materials);
+              if (!hit) {
+                  RT_STAT(end_path(path_end::escaped, bounce + 1));
+                  return radiance + throughput * background(r);
+              }
+
+              const material& m = materials[rec.mat];
+              RT_STAT(scatter_calls[size_t(m.type)]++);
+              if (m.emits()) {
+                  RT_STAT(end_path(path_end::light, bounce + 1));
+                  return radiance + throughput * emitted(r, rec, m, bsdf_pdf);
+              }
 
-          // Se o raio atingir um objeto
-          if (world.hit(r, interval(0.001, infinity), rec)) {
               ray scattered;
               color attenuation;
-              // Se o material espalhar o raio, continue o caminho do raio
-              if (rec.mat->scatter(r, rec, attenuation, scattered))
-                  return attenuation * ray_color(scattered, depth-1, world);
-              return color(0,0,0);
+              // Se o material absorver o raio, o caminho termina sem mais luz
+              if (!m.scatter(r, rec, attenuation, scattered)) {
+                  RT_STAT(end_path(path_end::absorbed, bounce + 1));
+                  return radiance;
+              }
+
+              bsdf_pdf = 0;
+              if (samples_lights(m)) {
+                  radiance += throughput * direct_light(rec, m, world, bounce, rays);
+                  bsdf_pdf = m.pdf_lambertian(rec, scattered.direction());
+              }
+
+              if (!continue_path(throughput, attenuation, bounce))
+                  return radiance;
+
+              r = rec.spawn_ray(scattered.direction());
           }
 
-          // Gradiente de fundo (céu)
+          RT_STAT(end_path(path_end::max_depth, depth));
+          return radiance;
+      }
+
+      // Cor do céu vista por um raio que escapou da cena
+      color background(const ray& r) const {
           vec3 unit_direction = unit_vector(r.direction());
           auto a = 0.5*(unit_direction.y() + 1.0);
-          return (1.0-a)*color(1.0, 1.0, 1.0) + a*color(0.5, 0.7, 1.0);
+          return sky_intensity * ((1.0-a)*color(1.0, 1.0, 1.0) + a*color(0.5, 0.7, 1.0));
+      }
+
+      // Atualiza os dados do filtro de ruído com o próximo acerto do caminho
+      // (ou a saída para o céu). Vidro e espelhos perfeitos não dão bons
+      // guias, porque o que aparece neles é o reflexo ou a refração de outra
+      // superfície: nesses o caminho é seguido, com o albedo tingido pela cor
+      // deles, até o primeiro acerto não especular. Retorna false quando os dados
+      // estão completos.
+      bool follow_guide(guide_sample& guide, const ray& r, bool hit, const hit_record& rec,
+                        const material_table& materials) const {
+          if (!hit) {
+              guide.albedo = guide.albedo * background(r);
+              guide.normal = vec3(0,0,0);
+              guide.depth = 0;
+              return false;
+          }
+          const material& m = materials[rec.mat];
+          guide.albedo = guide.albedo * m.surface_color();
+          guide.normal = rec.normal;
+          guide.depth += rec.t * r.direction().length();
+          return m.type == material::kind::dielectric || (m.type == material::kind::metal && m.fuzz == 0);
+      }
+
+      // Completa os dados do filtro de ruído das amostras que vieram de um
+      // checkpoint (as primeiras de cada pixel; o aov_buffer não é gravado
+      // nele), seguindo de novo só o trecho de cada caminho que define os dados
+      void fill_guides(thread_pool& pool, const hittable& world, const material_table& materials,
+                       const accumulation_buffer& accum, aov_buffer& aovs) const {
+          auto tiles = make_tiles();
+          pool.run(int(tiles.size()), [&](int k, int) {
+              const tile& t = tiles[size_t(k)];
+              hit_record rec;
+              for (int j = t.y0; j < t.y1; j++)
+                  for (int i = t.x0; i < t.x1; i++) {
+                      auto pixel = accum.index(i, j);
+                      int missing = int(accum.count[pixel]) - int(aovs.count[pixel]);
+                      for (int sample = 0; sample < missing; sample++) {
+                          seed_sample(i, j, sample);
+                          ray r = get_ray(i, j);
+                          guide_sample guide{ color(1,1,1), vec3(0,0,0), 0 };
+                          for (int bounce = 0; bounce < max_depth; bounce++) {
+                              current_sampler().set_dimension(bounce_dimension(bounce));
+                              bool hit = world.hit(r, interval(0, infinity), rec);
+                              ray scattered;
+                              color attenuation;
+                              if (!follow_guide(guide, r, hit, rec, materials)
+                                  || !materials[rec.mat].scatter(r, rec, attenuation, scattered))
+                                  break;
+                              r = rec.spawn_ray(scattered.direction());
+                          }
+                          aovs.add(pixel, guide);
+                      }
+                  }
+          });
+      }
+
+      // Se os acertos neste material amostram as luzes diretamente. Só as
+      // superfícies difusas: nas especulares a chance de a direção amostrada
+      // na luz ser a refletida é nula, e o rebote já faz todo o trabalho.
+      bool samples_lights(const material& m) const {
+          return light_sampling && lights && !lights->empty() && m.type == material::kind::lambertian;
+      }
+
+      // Heurística da potência (Veach) com expoente 2 para o peso de uma
+      // estratégia de densidade 'a' combinada com outra de densidade 'b'
+      static double power_heuristic(double a, double b) {
+          if (a == infinity)
+              return 1;
+          return a*a / (a*a + b*b);
+      }
+
+      // Luz emitida por uma superfície atingida pelo raio r. Quando o raio veio
+      // de um rebote difuso (bsdf_pdf > 0), a mesma luz também pode ter sido
+      // amostrada diretamente naquele ponto, e as duas estimativas são
+      // combinadas por importância múltipla (MIS): aqui entra só o peso da
+      // amostragem do material.
+      color emitted(const ray& r, const hit_record& rec, const material& m, double bsdf_pdf) const {
+          if (bsdf_pdf <= 0)
+              return m.emission;
+          double length = r.direction().length();
+          double distance = rec.t * length;
+          double light_pdf = lights->pdf(distance * distance, dot(rec.normal, r.direction()) / length);
+          return m.emission * power_heuristic(bsdf_pdf, light_pdf);
+      }
+
+      // Amostragem direta das luzes (next-event estimation) num acerto difuso:
+      // escolhe um ponto numa luz, testa com um raio de sombra se ele é visível
+      // e retorna a luz que chega por ali vezes a BRDF e o cosseno, ponderada
+      // por MIS contra a amostragem do material. O raio de sombra só precisa
+      // saber se há algo no caminho, então usa hit_any, que para no primeiro
+      // obstáculo.
+      color direct_light(const hit_record& rec, const material& m, const hittable& world, int bounce,
+                         uint64_t& rays) const {
+          current_sampler().set_dimension(light_dimension(bounce));
+          double pick = current_sampler().get_1d();
+          auto s = current_sampler().get_2d();
+          light_sample light;
+          if (!lights->sample(rec.p, pick, s.u, s.v, light))
+              return color(0,0,0);
+
+          vec3 to_light = light.p - rec.p;
+          double distance_squared = to_light.length_squared();
+          if (!(distance_squared > 0))
+              return color(0,0,0);
+          vec3 direction = to_light / std::sqrt(distance_squared);
+          double bsdf_pdf = m.pdf_lambertian(rec, direction);
+          double light_pdf = lights->pdf(distance_squared, dot(light.normal, direction));
+          if (bsdf_pdf <= 0 || light_pdf == infinity)
+              return color(0,0,0);
+
+          // O raio sai da origem afastada da superfície e vai até pouco antes do
+          // ponto na luz, para não acertar a própria luz por arredondamento
+          rays++;
+          RT_STAT(rays++);
+          RT_STAT(shadow_rays++);
+          point3 origin = rec.spawn_ray(to_light).origin();
+          if (world.hit_any(ray(origin, light.p - origin), interval(0, 1 - shadow_epsilon))) {
+              RT_STAT(occluded_shadow_rays++);
+              return color(0,0,0);
+          }
+
+          // O peso usa a normal de sombreamento da luz, como emitted() faz com a
+          // normal do acerto: os pesos das duas estratégias somam 1 em cada caminho
+          double mis_pdf = lights->pdf(distance_squared, dot(light.shading_normal, direction));
+          return light.emission * m.albedo * (bsdf_pdf * power_heuristic(mis_pdf, bsdf_pdf) / light_pdf);
+      }
+
+      static uint32_t bounce_dimension(int bounce) {
+          return first_bounce_dimension + dimensions_per_bounce * uint32_t(bounce);
+      }
+
+      // Dimensões da amostragem direta das luzes: escolha da luz (1D) e ponto
+      // nela (2D), depois das de todos os rebotes. Ficam fora do bloco de cada
+      // rebote para que as cenas sem luzes continuem com as mesmas amostras.
+      uint32_t light_dimension(int bounce) const {
+          return bounce_dimension(std::max(max_depth, 0)) + 3 * uint32_t(bounce);
+      }
+
+      // Aplica a atenuação de um espalhamento ao caminho e decide se ele continua.
+      // Retorna false quando o caminho termina sem mais contribuição.
+      bool continue_path(color& throughput, const color& attenuation, int bounce) const {
+          throughput = throughput * attenuation;
+
+          // Caminho praticamente preto: nada mais que ele atingir vai aparecer
+          if (throughput.near_zero()) {
+              RT_STAT(end_path(path_end::black, bounce + 1));
+              return false;
+          }
+
+          // Roleta russa: encerra o caminho com probabilidade 1-q e compensa os
+          // que sobrevivem dividindo por q, o que mantém o resultado sem viés
+          if (bounce + 1 >= russian_roulette_depth) {
+              auto q = std::fmin(std::fmax(throughput.x(), std::fmax(throughput.y(), throughput.z())), 0.95);
+              current_sampler().set_dimension(bounce_dimension(bounce) + 3);
+              if (current_sampler().get_1d() >= q) {
+                  RT_STAT(end_path(path_end::roulette, bounce + 1));
+                  return false;
+              }
+              throughput /= q;
+          }
+          return true;
+      }
+
+
+      // Integrador wavefront: em vez de seguir cada amostra até o fim, junta até
+      // wavefront_size caminhos do tile e avança todos um rebote por vez, em
+      // etapas separadas: interseção de toda a onda, separação dos acertos por
+      // tipo de material e um laço de espalhamento por tipo, sem despacho por
+      // raio. Os caminhos que sobrevivem formam a onda do rebote seguinte.
+      //
+      // Cada caminho leva o estado do seu gerador e do seu amostrador, e as cores
+      // são somadas ao buffer na ordem das amostras, então o resultado é
+      // idêntico ao de render_tile.
+      struct wavefront_path {
+          ray          r;
+          color        throughput;
+          double       bsdf_pdf;  // Densidade com que o rebote anterior gerou r (0: câmera ou especular)
+          pcg32        rng;
+          path_sampler sampler;
+          uint32_t     slot;  // Posição da amostra em 'results'
+      };
+
+      // Buffers de uma thread, reaproveitados entre tiles
+      struct wavefront_buffers {
+          std::vector<wavefront_path> paths, next;
+          std::vector<hit_record>     hits;
+          std::vector<uint32_t>       queues[material_kind_count];  // Índices dos acertos, por material::kind
+          std::vector<color>          results;
+          std::vector<size_t>         pixels;     // Pixel de cada amostra da onda
+          std::vector<guide_sample>   guides;     // Dados do filtro de ruído de cada amostra (com aovs)
+          std::vector<uint8_t>        guide_open; // 1 enquanto o caminho ainda não completou os dados
+          std::vector<uint32_t>       order, keys, sort_scratch[2];  // Ordem de interseção (sort_rays)
+          std::vector<point3>         origins;                        // Origens da onda, para as chaves
+      };
+
+      // Ordem de coerência dos raios da onda, em b.order: o octante da direção
+      // nos 3 bits altos da chave e, abaixo, o código de Morton da origem (4
+      // bits por eixo, dentro da caixa das origens da onda, que já é pequena
+      // porque a onda vem de um tile só). Raios seguidos nessa ordem saem de
+      // pontos próximos na mesma direção geral, então percorrem quase os mesmos
+      // nós da BVH e esferas, que ainda estão no cache, e tomam os mesmos
+      // desvios na travessia. A chave de 15 bits é ordenada por radix em 2
+      // passes de 8 bits. Só a ordem de interseção muda: cada caminho leva o
+      // seu slot, gerador e amostrador, e a imagem continua idêntica.
+      static void sort_wave(wavefront_buffers& b) {
+          // Uma passada pelos caminhos copia as origens e calcula os octantes
+          // e a caixa; as chaves saem da cópia compacta
+          size_t n = b.paths.size();
+          b.keys.resize(n);
+          b.origins.resize(n);
+          real lo[3], hi[3];
+          for (int a = 0; a < 3; a++)
+              lo[a] = hi[a] = b.paths[0].r.origin()[a];
+          for (size_t k = 0; k < n; k++) {
+              const ray& r = b.paths[k].r;
+              uint32_t octant = 0;
+              for (int a = 0; a < 3; a++) {
+                  lo[a] = std::min(lo[a], r.origin()[a]);
+                  hi[a] = std::max(hi[a], r.origin()[a]);
+                  octant |= uint32_t(r.direction()[a] < 0) << a;
+              }
+              b.origins[k] = r.origin();
+              b.keys[k] = octant << 12;
+          }
+          real scale[3];
+          for (int a = 0; a < 3; a++)
+              scale[a] = hi[a] > lo[a] ? real(15.999) / (hi[a] - lo[a]) : 0;
+
+          // Intercala os 4 bits de cada eixo: o bit k vai para o bit 3k
+          auto spread = [](uint32_t v) {
+              v = (v | (v << 4)) & 0x0c3u;
+              v = (v | (v << 2)) & 0x249u;
+              return v;
+          };
+          for (size_t k = 0; k < n; k++) {
+              const point3& o = b.origins[k];
+              b.keys[k] |= (spread(uint32_t((o.x() - lo[0]) * scale[0])) << 2)
+                         | (spread(uint32_t((o.y() - lo[1]) * scale[1])) << 1)
+                         |  spread(uint32_t((o.z() - lo[2]) * scale[2]));
+          }
+
+          std::vector<uint32_t>* in = &b.sort_scratch[0];
+          std::vector<uint32_t>* out = &b.sort_scratch[1];
+          in->resize(n);
+          out->resize(n);
+          for (size_t k = 0; k < n; k++)
+              (*in)[k] = uint32_t(k);
+          for (int shift = 0; shift < 16; shift += 8) {
+              uint32_t offsets[256] = {};
+              for (uint32_t k : *in)
+                  offsets[(b.keys[k] >> shift) & 255]++;
+              uint32_t sum = 0;
+              for (uint32_t& o : offsets) {
+                  uint32_t c = o;
+                  o = sum;
+                  sum += c;
+              }
+              for (uint32_t k : *in)
+                  (*out)[offsets[(b.keys[k] >> shift) & 255]++] = k;
+              std::swap(in, out);
+          }
+          b.order.swap(*in);
+      }
+
+      uint64_t render_tile_wavefront(const tile& t, const hittable& world, const material_table& materials,
+                                     accumulation_buffer& accum, int target, uint64_t& rays,
+                                     const std::atomic<bool>* stop = nullptr, aov_buffer* aovs = nullptr) const {
+          thread_local wavefront_buffers buffers;
+          wavefront_buffers& b = buffers;
+          size_t wave_size = size_t(std::max(1, wavefront_size));
+          uint64_t taken = 0;
+
+          b.paths.clear();
+          b.pixels.clear();
+
+          // Soma as cores da onda ao buffer na ordem em que as amostras foram geradas
+          auto flush = [&]() {
+              if (b.paths.empty())
+                  return;
+              trace_wavefront(b, world, materials, rays, aovs != nullptr);
+              for (size_t k = 0; k < b.pixels.size(); k++)
+                  accum.add(b.pixels[k], b.results[k]);
+              if (aovs)
+                  for (size_t k = 0; k < b.pixels.size(); k++)
+                      aovs->add(b.pixels[k], b.guides[k]);
+              taken += b.pixels.size();
+              b.paths.clear();
+              b.pixels.clear();
+          };
+
+          bool stopped = false;
+          for (int j = t.y0; j < t.y1 && !stopped; j++) {
+              for (int i = t.x0; i < t.x1; i++) {
+                  if (stop && stop->load(std::memory_order_relaxed)) {
+                      stopped = true;
+                      break;
+                  }
+                  auto pixel = accum.index(i, j);
+                  if (accum.converged[pixel])
+                      continue;
+
+                  for (int sample = int(accum.count[pixel]); sample < target; sample++) {
+                      seed_sample(i, j, sample);
+                      ray r = get_ray(i, j);
+                      b.paths.push_back({ r, color(1,1,1), 0, random_engine(), current_sampler(),
+                                          uint32_t(b.pixels.size()) });
+                      b.pixels.push_back(pixel);
+                      if (b.paths.size() >= wave_size)
+                          flush();
+                  }
+              }
+          }
+          flush();
+
+          // A convergência só depende das amostras do próprio pixel, então pode
+          // ser testada depois que todas as ondas do tile terminaram
+          if (adaptive_sampling) {
+              for (int j = t.y0; j < t.y1; j++)
+                  for (int i = t.x0; i < t.x1; i++) {
+                      auto pixel = accum.index(i, j);
+                      if (!accum.converged[pixel]
+                          && int(accum.count[pixel]) >= min_samples
+                          && accum.relative_error(pixel) <= adaptive_threshold)
+                          accum.converged[pixel] = 1;
+                  }
+          }
+
+          return taken;
+      }
+
+      // Segue todos os caminhos de b.paths até terminarem e deixa a cor de cada
+      // um em b.results, onde a luz que cada caminho encontra vai sendo somada.
+      // Com 'guides', deixa em b.guides os dados para o filtro de ruído.
+      void trace_wavefront(wavefront_buffers& b, const hittable& world, const material_table& materials,
+                           uint64_t& rays, bool guides) const {
+          b.results.assign(b.paths.size(), color(0,0,0));
+          if (guides) {
+              b.guides.assign(b.paths.size(), guide_sample{ color(1,1,1), vec3(0,0,0), 0 });
+              b.guide_open.assign(b.paths.size(), 1);
+          }
+
+          for (int bounce = 0; bounce < max_depth && !b.paths.empty(); bounce++) {
+              size_t n = b.paths.size();
+              rays += n;
+              RT_STAT(rays += n);
+
+              // Etapa 1: interseção da onda inteira. Quem escapa soma a luz do
+              // céu e sai da onda; os acertos vão para a fila do seu material.
+              //
+              // Os raios de câmera de um tile já são coerentes; a partir do
+              // primeiro rebote, com sort_rays, a onda é percorrida na ordem de
+              // sort_wave (menos nas ondas pequenas do fim dos caminhos, em que
+              // ordenar custaria mais do que ganha)
+              b.hits.resize(n);
+              for (auto& queue : b.queues)
+                  queue.clear();
+              bool sorted = sort_rays && bounce > 0 && n >= 256;
+              if (sorted) {
+#ifdef RT_STATS
+                  auto sort_start = std::chrono::steady_clock::now();
+                  sort_wave(b);
+                  double sort_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now()
+                                                                             - sort_start).count();
+                  RT_STAT(ray_sort_us += sort_us);
+                  RT_STAT(sorted_rays += n);
+#else
+                  sort_wave(b);
+#endif
+              }
+#ifdef RT_STATS
+              if (bounce > 0) {
+                  RT_STAT(secondary_rays += n);
+                  auto octant = [&](size_t k) {
+                      const vec3& d = b.paths[sorted ? b.order[k] : k].r.direction();
+                      return (d.x() < 0) | (d.y() < 0) << 1 | (d.z() < 0) << 2;
+                  };
+                  for (size_t k = 1; k < n; k++)
+                      RT_STAT(octant_switches += octant(k) != octant(k - 1));
+              }
+#endif
+              for (size_t m = 0; m < n; m++) {
+                  uint32_t k = sorted ? b.order[m] : uint32_t(m);
+                  wavefront_path& path = b.paths[k];
+                  bool hit = world.hit(path.r, interval(0, infinity), b.hits[k]);
+                  if (guides && b.guide_open[path.slot])
+                      b.guide_open[path.slot] = follow_guide(b.guides[path.slot], path.r, hit, b.hits[k], materials);
+                  if (!hit) {
+                      RT_STAT(end_path(path_end::escaped, bounce + 1));
+                      b.results[path.slot] += path.throughput * background(path.r);
+                      continue;
+                  }
+                  b.queues[size_t(materials[b.hits[k].mat].type)].push_back(k);
+              }
+
+              // Etapa 2: espalhamento, um laço por tipo de material. Os absorvedores
+              // não geram raio e só saem da onda; as luzes somam a sua emissão e
+              // também saem.
+              b.next.clear();
+              for (size_t type = 0; type < size_t(material_kind_count); type++)
+                  RT_STAT(scatter_calls[type] += b.queues[type].size());
+              for (size_t k = 0; k < b.queues[size_t(material::kind::absorber)].size(); k++)
+                  RT_STAT(end_path(path_end::absorbed, bounce + 1));
+              for (uint32_t k : b.queues[size_t(material::kind::diffuse_light)]) {
+                  const wavefront_path& path = b.paths[k];
+                  RT_STAT(end_path(path_end::light, bounce + 1));
+                  b.results[path.slot] += path.throughput * emitted(path.r, b.hits[k], materials[b.hits[k].mat],
+                                                                    path.bsdf_pdf);
+              }
+
+              auto shade = [&](const std::vector<uint32_t>& queue, auto&& scatter) {
+                  for (uint32_t k : queue) {
+                      wavefront_path& path = b.paths[k];
+                      const hit_record& rec = b.hits[k];
+                      random_engine() = path.rng;
+                      current_sampler() = path.sampler;
+                      current_sampler().set_dimension(bounce_dimension(bounce));
+
+                      ray scattered;
+                      color attenuation;
+                      const material& m = materials[rec.mat];
+                      if (!scatter(m, path.r, rec, attenuation, scattered)) {
+                          RT_STAT(end_path(path_end::absorbed, bounce + 1));
+                          continue;
+                      }
+                      double bsdf_pdf = 0;
+                      if (samples_lights(m)) {
+                          b.results[path.slot] += path.throughput * direct_light(rec, m, world, bounce, rays);
+                          bsdf_pdf = m.pdf_lambertian(rec, scattered.direction());
+                      }
+                      if (continue_path(path.throughput, attenuation, bounce)) {
+                          b.next.push_back({ rec.spawn_ray(scattered.direction()), path.throughput, bsdf_pdf,
+                                             random_engine(), current_sampler(), path.slot });
+                      }
+                  }
+              };
+              using kind = material::kind;
+              shade(b.queues[size_t(kind::lambertian)],
+                    [](const material& m, const ray&, const hit_record& rec, color& att, ray& s) {
+                        return m.scatter_lambertian(rec, att, s);
+                    });
+              shade(b.queues[size_t(kind::metal)],
+                    [](const material& m, const ray& r, const hit_record& rec, color& att, ray& s) {
+                        return m.scatter_metal(r, rec, att, s);
+                    });
+              shade(b.queues[size_t(kind::dielectric)],
+                    [](const material& m, const ray& r, const hit_record& rec, color& att, ray& s) {
+                        return m.scatter_dielectric(r, rec, att, s);
+                    });
+
+              b.paths.swap(b.next);
+          }
+
+          // Os que sobraram atingiram max_depth sem terminar
+          for (size_t k = 0; k < b.paths.size(); k++)
+              RT_STAT(end_path(path_end::max_depth, max_depth));
       }
 
       // Inicializa os parâmetros da câmera
       void initialize() {
           // Calcula a altura da imagem com base na largura e na proporção
-          image_height = int(image_width / aspect_ratio);
-          image_height = (image_height < 1) ? 1 : image_height;
-      
-          // Fator de escala para a média das amostras
-          pixel_samples_scale = 1.0 / samples_per_pixel;
+          image_height = height();
       
           // Define o centro da câmera
           center = lookfrom;
@@ -144,6 +1230,21 @@ class camera {
           defocus_disk_v = v * defocus_radius;
       }
     
+      // Reinicia o gerador e o amostrador para a amostra 'sample' do pixel (i,j).
+      // Assim o resultado depende só da semente, e não de qual thread renderizou o pixel.
+      void seed_sample(int i, int j, int sample) const {
+          uint64_t pixel = uint64_t(j) * uint64_t(image_width) + uint64_t(i);
+          seed_random(seed, (pixel << 32) | uint32_t(sample));
+          current_sampler().start(sampler, seed, pixel, uint32_t(sample));
+      }
+
+      // Dimensões 0-1: posição no pixel; 2-3: ponto na lente; depois, 4 por rebote
+      static constexpr uint32_t first_bounce_dimension = 4;
+      static constexpr uint32_t dimensions_per_bounce = 4;
+
+      // Fração do raio de sombra que fica de fora antes do ponto na luz
+      static constexpr double shadow_epsilon = 1e-4;
+
       // Obtém um raio para a posição de pixel (i,j)
       ray get_ray(int i, int j) const {
           // Obtém uma amostra aleatória dentro do pixel
@@ -161,12 +1262,16 @@ class camera {
 
       // Retorna um ponto aleatório no quadrado unitário [-0.5,-0.5] a [+0.5,+0.5]
       vec3 sample_square() const {
-          return vec3(random_double() - 0.5, random_double() - 0.5, 0);
+          current_sampler().set_dimension(0);
+          auto s = current_sampler().get_2d();
+          return vec3(s.u - 0.5, s.v - 0.5, 0);
       }
 
       // Retorna um ponto aleatório no disco de desfoque da câmera
       point3 defocus_disk_sample() const {
-          auto p = random_in_unit_disk();
+          current_sampler().set_dimension(2);
+          auto s = current_sampler().get_2d();
+          auto p = sample_unit_disk(s.u, s.v);
           return center + (p[0] * defocus_disk_u) + (p[1] * defocus_disk_v);
       }
 };
@@ -0,0 +1,81 @@
+#ifndef CAMERA_PATH_H
+#define CAMERA_PATH_H
+
+#include "vec3.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Pose da câmera num quadro da animação
+struct camera_keyframe {
+    double frame;       // Quadro em que a pose vale exatamente
+    point3 lookfrom;
+    point3 lookat;
+    double vfov;
+    double focus_dist;
+};
+
+// Trajetória da câmera para animações, dada por quadros-chave. As posições
+// (lookfrom e lookat) seguem uma spline de Catmull-Rom, que passa pelos
+// quadros-chave sem quinas; vfov e focus_dist são interpolados linearmente.
+class camera_path {
+  public:
+    // Quadros-chave em ordem de quadro
+    std::vector<camera_keyframe> keys;
+
+    bool empty() const { return keys.empty(); }
+
+    void add(const camera_keyframe& key) {
+        auto pos = std::upper_bound(keys.begin(), keys.end(), key.frame,
+                                    [](double f, const camera_keyframe& k) { return f < k.frame; });
+        keys.insert(pos, key);
+    }
+
+    // Quadros da animação: do 0 até o último quadro-chave
+    int frame_count() const {
+        return keys.empty() ? 0 : int(std::floor(keys.back().frame)) + 1;
+    }
+
+    // Pose no quadro 'frame'; antes do primeiro e depois do último quadro-chave
+    // a câmera fica parada
+    camera_keyframe at(double frame) const {
+        if (keys.size() == 1 || frame <= keys.front().frame)
+            return with_frame(keys.front(), frame);
+        if (frame >= keys.back().frame)
+            return with_frame(keys.back(), frame);
+
+        // Segmento [k1, k2] que contém o quadro, com os vizinhos k0 e k3
+        size_t i = size_t(std::upper_bound(keys.begin(), keys.end(), frame,
+                                           [](double f, const camera_keyframe& k) { return f < k.frame; })
+                          - keys.begin());
+        const camera_keyframe& k1 = keys[i - 1];
+        const camera_keyframe& k2 = keys[i];
+        const camera_keyframe& k0 = keys[i >= 2 ? i - 2 : i - 1];
+        const camera_keyframe& k3 = keys[std::min(i + 1, keys.size() - 1)];
+
+        double t = (frame - k1.frame) / (k2.frame - k1.frame);
+        camera_keyframe out;
+        out.frame = frame;
+        out.lookfrom = catmull_rom(k0.lookfrom, k1.lookfrom, k2.lookfrom, k3.lookfrom, t);
+        out.lookat = catmull_rom(k0.lookat, k1.lookat, k2.lookat, k3.lookat, t);
+        out.vfov = k1.vfov + t * (k2.vfov - k1.vfov);
+        out.focus_dist = k1.focus_dist + t * (k2.focus_dist - k1.focus_dist);
+        return out;
+    }
+
+  private:
+    static camera_keyframe with_frame(camera_keyframe key, double frame) {
+        key.frame = frame;
+        return key;
+    }
+
+    // Catmull-Rom uniforme entre p1 (t = 0) e p2 (t = 1). Nas pontas, onde não
+    // há vizinho, o próprio ponto é repetido.
+    static point3 catmull_rom(const point3& p0, const point3& p1, const point3& p2, const point3& p3, double t) {
+        double t2 = t * t, t3 = t2 * t;
+        return 0.5 * ((2*p1) + (p2 - p0) * t + (2*p0 - 5*p1 + 4*p2 - p3) * t2 + (3*p1 - p0 - 3*p2 + p3) * t3);
+    }
+};
+
+#endif
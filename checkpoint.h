@@ -0,0 +1,107 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "accumulation_buffer.h"
+#include "mapped_file.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+// Checkpoint de um render: o buffer de acumulação inteiro (somas, contagens,
+// estatísticas da luminância e pixels convergidos), para continuar um render
+// interrompido ou acrescentar amostras a uma imagem pronta.
+//
+// Formato: cabeçalho fixo seguido dos arrays do accumulation_buffer, na ordem
+// de bytes da máquina. As somas continuam em double: como cada pixel retoma
+// do índice de amostra em que parou, o render retomado dá exatamente a mesma
+// imagem que um render sem interrupção.
+struct checkpoint_header {
+    char     magic[8];  // "RTCKPT01"
+    uint32_t width, height;
+    uint64_t key;       // Identifica a cena e a câmera (camera::checkpoint_key)
+    uint64_t samples;   // Amostras somadas no buffer
+};
+
+constexpr char checkpoint_magic[8] = { 'R', 'T', 'C', 'K', 'P', 'T', '0', '1' };
+
+// Grava num arquivo temporário e o renomeia por cima do anterior, para que
+// uma interrupção no meio da escrita não estrague o último checkpoint bom
+inline bool save_checkpoint(const std::string& path, const accumulation_buffer& accum, uint64_t key,
+                            uint64_t samples) {
+    std::string temp = path + ".tmp";
+    {
+        std::ofstream file(temp, std::ios::binary);
+        if (!file)
+            return false;
+
+        checkpoint_header header = {};
+        std::memcpy(header.magic, checkpoint_magic, 8);
+        header.width = uint32_t(accum.width);
+        header.height = uint32_t(accum.height);
+        header.key = key;
+        header.samples = samples;
+
+        auto write = [&](const void* data, size_t size) {
+            file.write(static_cast<const char*>(data), std::streamsize(size));
+        };
+        size_t n = size_t(accum.width) * accum.height;
+        write(&header, sizeof header);
+        write(accum.sum.data(), 3 * n * sizeof(double));
+        write(accum.count.data(), n * sizeof(uint32_t));
+        write(accum.lum_mean.data(), n * sizeof(double));
+        write(accum.lum_m2.data(), n * sizeof(double));
+        write(accum.converged.data(), n * sizeof(uint8_t));
+        if (!file.flush())
+            return false;
+    }
+
+#ifdef _WIN32
+    std::remove(path.c_str());  // No Windows rename não substitui um arquivo existente
+#endif
+    return std::rename(temp.c_str(), path.c_str()) == 0;
+}
+
+// Lê um checkpoint. Retorna false com 'error' vazio se o arquivo não existe,
+// ou com a mensagem se ele existe mas não pode ser usado.
+inline bool load_checkpoint(const std::string& path, accumulation_buffer& accum, uint64_t& key,
+                            uint64_t& samples, std::string& error) {
+    error.clear();
+    mapped_file file;
+    if (!file.open(path))
+        return false;
+
+    checkpoint_header header;
+    if (file.size() < sizeof header || std::memcmp(file.data(), checkpoint_magic, 8) != 0) {
+        error = path + ": não é um checkpoint";
+        return false;
+    }
+    std::memcpy(&header, file.data(), sizeof header);
+
+    size_t n = size_t(header.width) * header.height;
+    size_t expected = sizeof header + n * (3 * sizeof(double) + sizeof(uint32_t) + 2 * sizeof(double) + 1);
+    if (header.width == 0 || header.height == 0 || file.size() != expected) {
+        error = path + ": checkpoint truncado ou corrompido";
+        return false;
+    }
+
+    accum.resize(int(header.width), int(header.height));
+    const char* p = file.data() + sizeof header;
+    auto read = [&](void* out, size_t size) {
+        std::memcpy(out, p, size);
+        p += size;
+    };
+    read(accum.sum.data(), 3 * n * sizeof(double));
+    read(accum.count.data(), n * sizeof(uint32_t));
+    read(accum.lum_mean.data(), n * sizeof(double));
+    read(accum.lum_m2.data(), n * sizeof(double));
+    read(accum.converged.data(), n * sizeof(uint8_t));
+
+    key = header.key;
+    samples = header.samples;
+    return true;
+}
+
+#endif
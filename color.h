@@ -16,21 +16,24 @@ inline double linear_to_gamma(double linear_component)
     return 0;
 }
 
-void write_color(std::ostream& out, const color& pixel_color) {
-    auto r = pixel_color.x();
-    auto g = pixel_color.y();
-    auto b = pixel_color.z();
-
-    // Aplica uma transformação linear para gama (gamma 2)
-    r = linear_to_gamma(r);
-    g = linear_to_gamma(g);
-    b = linear_to_gamma(b);
-
+// Converte uma componente linear para um byte [0,255], com correção gama
+inline int to_byte(double linear_component) {
     // Converte os valores dos componentes do intervalo [0,1] para a faixa de bytes [0,255].
     static const interval intensity(0.000, 0.999);
-    int rbyte = int(256 * intensity.clamp(r));
-    int gbyte = int(256 * intensity.clamp(g));
-    int bbyte = int(256 * intensity.clamp(b));
+    return int(256 * intensity.clamp(linear_to_gamma(linear_component)));
+}
+
+// Converte uma componente linear para 16 bits [0,65535], com correção gama
+inline int to_word(double linear_component) {
+    static const interval intensity(0.0, 1.0);
+    return int(65535 * intensity.clamp(linear_to_gamma(linear_component)) + 0.5);
+}
+
+inline void write_color(std::ostream& out, const color& pixel_color) {
+    // Aplica uma transformação linear para gama (gamma 2) e converte para bytes
+    int rbyte = to_byte(pixel_color.x());
+    int gbyte = to_byte(pixel_color.y());
+    int bbyte = to_byte(pixel_color.z());
 
     // saida do pixel
     out << rbyte << ' ' << gbyte << ' ' << bbyte << '\n';
@@ -0,0 +1,247 @@
+#ifndef DENOISER_H
+#define DENOISER_H
+
+#include "accumulation_buffer.h"
+#include "framebuffer.h"
+#include "thread_pool.h"
+#include "vec3.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+
+// Dados auxiliares (AOVs) do primeiro acerto não especular de uma amostra, que
+// guiam o filtro de ruído: nenhum deles depende da iluminação, então são quase
+// sem ruído mesmo com poucas amostras
+struct guide_sample {
+    color  albedo;     // Cor do material (ou do céu, se o raio escapou)
+    vec3   normal;     // Normal do acerto, virada para a câmera; nula no céu
+    double depth = 0;  // Distância da câmera ao acerto; 0 no céu
+};
+
+// Média dos guide_sample de cada pixel. Fica ao lado do accumulation_buffer,
+// mas não entra no checkpoint: os pixels retomados sem nenhuma amostra nova
+// recebem os dados do raio de câmera da amostra 0 (camera::fill_guides).
+class aov_buffer {
+  public:
+    int width  = 0;
+    int height = 0;
+    std::vector<float>    albedo;  // Somas, 3 por pixel
+    std::vector<float>    normal;  // Somas, 3 por pixel
+    std::vector<float>    depth;   // Somas, 1 por pixel
+    std::vector<uint32_t> count;   // Amostras somadas em cada pixel
+
+    void resize(int w, int h) {
+        width = w;
+        height = h;
+        size_t n = size_t(w) * h;
+        albedo.assign(3 * n, 0.0f);
+        normal.assign(3 * n, 0.0f);
+        depth.assign(n, 0.0f);
+        count.assign(n, 0);
+    }
+
+    size_t index(int i, int j) const { return size_t(j) * width + i; }
+
+    void add(size_t pixel, const guide_sample& s) {
+        for (int c = 0; c < 3; c++) {
+            albedo[3*pixel + c] += float(s.albedo[c]);
+            normal[3*pixel + c] += float(s.normal[c]);
+        }
+        depth[pixel] += float(s.depth);
+        count[pixel]++;
+    }
+
+    // Copia as médias para framebuffers: albedo, normal (componentes em [-1,1])
+    // e profundidade (repetida nos três canais)
+    void resolve(framebuffer& albedo_image, framebuffer& normal_image, framebuffer& depth_image) const {
+        albedo_image.resize(width, height);
+        normal_image.resize(width, height);
+        depth_image.resize(width, height);
+        for (int j = 0; j < height; j++)
+            for (int i = 0; i < width; i++) {
+                size_t p = index(i, j);
+                float scale = count[p] ? 1.0f / float(count[p]) : 0.0f;
+                for (int c = 0; c < 3; c++) {
+                    albedo_image.pixels[3*p + c] = albedo[3*p + c] * scale;
+                    normal_image.pixels[3*p + c] = normal[3*p + c] * scale;
+                    depth_image.pixels[3*p + c] = depth[p] * scale;
+                }
+            }
+    }
+};
+
+
+// Filtro de ruído à-trous guiado por bordas (Dammertz et al. 2010, com os pesos
+// de cor guiados pela variância como no SVGF de Schied et al. 2017).
+//
+// Cada iteração é uma convolução 5x5 com o spline B3 cujos pontos ficam
+// afastados de 2^i pixels, então 5 iterações alcançam ±62 pixels com 25
+// leituras por pixel cada. O peso de cada vizinho é o do kernel vezes a
+// semelhança com o pixel central em:
+// - normal: cos^sigma_normal do ângulo entre as normais;
+// - albedo: distância entre as cores dos materiais;
+// - profundidade: diferença comparada com a esperada pelo gradiente local;
+// - cor: diferença de luminância comparada com o desvio padrão do ruído (o
+//   maior dos dois pixels), que vem do accumulation_buffer e é filtrado junto
+//   com a cor. Usar o maior deixa o peso simétrico: um pixel muito mais
+//   claro que os vizinhos por causa do ruído (um vaga-lume) espalha a sua
+//   energia para eles em vez de simplesmente sumir, o que escureceria a imagem.
+// Com isso o ruído é espalhado dentro de cada superfície, mas não através das
+// bordas dos objetos, e uma região já convergida (variância ~0) não muda.
+class atrous_denoiser {
+  public:
+    int    iterations   = 5;    // Iterações; o alcance dobra a cada uma
+    double sigma_color  = 4;    // Tolerância da cor, em desvios padrão do ruído
+    double sigma_normal = 128;  // Expoente do cosseno entre as normais
+    double sigma_albedo = 0.1;  // Tolerância da diferença de albedo
+    double sigma_depth  = 1;    // Tolerância da profundidade, em múltiplos da variação esperada
+
+    // Filtra 'image' (a média de 'accum') guiado por 'aovs'. As linhas são
+    // divididas entre as threads do pool.
+    void run(thread_pool& pool, const accumulation_buffer& accum, const aov_buffer& aovs, framebuffer& image) const {
+        int w = image.width, h = image.height;
+        size_t n = size_t(w) * h;
+        if (n == 0 || iterations <= 0)
+            return;
+
+        // Guias normalizadas e variância da luminância da média de cada pixel
+        std::vector<float> albedo(3 * n), normal(3 * n), depth(n), gradient(n), variance(n);
+        for (size_t p = 0; p < n; p++) {
+            float scale = aovs.count[p] ? 1.0f / float(aovs.count[p]) : 0.0f;
+            for (int c = 0; c < 3; c++) {
+                albedo[3*p + c] = aovs.albedo[3*p + c] * scale;
+                normal[3*p + c] = aovs.normal[3*p + c] * scale;
+            }
+            depth[p] = aovs.depth[p] * scale;
+            uint32_t count = accum.count[p];
+            variance[p] = count < 2 ? 1e6f : float(accum.lum_m2[p] / (double(count - 1) * count));
+        }
+
+        // Variação da profundidade por pixel, pelas diferenças centrais
+        for (int j = 0; j < h; j++)
+            for (int i = 0; i < w; i++) {
+                auto z = [&](int x, int y) {
+                    return depth[size_t(std::clamp(y, 0, h - 1)) * w + size_t(std::clamp(x, 0, w - 1))];
+                };
+                gradient[size_t(j) * w + i] = 0.5f * std::max(std::fabs(z(i + 1, j) - z(i - 1, j)),
+                                                              std::fabs(z(i, j + 1) - z(i, j - 1)));
+            }
+
+        std::vector<float> in(image.pixels), out(3 * n), in_var(variance), out_var(n), deviation(n);
+        const int rows_per_task = 8;
+        int tasks = (h + rows_per_task - 1) / rows_per_task;
+
+        for (int iteration = 0; iteration < iterations; iteration++) {
+            int step = 1 << iteration;
+
+            // A variância usada nos pesos é suavizada num 3x3, porque a de um
+            // pixel só, estimada com poucas amostras, também é ruidosa
+            pool.run(tasks, [&](int task, int) {
+                for (int j = task * rows_per_task; j < std::min(h, (task + 1) * rows_per_task); j++)
+                    for (int i = 0; i < w; i++)
+                        deviation[size_t(j) * w + i] = std::sqrt(blur3x3(in_var, w, h, i, j));
+            });
+
+            pool.run(tasks, [&](int task, int) {
+                for (int j = task * rows_per_task; j < std::min(h, (task + 1) * rows_per_task); j++)
+                    for (int i = 0; i < w; i++)
+                        filter_pixel(i, j, step, w, h, in, in_var, deviation, albedo, normal, depth, gradient,
+                                     out, out_var);
+            });
+            in.swap(out);
+            in_var.swap(out_var);
+        }
+        image.pixels.swap(in);
+    }
+
+  private:
+    static float luminance(const float* c) {
+        return 0.2126f*c[0] + 0.7152f*c[1] + 0.0722f*c[2];
+    }
+
+    static float blur3x3(const std::vector<float>& v, int w, int h, int i, int j) {
+        static const float k[3] = { 0.25f, 0.5f, 0.25f };
+        float sum = 0, weight = 0;
+        for (int dy = -1; dy <= 1; dy++)
+            for (int dx = -1; dx <= 1; dx++) {
+                int x = i + dx, y = j + dy;
+                if (x < 0 || x >= w || y < 0 || y >= h)
+                    continue;
+                float kw = k[dx + 1] * k[dy + 1];
+                sum += kw * v[size_t(y) * w + x];
+                weight += kw;
+            }
+        return sum / weight;
+    }
+
+    void filter_pixel(int i, int j, int step, int w, int h,
+                      const std::vector<float>& in, const std::vector<float>& in_var,
+                      const std::vector<float>& deviation, const std::vector<float>& albedo,
+                      const std::vector<float>& normal, const std::vector<float>& depth,
+                      const std::vector<float>& gradient, std::vector<float>& out, std::vector<float>& out_var) const {
+        static const float kernel[5] = { 1.0f/16, 1.0f/4, 3.0f/8, 1.0f/4, 1.0f/16 };
+        size_t p = size_t(j) * w + i;
+        const float* cp = &in[3*p];
+        const float* ap = &albedo[3*p];
+        const float* np = &normal[3*p];
+        float lp = luminance(cp);
+        float zp = depth[p];
+        bool sky_p = np[0] == 0 && np[1] == 0 && np[2] == 0;
+
+        float depth_scale = float(sigma_depth) * gradient[p] * float(step) + 1e-3f * zp + 1e-6f;
+        float albedo_scale = float(1 / (sigma_albedo * sigma_albedo));
+
+        float sum[3] = { 0, 0, 0 }, sum_weight = 0, sum_var = 0;
+        for (int dy = -2; dy <= 2; dy++) {
+            int y = j + dy * step;
+            if (y < 0 || y >= h)
+                continue;
+            for (int dx = -2; dx <= 2; dx++) {
+                int x = i + dx * step;
+                if (x < 0 || x >= w)
+                    continue;
+                size_t q = size_t(y) * w + x;
+                const float* cq = &in[3*q];
+                const float* aq = &albedo[3*q];
+                const float* nq = &normal[3*q];
+
+                float weight = kernel[dx + 2] * kernel[dy + 2];
+                if (q != p) {
+                    // Normal: o céu (normal nula) só se mistura com o céu
+                    bool sky_q = nq[0] == 0 && nq[1] == 0 && nq[2] == 0;
+                    if (sky_p != sky_q)
+                        continue;
+                    float exponent = 0;
+                    if (!sky_p) {
+                        float cosine = np[0]*nq[0] + np[1]*nq[1] + np[2]*nq[2];
+                        if (!(cosine > 0))
+                            continue;
+                        exponent -= float(sigma_normal) * std::log(std::fmin(cosine, 1.0f));
+                    }
+
+                    float da[3] = { ap[0] - aq[0], ap[1] - aq[1], ap[2] - aq[2] };
+                    float color_scale = float(sigma_color) * std::fmax(deviation[p], deviation[q]) + 1e-6f;
+                    exponent += (da[0]*da[0] + da[1]*da[1] + da[2]*da[2]) * albedo_scale
+                              + std::fabs(zp - depth[q]) / (depth_scale * std::sqrt(float(dx*dx + dy*dy)))
+                              + std::fabs(lp - luminance(cq)) / color_scale;
+                    weight *= std::exp(-exponent);
+                }
+
+                for (int c = 0; c < 3; c++)
+                    sum[c] += weight * cq[c];
+                sum_weight += weight;
+                sum_var += weight * weight * in_var[q];
+            }
+        }
+
+        // O pixel central sempre entra, então sum_weight > 0
+        for (int c = 0; c < 3; c++)
+            out[3*p + c] = sum[c] / sum_weight;
+        out_var[p] = sum_var / (sum_weight * sum_weight);
+    }
+};
+
+#endif
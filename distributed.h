@@ -0,0 +1,448 @@
+#ifndef DISTRIBUTED_H
+#define DISTRIBUTED_H
+
+#include "accumulation_buffer.h"
+#include "camera.h"
+#include "framebuffer.h"
+#include "net.h"
+#include "scene.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Render distribuído entre processos, na mesma máquina ou em várias.
+//
+// O coordenador carrega a cena, escuta num endereço (net.h) e divide a imagem
+// em blocos. Cada worker que se conecta recebe a cena inteira (no formato
+// .rtbin, com a BVH pronta) e pede blocos um de cada vez; renderiza o bloco
+// com todas as suas threads (camera::render_region) e devolve as somas e
+// contagens de amostras de cada pixel, que o coordenador copia para o seu
+// buffer de acumulação. Como cada pixel só depende das próprias amostras, a
+// imagem final é idêntica à do render local.
+//
+// Tolerância a falhas: o bloco de um worker que desconecta (ou que passa de
+// 'timeout' segundos nele) volta para a fila. Quando a fila acaba e há
+// workers ociosos, um bloco que está demorando mais que slow_factor vezes a
+// mediana é entregue também a um deles, e vale o resultado que chegar antes.
+// O coordenador nunca espera por um worker: o que ele envia fica na caixa de
+// saída da conexão (net_outbox) e sai quando o socket aceita, então um worker
+// que parou de ler não atrasa os resultados, conexões e prazos dos outros.
+
+struct distributed_options {
+    int    block_size  = 64;  // Lado dos blocos entregues aos workers
+    double slow_factor = 3;   // Reenvio de blocos lentos, em múltiplos da mediana
+    double timeout     = 0;   // Segundos com um bloco antes de desconectar o worker (0 = sem limite)
+};
+
+// Tipos de mensagem
+enum : uint32_t {
+    msg_hello = 1,  // worker -> coordenador: versão do protocolo e sizeof(real)
+    msg_scene,      // coordenador -> worker: parâmetros e cena binária
+    msg_ready,      // worker -> coordenador: cena carregada, pronto para blocos
+    msg_block,      // coordenador -> worker: bloco a renderizar
+    msg_result,     // worker -> coordenador: somas e contagens do bloco
+    msg_done,       // coordenador -> worker: não há mais trabalho
+    msg_error       // qualquer lado: texto do erro, antes de desconectar
+};
+
+constexpr uint32_t distributed_protocol_version = 1;
+
+inline net_message error_message(const std::string& text) {
+    net_message m;
+    m.type = msg_error;
+    m.put_bytes(text.data(), text.size());
+    return m;
+}
+
+
+#ifndef RT_NO_SOCKETS
+
+// Renderiza a cena com os workers que se conectarem em 'address' e deixa o
+// resultado em 'image'. Só retorna quando todos os blocos estiverem prontos.
+inline bool render_coordinator(const std::string& address, const scene& world, const distributed_options& opts,
+                               framebuffer& image, std::string& error) {
+    using clock = std::chrono::steady_clock;
+
+    socket_handle listener;
+    if (!listen_on(address, listener, error))
+        return false;
+    set_nonblocking(listener);
+
+    // Parâmetros que o .rtbin não guarda, seguidos da própria cena. O campo
+    // reservado mantém a cena alinhada em 16 bytes dentro da mensagem. A
+    // mensagem é codificada uma vez e compartilhada pelas caixas de saída.
+    const camera& cam = world.cam;
+    net_encoded scene_msg;
+    {
+        std::ostringstream bin(std::ios::binary);
+        if (!write_scene_binary(bin, world)) {
+            error = "não foi possível serializar a cena";
+            return false;
+        }
+        std::string bytes = bin.str();
+        net_message m;
+        m.type = msg_scene;
+        m.put(uint32_t(cam.sampler));
+        m.put(uint32_t(cam.integrator));
+        m.put(int32_t(cam.wavefront_size));
+        m.put(uint32_t(0));
+        m.put_bytes(bytes.data(), bytes.size());
+        scene_msg = encode_message(m);
+    }
+
+    int width = cam.image_width, height = cam.height();
+    accumulation_buffer accum;
+    accum.resize(width, height);
+
+    struct block {
+        int x0, y0, x1, y1;
+        bool done = false;
+        int in_flight = 0;  // Workers com o bloco em mãos
+    };
+    std::vector<block> blocks;
+    int size = std::max(1, opts.block_size);
+    for (int y = 0; y < height; y += size)
+        for (int x = 0; x < width; x += size)
+            blocks.push_back({x, y, std::min(x + size, width), std::min(y + size, height)});
+    std::deque<int> queue;
+    for (int b = 0; b < int(blocks.size()); b++)
+        queue.push_back(b);
+    int remaining = int(blocks.size());
+
+    struct connection {
+        socket_handle sock;
+        net_inbox inbox;
+        net_outbox outbox;
+        int id = 0;
+        bool ready = false;
+        bool dead = false;
+        int block = -1;
+        clock::time_point start;
+    };
+    std::vector<std::unique_ptr<connection>> conns;
+    std::vector<double> durations;  // Segundos de cada bloco concluído
+    int next_id = 0;
+
+    auto drop = [&](connection& c, const std::string& reason) {
+        if (c.dead)
+            return;
+        std::clog << "\nWorker " << c.id << " desconectado: " << reason << '\n';
+        c.dead = true;
+        if (c.block >= 0) {
+            block& b = blocks[size_t(c.block)];
+            if (--b.in_flight == 0 && !b.done)
+                queue.push_front(c.block);
+            c.block = -1;
+        }
+    };
+
+    // Envia o que o socket aceitar agora; o resto sai quando o poll indicar POLLOUT
+    auto flush = [&](connection& c) {
+        if (!c.dead && !c.outbox.write_to(c.sock))
+            drop(c, "falha ao enviar");
+    };
+
+    auto handle = [&](connection& c, const net_message& m) {
+        net_reader in(m);
+        if (m.type == msg_hello) {
+            uint32_t version = 0, real_size = 0;
+            in.get(version);
+            in.get(real_size);
+            if (version != distributed_protocol_version || real_size != sizeof(real)) {
+                // Melhor esforço: a conexão é fechada em seguida
+                c.outbox.push(error_message(real_size != sizeof(real)
+                    ? "precisão diferente da do coordenador (RT_USE_FLOAT)" : "versão de protocolo diferente"));
+                c.outbox.write_to(c.sock);
+                drop(c, "incompatível");
+                return;
+            }
+            c.outbox.push(scene_msg);
+            flush(c);
+        } else if (m.type == msg_ready) {
+            c.ready = true;
+        } else if (m.type == msg_result) {
+            int32_t id = -1;
+            in.get(id);
+            if (id != c.block) {
+                drop(c, "resultado de um bloco que não foi pedido");
+                return;
+            }
+            block& b = blocks[size_t(id)];
+            size_t w = size_t(b.x1 - b.x0), h = size_t(b.y1 - b.y0);
+            if (in.remaining() != w * h * (3 * sizeof(double) + sizeof(uint32_t))) {
+                drop(c, "resultado com tamanho errado");
+                return;
+            }
+            if (!b.done) {
+                for (int j = b.y0; j < b.y1; j++)
+                    in.get_bytes(&accum.sum[3 * accum.index(b.x0, j)], 3 * w * sizeof(double));
+                for (int j = b.y0; j < b.y1; j++)
+                    in.get_bytes(&accum.count[accum.index(b.x0, j)], w * sizeof(uint32_t));
+                b.done = true;
+                remaining--;
+                durations.push_back(std::chrono::duration<double>(clock::now() - c.start).count());
+            }
+            b.in_flight--;
+            c.block = -1;
+        } else if (m.type == msg_error) {
+            drop(c, std::string(m.payload.begin(), m.payload.end()));
+        } else {
+            drop(c, "mensagem desconhecida");
+        }
+    };
+
+    auto assign = [&](connection& c, int b) {
+        net_message m;
+        m.type = msg_block;
+        m.put(int32_t(b));
+        m.put(int32_t(blocks[size_t(b)].x0));
+        m.put(int32_t(blocks[size_t(b)].y0));
+        m.put(int32_t(blocks[size_t(b)].x1));
+        m.put(int32_t(blocks[size_t(b)].y1));
+        c.block = b;
+        c.start = clock::now();
+        blocks[size_t(b)].in_flight++;
+        c.outbox.push(m);
+        flush(c);
+    };
+
+    int shown_remaining = -1;
+    size_t shown_workers = 0;
+    std::clog << "Coordenador em " << address << ": " << blocks.size() << " blocos\n";
+    while (remaining > 0) {
+        std::vector<pollfd> fds;
+        fds.push_back({ listener.get(), POLLIN, 0 });
+        for (auto& c : conns)
+            fds.push_back({ c->sock.get(), short(c->outbox.empty() ? POLLIN : POLLIN | POLLOUT), 0 });
+        ::poll(fds.data(), fds.size(), 100);
+
+        // Novos workers
+        if (fds[0].revents & POLLIN) {
+            while (true) {
+                int fd = ::accept(listener.get(), nullptr, nullptr);
+                if (fd < 0)
+                    break;
+                auto c = std::make_unique<connection>();
+                c->sock = socket_handle(fd);
+                c->id = next_id++;
+                set_nonblocking(c->sock);
+                conns.push_back(std::move(c));
+            }
+        }
+
+        for (size_t k = 0; k + 1 < fds.size(); k++) {
+            connection& c = *conns[k];
+            if (fds[k + 1].revents & POLLOUT)
+                flush(c);
+            if (!(fds[k + 1].revents & (POLLIN | POLLHUP | POLLERR)))
+                continue;
+            bool open = c.inbox.read_from(c.sock);
+            net_message m;
+            bool corrupt = false;
+            while (!c.dead && c.inbox.next(m, corrupt))
+                handle(c, m);
+            if (corrupt)
+                drop(c, "mensagem corrompida");
+            if (!open)
+                drop(c, "conexão fechada");
+        }
+
+        // Workers que passaram do limite de tempo num bloco
+        auto now = clock::now();
+        if (opts.timeout > 0)
+            for (auto& c : conns)
+                if (c->block >= 0 && std::chrono::duration<double>(now - c->start).count() > opts.timeout)
+                    drop(*c, "tempo esgotado no bloco");
+
+        conns.erase(std::remove_if(conns.begin(), conns.end(), [](const std::unique_ptr<connection>& c) {
+                        return c->dead;
+                    }), conns.end());
+
+        // Entrega blocos aos workers ociosos
+        double median = 0;
+        if (!durations.empty()) {
+            std::vector<double> sorted = durations;
+            std::nth_element(sorted.begin(), sorted.begin() + std::ptrdiff_t(sorted.size() / 2), sorted.end());
+            median = sorted[sorted.size() / 2];
+        }
+        for (auto& c : conns) {
+            if (c->dead || !c->ready || c->block >= 0)
+                continue;
+            while (!queue.empty() && blocks[size_t(queue.front())].done)
+                queue.pop_front();
+            if (!queue.empty()) {
+                int b = queue.front();
+                queue.pop_front();
+                assign(*c, b);
+                continue;
+            }
+
+            // Fila vazia: duplica o bloco mais atrasado, se estiver lento demais
+            if (durations.empty())
+                continue;
+            connection* slowest = nullptr;
+            for (auto& other : conns)
+                if (other->block >= 0 && !blocks[size_t(other->block)].done
+                    && blocks[size_t(other->block)].in_flight == 1
+                    && (!slowest || other->start < slowest->start))
+                    slowest = other.get();
+            if (slowest && std::chrono::duration<double>(now - slowest->start).count() > opts.slow_factor * median) {
+                std::clog << "\nBloco " << slowest->block << " atrasado no worker " << slowest->id
+                          << "; reenviado ao worker " << c->id << '\n';
+                assign(*c, slowest->block);
+            }
+        }
+
+        if (remaining != shown_remaining || conns.size() != shown_workers) {
+            shown_remaining = remaining;
+            shown_workers = conns.size();
+            std::clog << "\rBlocos restantes: " << remaining << ", workers: " << conns.size() << "   " << std::flush;
+        }
+    }
+
+    // Avisa os workers que acabou, esperando no máximo alguns segundos pelos
+    // que ainda têm dados na caixa de saída
+    net_message done;
+    done.type = msg_done;
+    for (auto& c : conns) {
+        c->outbox.push(done);
+        flush(*c);
+    }
+    auto deadline = clock::now() + std::chrono::seconds(5);
+    while (clock::now() < deadline) {
+        std::vector<pollfd> fds;
+        std::vector<connection*> pending;
+        for (auto& c : conns) {
+            if (!c->dead && !c->outbox.empty()) {
+                fds.push_back({ c->sock.get(), POLLOUT, 0 });
+                pending.push_back(c.get());
+            }
+        }
+        if (pending.empty())
+            break;
+        ::poll(fds.data(), fds.size(), 100);
+        for (size_t k = 0; k < pending.size(); k++)
+            if (fds[k].revents & (POLLOUT | POLLHUP | POLLERR))
+                flush(*pending[k]);
+    }
+    std::clog << "\rConcluído: " << blocks.size() << " blocos                    \n";
+
+    // O arquivo de um socket local não some sozinho quando o socket é fechado
+    if (address.compare(0, 5, "unix:") == 0)
+        ::unlink(address.c_str() + 5);
+
+    accum.resolve(image);
+    return true;
+}
+
+// Conecta-se ao coordenador em 'address' e renderiza os blocos que ele
+// mandar até receber msg_done
+inline bool render_worker(const std::string& address, int num_threads, std::string& error) {
+    // O coordenador pode ainda não estar escutando: tenta por alguns segundos
+    socket_handle sock;
+    for (int attempt = 0; !connect_to(address, sock, error); attempt++) {
+        if (attempt == 50)
+            return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
+
+    net_message m;
+    m.type = msg_hello;
+    m.put(distributed_protocol_version);
+    m.put(uint32_t(sizeof(real)));
+    if (!send_message(sock, m) || !recv_message(sock, m)) {
+        error = "conexão perdida com o coordenador";
+        return false;
+    }
+    if (m.type == msg_error) {
+        error = std::string(m.payload.begin(), m.payload.end());
+        return false;
+    }
+
+    net_reader in(m);
+    uint32_t sampler = 0, integrator = 0, reserved = 0;
+    int32_t wavefront_size = 0;
+    scene world;
+    if (m.type != msg_scene || !in.get(sampler) || !in.get(integrator) || !in.get(wavefront_size)
+        || !in.get(reserved) || !load_scene_binary(in.position(), in.remaining(), world, error)) {
+        if (error.empty())
+            error = "mensagem de cena inválida";
+        return false;
+    }
+
+    camera& cam = world.cam;
+    cam.sampler = sample_pattern(sampler);
+    cam.integrator = integrator_type(integrator);
+    cam.wavefront_size = wavefront_size;
+    cam.num_threads = num_threads;
+    std::clog << "Cena recebida: " << world.spheres.size() << " esferas, "
+              << world.instances.size() << " instâncias\n";
+
+    thread_pool pool(num_threads);
+    accumulation_buffer accum;
+    net_message ready;
+    ready.type = msg_ready;
+    if (!send_message(sock, ready)) {
+        error = "conexão perdida com o coordenador";
+        return false;
+    }
+
+    while (recv_message(sock, m)) {
+        if (m.type == msg_done)
+            return true;
+        if (m.type != msg_block) {
+            error = "mensagem inesperada do coordenador";
+            return false;
+        }
+
+        net_reader block(m);
+        int32_t id, x0, y0, x1, y1;
+        if (!block.get(id) || !block.get(x0) || !block.get(y0) || !block.get(x1) || !block.get(y1)
+            || x0 < 0 || y0 < 0 || x1 <= x0 || y1 <= y0 || x1 > cam.image_width || y1 > cam.height()) {
+            error = "bloco inválido";
+            return false;
+        }
+        std::clog << "Bloco " << id << " (" << x0 << ',' << y0 << ")-(" << x1 << ',' << y1 << ")\n";
+        cam.render_region(pool, world.root(), world.materials, accum, x0, y0, x1, y1);
+
+        // Somas (3 doubles por pixel) e contagens, linha por linha
+        size_t w = size_t(x1 - x0);
+        net_message result;
+        result.type = msg_result;
+        result.put(id);
+        for (int j = y0; j < y1; j++)
+            result.put_bytes(&accum.sum[3 * accum.index(x0, j)], 3 * w * sizeof(double));
+        for (int j = y0; j < y1; j++)
+            result.put_bytes(&accum.count[accum.index(x0, j)], w * sizeof(uint32_t));
+        // Se o envio falhar, o coordenador pode ter terminado com a cópia de
+        // outro worker deste bloco; a leitura seguinte ainda recebe o msg_done
+        send_message(sock, result);
+    }
+
+    error = "conexão perdida com o coordenador";
+    return false;
+}
+
+#else
+
+inline bool render_coordinator(const std::string&, const scene&, const distributed_options&, framebuffer&,
+                               std::string& error) {
+    error = "render distribuído não é suportado nesta plataforma";
+    return false;
+}
+
+inline bool render_worker(const std::string&, int, std::string& error) {
+    error = "render distribuído não é suportado nesta plataforma";
+    return false;
+}
+
+#endif
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef FILE_BLOCKS_H
+#define FILE_BLOCKS_H
+
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <vector>
+
+
+// Escrita dos formatos binários (.rtbin e .rtmesh): um cabeçalho fixo seguido
+// de blocos de dados, cada um começando num múltiplo de 64 bytes, na ordem de
+// bytes da máquina. As posições dos blocos vão para campos do cabeçalho (ou de
+// outro bloco), que o leitor usa para achar cada array no arquivo mapeado.
+
+struct file_block {
+    uint64_t* offset;  // Onde anotar a posição do bloco no arquivo
+    const void* data;
+    size_t size;
+};
+
+// Posiciona os blocos depois do cabeçalho e grava tudo. Os campos de posição
+// são preenchidos antes da escrita, então podem estar no próprio cabeçalho ou
+// num bloco gravado depois.
+inline bool write_file_blocks(std::ostream& file, const void* header, size_t header_size,
+                              const std::vector<file_block>& blocks) {
+    auto align = [](uint64_t x) { return (x + 63) & ~uint64_t(63); };
+    uint64_t pos = align(header_size);
+    for (auto& b : blocks) {
+        *b.offset = pos;
+        pos = align(pos + b.size);
+    }
+
+    static const char zeros[64] = {};
+    file.write(static_cast<const char*>(header), std::streamsize(header_size));
+    uint64_t written = header_size;
+    for (auto& b : blocks) {
+        file.write(zeros, std::streamsize(*b.offset - written));
+        file.write(static_cast<const char*>(b.data), std::streamsize(b.size));
+        written = *b.offset + b.size;
+    }
+    return bool(file);
+}
+
+// Confere se 'count' elementos de 'element' bytes a partir de 'offset' cabem
+// num arquivo de 'size' bytes, sem estourar nas contas
+inline bool file_array_fits(uint64_t size, uint64_t offset, uint64_t count, uint64_t element) {
+    return count <= size / element && offset <= size && offset + count * element <= size;
+}
+
+// Array de 'count' elementos T na posição 'offset' de um arquivo já conferido
+// com file_array_fits. Os blocos começam em múltiplos de 64 bytes, então num
+// arquivo mapeado o ponteiro aponta direto para o mapeamento; só quando os bytes
+// vêm de um buffer desalinhado (uma mensagem de rede, por exemplo) o array é
+// copiado para 'copy'.
+template <typename T>
+const T* file_array(const char* bytes, uint64_t offset, uint64_t count, std::vector<T>& copy) {
+    const char* p = bytes + offset;
+    if (reinterpret_cast<uintptr_t>(p) % alignof(T) == 0)
+        return reinterpret_cast<const T*>(p);
+    copy.resize(size_t(count));
+    std::memcpy(copy.data(), p, size_t(count) * sizeof(T));
+    return copy.data();
+}
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef FRAME_WRITER_H
+#define FRAME_WRITER_H
+
+#include "framebuffer.h"
+#include "image_writer.h"
+
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Nome do arquivo de um quadro: a sequência de '#' no padrão vira o número do
+// quadro com zeros à esquerda (quadro_####.png -> quadro_0007.png). Sem '#',
+// o número é inserido antes da extensão.
+inline std::string frame_file_name(const std::string& pattern, int frame) {
+    auto first = pattern.find('#');
+    if (first == std::string::npos) {
+        auto dot = pattern.rfind('.');
+        auto slash = pattern.find_last_of("/\\");
+        if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+            dot = pattern.size();
+        return frame_file_name(pattern.substr(0, dot) + "_####" + pattern.substr(dot), frame);
+    }
+
+    auto last = pattern.find_first_not_of('#', first);
+    if (last == std::string::npos)
+        last = pattern.size();
+
+    char digits[32];
+    std::snprintf(digits, sizeof digits, "%0*d", int(last - first), frame);
+    return pattern.substr(0, first) + digits + pattern.substr(last);
+}
+
+// Escreve os quadros de uma animação numa thread separada, para que a
+// codificação e a gravação do quadro k aconteçam enquanto o quadro k+1 é
+// renderizado. Há um único quadro em espera: write() só bloqueia se o quadro
+// anterior ainda não terminou de ser gravado.
+class frame_writer {
+  public:
+    frame_writer() : worker([this] { loop(); }) {}
+
+    ~frame_writer() {
+        finish();
+    }
+
+    frame_writer(const frame_writer&) = delete;
+    frame_writer& operator=(const frame_writer&) = delete;
+
+    // Entrega a imagem para ser gravada. A imagem é movida, e o chamador recebe
+    // de volta o buffer do quadro anterior (para reaproveitar a memória).
+    void write(const std::string& path, framebuffer& image, image_format format) {
+        std::unique_lock<std::mutex> lock(mutex);
+        idle.wait(lock, [this] { return !pending; });
+        std::swap(next_image, image);
+        next_path = path;
+        next_format = format;
+        pending = true;
+        ready.notify_one();
+    }
+
+    // Espera a gravação do último quadro e encerra a thread. Retorna false se
+    // algum arquivo não pôde ser escrito.
+    bool finish() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping)
+                return !failed;
+            stopping = true;
+        }
+        ready.notify_one();
+        worker.join();
+        return !failed;
+    }
+
+    // Arquivo que falhou por último (vazio se nenhum)
+    std::string failed_path() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return last_failure;
+    }
+
+  private:
+    mutable std::mutex mutex;
+    std::condition_variable ready, idle;
+    framebuffer next_image;
+    std::string next_path;
+    image_format next_format = image_format::ppm;
+    bool pending = false;
+    bool stopping = false;
+    bool failed = false;
+    std::string last_failure;
+    std::thread worker;  // Por último: só começa depois dos outros membros
+
+    void loop() {
+        framebuffer image;
+        while (true) {
+            std::string path;
+            image_format format;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                ready.wait(lock, [this] { return pending || stopping; });
+                if (!pending)
+                    return;
+                std::swap(image, next_image);
+                path = next_path;
+                format = next_format;
+            }
+
+            bool ok = write_image(path, image, format);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!ok) {
+                failed = true;
+                last_failure = path;
+            }
+            pending = false;
+            idle.notify_one();
+        }
+    }
+};
+
+#endif
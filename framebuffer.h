@@ -0,0 +1,42 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include "vec3.h"
+
+#include <vector>
+
+// Imagem em memória com as cores lineares de cada pixel em float (RGB),
+// linha por linha, de cima para baixo
+class framebuffer {
+  public:
+    int width  = 0;
+    int height = 0;
+    std::vector<float> pixels;  // 3 floats por pixel
+
+    framebuffer() {}
+    framebuffer(int width, int height)
+      : width(width), height(height), pixels(size_t(width) * height * 3, 0.0f) {}
+
+    void resize(int w, int h) {
+        width = w;
+        height = h;
+        pixels.assign(size_t(w) * h * 3, 0.0f);
+    }
+
+    color get(int i, int j) const {
+        const float* p = &pixels[index(i, j)];
+        return color(p[0], p[1], p[2]);
+    }
+
+    void set(int i, int j, const color& c) {
+        float* p = &pixels[index(i, j)];
+        p[0] = float(c.x());
+        p[1] = float(c.y());
+        p[2] = float(c.z());
+    }
+
+  private:
+    size_t index(int i, int j) const { return (size_t(j) * width + i) * 3; }
+};
+
+#endif
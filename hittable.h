@@ -4,28 +4,45 @@
 #include "rtweekend.h"
 #include "ray.h"
 #include "interval.h"
+#include "aabb.h"
 
-// Declaração antecipada da classe material
-class material;
+// Índice de um material na tabela de materiais da cena (material_table)
+using material_id = uint32_t;
 
 // Estrutura que armazena informações sobre uma interseção raio-objeto
-class hit_record {
+template <typename T>
+class basic_hit_record {
   public:
-    point3 p;                       // Ponto de interseção
-    vec3 normal;                    // Vetor normal no ponto de interseção
-    shared_ptr<material> mat;       // Material do objeto atingido
-    double t;                       // Parâmetro t do raio no ponto de interseção
+    basic_vec3<T> p;                // Ponto de interseção
+    basic_vec3<T> normal;           // Vetor normal no ponto de interseção
+    material_id mat;                // Material do objeto atingido (índice na tabela)
+    T t;                            // Parâmetro t do raio no ponto de interseção
+    T error = 0;                    // Limite do erro de arredondamento em cada coordenada de p
     bool front_face;                // Se a face atingida é a frontal (true) ou traseira (false)
 
     // Define a normal da superfície baseada no lado atingido pelo raio
-    void set_face_normal(const ray& r, const vec3& outward_normal) {
+    void set_face_normal(const basic_ray<T>& r, const basic_vec3<T>& outward_normal) {
         // Se o produto escalar for negativo, o raio está vindo de fora
         front_face = dot(r.direction(), outward_normal) < 0;
         // A normal sempre aponta contra o raio incidente
         normal = front_face ? outward_normal : -outward_normal;
     }
+
+    // Raio que parte do ponto de interseção na direção dada. A origem é
+    // afastada da superfície, para o lado em que o raio segue, por mais que o
+    // erro de p; assim o novo raio não acerta de novo a mesma superfície por
+    // causa de arredondamento, sem precisar de um t mínimo fixo que depende da
+    // escala da cena e da precisão usada.
+    basic_ray<T> spawn_ray(const basic_vec3<T>& direction) const {
+        T offset = 2 * error;
+        if (dot(direction, normal) < 0)
+            offset = -offset;
+        return basic_ray<T>(p + offset * normal, direction);
+    }
 };
 
+using hit_record = basic_hit_record<real>;
+
 // Classe base abstrata para todos os objetos que podem ser atingidos por raios
 class hittable {
   public:
@@ -33,8 +50,21 @@ class hittable {
     virtual ~hittable() = default;
 
     // Verifica se um raio atinge o objeto dentro de um intervalo de parâmetros
-    // Retorna true se houver interseção e preenche o registro de interseção
+    // Retorna true se houver interseção e preenche o registro de interseção.
+    // Quando não há interseção, rec não deve ser alterado.
     virtual bool hit(const ray& r, interval ray_t, hit_record& rec) const = 0;
+
+    // Consulta de oclusão (raios de sombra): só diz se há alguma interseção
+    // dentro do intervalo, e pode parar na primeira que encontrar, sem
+    // procurar a mais próxima nem preencher um hit_record. As estruturas com
+    // BVH a reimplementam; esta versão só serve de padrão.
+    virtual bool hit_any(const ray& r, interval ray_t) const {
+        hit_record rec;
+        return hit(r, ray_t, rec);
+    }
+
+    // Caixa delimitadora que envolve todo o objeto, usada pela BVH
+    virtual aabb bounding_box() const = 0;
 };
 
 #endif
\ No newline at end of file
@@ -2,9 +2,11 @@
 #define HITTABLE_LIST_H
 
 #include "hittable.h"
+#include "render_stats.h"
 #include "rtweekend.h"
 
 
+#include <utility>
 #include <vector>
 
 
@@ -19,31 +21,47 @@ class hittable_list : public hittable {
     hittable_list(shared_ptr<hittable> object) { add(object); }
 
     // Limpa a lista de objetos
-    void clear() { objects.clear(); }
+    void clear() { objects.clear(); bbox = aabb(); }
 
-    // Adiciona um objeto à lista
+    // Adiciona um objeto à lista. O objeto pode vir de make_shared ou de uma
+    // object_arena (arena.h), que guarda os objetos em blocos contíguos
     void add(shared_ptr<hittable> object) {
-        objects.push_back(object);
+        bbox = aabb(bbox, object->bounding_box());
+        objects.push_back(std::move(object));
     }
 
     // Verifica se algum objeto na lista é atingido pelo raio
     bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
-        hit_record temp_rec;
         bool hit_anything = false;
         auto closest_so_far = ray_t.max;  // Acompanha a interseção mais próxima
 
-        // Verifica interseção com cada objeto na lista
+        // Verifica interseção com cada objeto na lista. Como os objetos só escrevem
+        // em rec quando há acerto, o registro vai direto para rec, sem cópias.
         for (const auto& object : objects) {
+            RT_STAT(list_nodes_visited++);
             // Usa um intervalo que vai do mínimo até a interseção mais próxima até agora
-            if (object->hit(r, interval(ray_t.min, closest_so_far), temp_rec)) {
+            if (object->hit(r, interval(ray_t.min, closest_so_far), rec)) {
                 hit_anything = true;
-                closest_so_far = temp_rec.t;  // Atualiza a interseção mais próxima
-                rec = temp_rec;               // Salva o registro de interseção
+                closest_so_far = rec.t;  // Atualiza a interseção mais próxima
             }
         }
 
         return hit_anything;
     }
+
+    bool hit_any(const ray& r, interval ray_t) const override {
+        for (const auto& object : objects) {
+            RT_STAT(list_nodes_visited++);
+            if (object->hit_any(r, ray_t))
+                return true;
+        }
+        return false;
+    }
+
+    aabb bounding_box() const override { return bbox; }
+
+  private:
+    aabb bbox;  // Caixa que envolve todos os objetos da lista
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,150 @@
+#ifndef IMAGE_READER_H
+#define IMAGE_READER_H
+
+#include "framebuffer.h"
+#include "mapped_file.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+// Leitura das imagens que o renderizador escreve, de volta para um framebuffer
+// de cores lineares: PFM (float, exato) e PPM P6/P3 (8 bits por canal, com a
+// correção gama desfeita). PNG não é lido.
+
+// Leitor do cabeçalho dos formatos PNM: números separados por espaços, com
+// comentários iniciados por '#'
+class pnm_header_reader {
+  public:
+    pnm_header_reader(const char* data, size_t size) : p(data), end(data + size) {}
+
+    bool number(double& out) {
+        skip_space();
+        const char* start = p;
+        while (p < end && !std::isspace(static_cast<unsigned char>(*p)))
+            p++;
+        if (p == start)
+            return false;
+        std::string text(start, p);
+        char* parsed;
+        out = std::strtod(text.c_str(), &parsed);
+        return *parsed == '\0';
+    }
+
+    // Depois do último número do cabeçalho vem exatamente um caractere de espaço
+    const char* data_start() const { return (p < end) ? p + 1 : end; }
+
+  private:
+    const char* p;
+    const char* end;
+
+    void skip_space() {
+        while (p < end) {
+            if (*p == '#') {
+                while (p < end && *p != '\n')
+                    p++;
+            } else if (std::isspace(static_cast<unsigned char>(*p))) {
+                p++;
+            } else {
+                break;
+            }
+        }
+    }
+};
+
+inline bool decode_pfm(const char* data, size_t size, framebuffer& image, std::string& error) {
+    pnm_header_reader header(data + 2, size - 2);
+    double w, h, scale;
+    if (!header.number(w) || !header.number(h) || !header.number(scale) || w < 1 || h < 1) {
+        error = "cabeçalho PFM inválido";
+        return false;
+    }
+
+    const uint16_t probe = 1;
+    unsigned char first_byte;
+    std::memcpy(&first_byte, &probe, 1);
+    bool swap = (scale < 0) != (first_byte == 1);
+
+    image.resize(int(w), int(h));
+    size_t row_floats = size_t(image.width) * 3;
+    const char* pixels = header.data_start();
+    if (size_t(data + size - pixels) < row_floats * sizeof(float) * image.height) {
+        error = "PFM truncado";
+        return false;
+    }
+
+    // As linhas vêm de baixo para cima
+    for (int j = 0; j < image.height; j++) {
+        float* row = &image.pixels[size_t(image.height - 1 - j) * row_floats];
+        std::memcpy(row, pixels + j * row_floats * sizeof(float), row_floats * sizeof(float));
+        if (swap) {
+            for (size_t k = 0; k < row_floats; k++) {
+                unsigned char b[4];
+                std::memcpy(b, &row[k], 4);
+                std::swap(b[0], b[3]);
+                std::swap(b[1], b[2]);
+                std::memcpy(&row[k], b, 4);
+            }
+        }
+    }
+    return true;
+}
+
+inline bool decode_ppm(const char* data, size_t size, framebuffer& image, std::string& error) {
+    bool binary = data[1] == '6';
+    pnm_header_reader header(data + 2, size - 2);
+    double w, h, maxval;
+    if (!header.number(w) || !header.number(h) || !header.number(maxval)
+        || w < 1 || h < 1 || maxval < 1 || maxval > 255) {
+        error = "cabeçalho PPM inválido (só 8 bits por canal é suportado)";
+        return false;
+    }
+
+    image.resize(int(w), int(h));
+    size_t count = image.pixels.size();
+
+    // O valor gravado é sqrt(linear) (gama 2), então o linear é o quadrado
+    auto linear = [&](double v) { double g = v / maxval; return float(g * g); };
+
+    if (binary) {
+        const unsigned char* pixels = reinterpret_cast<const unsigned char*>(header.data_start());
+        if (size_t(reinterpret_cast<const unsigned char*>(data + size) - pixels) < count) {
+            error = "PPM truncado";
+            return false;
+        }
+        for (size_t k = 0; k < count; k++)
+            image.pixels[k] = linear(pixels[k]);
+    } else {
+        for (size_t k = 0; k < count; k++) {
+            double v;
+            if (!header.number(v)) {
+                error = "PPM truncado";
+                return false;
+            }
+            image.pixels[k] = linear(v);
+        }
+    }
+    return true;
+}
+
+// Lê uma imagem PFM ou PPM, reconhecida pelo cabeçalho
+inline bool read_image(const std::string& path, framebuffer& image, std::string& error) {
+    mapped_file file;
+    if (!file.open(path)) {
+        error = "não foi possível abrir " + path;
+        return false;
+    }
+
+    const char* data = file.data();
+    size_t size = file.size();
+    if (size >= 2 && data[0] == 'P' && data[1] == 'F')
+        return decode_pfm(data, size, image, error);
+    if (size >= 2 && data[0] == 'P' && (data[1] == '6' || data[1] == '3'))
+        return decode_ppm(data, size, image, error);
+
+    error = "formato de imagem não suportado (use PFM ou PPM)";
+    return false;
+}
+
+#endif
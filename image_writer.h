@@ -0,0 +1,219 @@
+#ifndef IMAGE_WRITER_H
+#define IMAGE_WRITER_H
+
+#include "color.h"
+#include "framebuffer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+
+// Formatos de saída. Todos são gerados inteiros num buffer em memória e
+// escritos de uma só vez, sem formatação por pixel no stream.
+enum class image_format {
+    ppm_text,  // PPM P3 (texto), o formato original
+    ppm,       // PPM P6 (binário, 8 bits por canal, com correção gama)
+    png16,     // PNG RGB de 16 bits por canal, com correção gama
+    pfm        // PFM (float linear, sem correção gama)
+};
+
+using byte_buffer = std::vector<unsigned char>;
+
+inline void append(byte_buffer& out, const std::string& text) {
+    out.insert(out.end(), text.begin(), text.end());
+}
+
+inline void append_u32_be(byte_buffer& out, uint32_t x) {
+    out.push_back((unsigned char)(x >> 24));
+    out.push_back((unsigned char)(x >> 16));
+    out.push_back((unsigned char)(x >> 8));
+    out.push_back((unsigned char)(x));
+}
+
+inline byte_buffer encode_ppm_text(const framebuffer& image) {
+    byte_buffer out;
+    append(out, "P3\n" + std::to_string(image.width) + ' ' + std::to_string(image.height) + "\n255\n");
+
+    char line[16];
+    for (size_t k = 0; k < image.pixels.size(); k += 3) {
+        int n = std::snprintf(line, sizeof line, "%d %d %d\n",
+                              to_byte(image.pixels[k]), to_byte(image.pixels[k+1]), to_byte(image.pixels[k+2]));
+        out.insert(out.end(), line, line + n);
+    }
+    return out;
+}
+
+// Cabeçalhos dos formatos binários, também usados por streamed_image
+inline std::string ppm_header(int width, int height) {
+    return "P6\n" + std::to_string(width) + ' ' + std::to_string(height) + "\n255\n";
+}
+
+inline std::string pfm_header(int width, int height) {
+    // A escala negativa indica little-endian; positiva, big-endian
+    const uint16_t probe = 1;
+    unsigned char first_byte;
+    std::memcpy(&first_byte, &probe, 1);
+    bool little_endian = first_byte == 1;
+    return "PF\n" + std::to_string(width) + ' ' + std::to_string(height) + (little_endian ? "\n-1.0\n" : "\n1.0\n");
+}
+
+inline byte_buffer encode_ppm(const framebuffer& image) {
+    byte_buffer out;
+    append(out, ppm_header(image.width, image.height));
+
+    size_t header = out.size();
+    out.resize(header + image.pixels.size());
+    for (size_t k = 0; k < image.pixels.size(); k++)
+        out[header + k] = to_byte(image.pixels[k]);
+    return out;
+}
+
+inline byte_buffer encode_pfm(const framebuffer& image) {
+    byte_buffer out;
+    append(out, pfm_header(image.width, image.height));
+
+    // O PFM guarda as linhas de baixo para cima
+    size_t row_bytes = size_t(image.width) * 3 * sizeof(float);
+    size_t header = out.size();
+    out.resize(header + row_bytes * image.height);
+    for (int j = 0; j < image.height; j++) {
+        const float* row = &image.pixels[size_t(image.height - 1 - j) * image.width * 3];
+        std::memcpy(&out[header + row_bytes * j], row, row_bytes);
+    }
+    return out;
+}
+
+// CRC-32 usado pelos blocos do PNG
+inline uint32_t crc32(const unsigned char* data, size_t size, uint32_t crc = 0) {
+    static const auto table = [] {
+        std::vector<uint32_t> t(256);
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++)
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            t[n] = c;
+        }
+        return t;
+    }();
+
+    crc = ~crc;
+    for (size_t k = 0; k < size; k++)
+        crc = table[(crc ^ data[k]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+inline void append_png_chunk(byte_buffer& out, const char* type, const byte_buffer& data) {
+    append_u32_be(out, uint32_t(data.size()));
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    append_u32_be(out, crc32(&out[start], out.size() - start));
+}
+
+// PNG RGB de 16 bits. Os dados vão em blocos deflate sem compressão ("stored"),
+// o que dispensa zlib e mantém a escrita rápida.
+inline byte_buffer encode_png16(const framebuffer& image) {
+    // Linhas da imagem: um byte de filtro (0 = nenhum) seguido de RGB em 16 bits big-endian
+    size_t row_bytes = 1 + size_t(image.width) * 6;
+    byte_buffer raw(row_bytes * image.height);
+    for (int j = 0; j < image.height; j++) {
+        unsigned char* row = &raw[row_bytes * j];
+        row[0] = 0;
+        for (int i = 0; i < image.width * 3; i++) {
+            auto value = to_word(image.pixels[size_t(j) * image.width * 3 + i]);
+            row[1 + 2*i]     = (unsigned char)(value >> 8);
+            row[1 + 2*i + 1] = (unsigned char)(value);
+        }
+    }
+
+    // Stream zlib com blocos stored de até 65535 bytes e soma Adler-32 no final
+    byte_buffer zdata = { 0x78, 0x01 };
+    zdata.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+    size_t pos = 0;
+    do {
+        size_t len = std::min<size_t>(65535, raw.size() - pos);
+        bool last = pos + len == raw.size();
+        zdata.push_back(last ? 1 : 0);
+        zdata.push_back((unsigned char)(len & 0xff));
+        zdata.push_back((unsigned char)(len >> 8));
+        zdata.push_back((unsigned char)(~len & 0xff));
+        zdata.push_back((unsigned char)((~len >> 8) & 0xff));
+        zdata.insert(zdata.end(), raw.begin() + pos, raw.begin() + pos + len);
+        pos += len;
+    } while (pos < raw.size());
+
+    uint32_t a = 1, b = 0;
+    for (size_t k = 0; k < raw.size(); k++) {
+        a = (a + raw[k]) % 65521;
+        b = (b + a) % 65521;
+    }
+    append_u32_be(zdata, (b << 16) | a);
+
+    byte_buffer header;
+    append_u32_be(header, uint32_t(image.width));
+    append_u32_be(header, uint32_t(image.height));
+    header.insert(header.end(), { 16, 2, 0, 0, 0 });  // 16 bits, RGB, deflate, sem filtro, sem entrelaçamento
+
+    byte_buffer out = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    append_png_chunk(out, "IHDR", header);
+    append_png_chunk(out, "IDAT", zdata);
+    append_png_chunk(out, "IEND", {});
+    return out;
+}
+
+inline byte_buffer encode_image(const framebuffer& image, image_format format) {
+    switch (format) {
+        case image_format::ppm_text: return encode_ppm_text(image);
+        case image_format::png16:    return encode_png16(image);
+        case image_format::pfm:      return encode_pfm(image);
+        case image_format::ppm:      break;
+    }
+    return encode_ppm(image);
+}
+
+// Escolhe o formato pela extensão do arquivo (.ppm, .png, .pfm)
+inline image_format image_format_from_path(const std::string& path, image_format fallback = image_format::ppm) {
+    auto dot = path.rfind('.');
+    if (dot == std::string::npos)
+        return fallback;
+    auto ext = path.substr(dot + 1);
+    if (ext == "png") return image_format::png16;
+    if (ext == "pfm") return image_format::pfm;
+    if (ext == "ppm") return image_format::ppm;
+    return fallback;
+}
+
+// Escreve a imagem inteira num stream com uma única escrita
+inline void write_image(std::ostream& out, const framebuffer& image, image_format format) {
+    auto data = encode_image(image, format);
+    out.write(reinterpret_cast<const char*>(data.data()), std::streamsize(data.size()));
+    out.flush();
+}
+
+inline bool write_image(const std::string& path, const framebuffer& image, image_format format) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+    write_image(file, image, format);
+    return bool(file);
+}
+
+// No Windows a saída padrão abre em modo texto, que trocaria '\n' por "\r\n"
+// dentro dos dados binários
+inline void set_stdout_binary() {
+#ifdef _WIN32
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+}
+
+#endif
@@ -0,0 +1,92 @@
+#include "accumulation_buffer.h"
+#include "image_reader.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+// Compara duas imagens (PFM ou PPM) pixel a pixel e escreve um relatório em JSON.
+// Serve para medir a diferença entre builds (por exemplo float e double) ou
+// entre versões do renderizador com a mesma semente.
+// Uso:
+//   imgdiff <referencia> <imagem> [--threshold t]
+//
+// Os erros são calculados nas cores lineares, com cada canal limitado a [0,1]
+// (a faixa que aparece na imagem final). 'pixels_over_threshold' é a fração
+// de pixels em que algum canal difere mais que t (padrão: 0.05).
+
+int main(int argc, char** argv) {
+    if (argc != 3 && argc != 5) {
+        std::cerr << "Uso: imgdiff <referencia> <imagem> [--threshold t]\n";
+        return 2;
+    }
+
+    double threshold = 0.05;
+    if (argc == 5) {
+        if (std::string(argv[3]) != "--threshold") {
+            std::cerr << "Opção desconhecida: " << argv[3] << '\n';
+            return 2;
+        }
+        threshold = std::atof(argv[4]);
+    }
+
+    framebuffer a, b;
+    std::string error;
+    if (!read_image(argv[1], a, error) || !read_image(argv[2], b, error)) {
+        std::cerr << error << '\n';
+        return 2;
+    }
+    if (a.width != b.width || a.height != b.height) {
+        std::cerr << "As imagens têm tamanhos diferentes: " << a.width << 'x' << a.height
+                  << " e " << b.width << 'x' << b.height << '\n';
+        return 2;
+    }
+
+    auto clamp01 = [](double x) { return x < 0 ? 0.0 : (x > 1 ? 1.0 : x); };
+
+    double sum_sq = 0, sum_abs = 0, sum_signed = 0, max_abs = 0;
+    double lum_a = 0, lum_b = 0;
+    size_t over = 0;
+    size_t pixel_count = size_t(a.width) * a.height;
+
+    for (int j = 0; j < a.height; j++) {
+        for (int i = 0; i < a.width; i++) {
+            color ca = a.get(i, j), cb = b.get(i, j);
+            double pixel_max = 0;
+            for (int c = 0; c < 3; c++) {
+                double d = clamp01(cb[c]) - clamp01(ca[c]);
+                sum_sq += d * d;
+                sum_abs += std::fabs(d);
+                sum_signed += d;
+                pixel_max = std::fmax(pixel_max, std::fabs(d));
+            }
+            max_abs = std::fmax(max_abs, pixel_max);
+            if (pixel_max > threshold)
+                over++;
+            lum_a += accumulation_buffer::luminance(ca);
+            lum_b += accumulation_buffer::luminance(cb);
+        }
+    }
+
+    double samples = double(pixel_count) * 3;
+    double rmse = std::sqrt(sum_sq / samples);
+    // PSNR com pico 1 (cores em [0,1]); imagens idênticas não têm PSNR finito
+    double psnr = rmse > 0 ? 20 * std::log10(1.0 / rmse) : 0;
+
+    std::cout << "{\n"
+              << "  \"reference\": \"" << argv[1] << "\",\n"
+              << "  \"image\": \"" << argv[2] << "\",\n"
+              << "  \"width\": " << a.width << ",\n"
+              << "  \"height\": " << a.height << ",\n"
+              << "  \"identical\": " << (sum_sq == 0 ? "true" : "false") << ",\n"
+              << "  \"rmse\": " << rmse << ",\n"
+              << "  \"psnr_db\": " << (rmse > 0 ? std::to_string(psnr) : "null") << ",\n"
+              << "  \"mean_abs\": " << sum_abs / samples << ",\n"
+              << "  \"mean_bias\": " << sum_signed / samples << ",\n"
+              << "  \"max_abs\": " << max_abs << ",\n"
+              << "  \"mean_luminance_ratio\": " << (lum_a > 0 ? lum_b / lum_a : 0) << ",\n"
+              << "  \"threshold\": " << threshold << ",\n"
+              << "  \"pixels_over_threshold\": " << double(over) / double(pixel_count) << "\n"
+              << "}\n";
+}
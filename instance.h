@@ -0,0 +1,264 @@
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+#include "bvh.h"
+#include "hittable.h"
+#include "render_stats.h"
+#include "rtweekend.h"
+
+#include <cmath>
+#include <vector>
+
+
+// Transformação afim p -> M·p + t, guardada como uma matriz 3x4 (a última
+// coluna é a translação)
+class affine_transform {
+  public:
+    real m[3][4] = { {1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0} };
+
+    static affine_transform translate(const vec3& offset) {
+        affine_transform x;
+        for (int i = 0; i < 3; i++)
+            x.m[i][3] = offset[i];
+        return x;
+    }
+
+    static affine_transform scale(const vec3& factors) {
+        affine_transform x;
+        for (int i = 0; i < 3; i++)
+            x.m[i][i] = factors[i];
+        return x;
+    }
+
+    // Rotação de 'degrees' graus em torno do eixo dado (fórmula de Rodrigues)
+    static affine_transform rotate(const vec3& axis, double degrees) {
+        vec3 a = unit_vector(axis);
+        double s = std::sin(degrees_to_radians(degrees));
+        double c = std::cos(degrees_to_radians(degrees));
+        double k = 1 - c;
+
+        affine_transform x;
+        x.m[0][0] = real(a.x()*a.x()*k + c);        x.m[0][1] = real(a.x()*a.y()*k - a.z()*s);
+        x.m[0][2] = real(a.x()*a.z()*k + a.y()*s);
+        x.m[1][0] = real(a.y()*a.x()*k + a.z()*s);  x.m[1][1] = real(a.y()*a.y()*k + c);
+        x.m[1][2] = real(a.y()*a.z()*k - a.x()*s);
+        x.m[2][0] = real(a.z()*a.x()*k - a.y()*s);  x.m[2][1] = real(a.z()*a.y()*k + a.x()*s);
+        x.m[2][2] = real(a.z()*a.z()*k + c);
+        return x;
+    }
+
+    // Composição: aplica primeiro 'inner' e depois esta transformação
+    affine_transform operator*(const affine_transform& inner) const {
+        affine_transform x;
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 4; j++) {
+                x.m[i][j] = m[i][0]*inner.m[0][j] + m[i][1]*inner.m[1][j] + m[i][2]*inner.m[2][j];
+            }
+            x.m[i][3] += m[i][3];
+        }
+        return x;
+    }
+
+    point3 point(const point3& p) const {
+        return point3(m[0][0]*p.x() + m[0][1]*p.y() + m[0][2]*p.z() + m[0][3],
+                      m[1][0]*p.x() + m[1][1]*p.y() + m[1][2]*p.z() + m[1][3],
+                      m[2][0]*p.x() + m[2][1]*p.y() + m[2][2]*p.z() + m[2][3]);
+    }
+
+    vec3 vector(const vec3& v) const {
+        return vec3(m[0][0]*v.x() + m[0][1]*v.y() + m[0][2]*v.z(),
+                    m[1][0]*v.x() + m[1][1]*v.y() + m[1][2]*v.z(),
+                    m[2][0]*v.x() + m[2][1]*v.y() + m[2][2]*v.z());
+    }
+
+    // Multiplica pela transposta da parte linear. Aplicada à inversa, leva as
+    // normais: elas continuam perpendiculares à superfície mesmo com escala
+    // não uniforme.
+    vec3 transposed(const vec3& n) const {
+        return vec3(m[0][0]*n.x() + m[1][0]*n.y() + m[2][0]*n.z(),
+                    m[0][1]*n.x() + m[1][1]*n.y() + m[2][1]*n.z(),
+                    m[0][2]*n.x() + m[1][2]*n.y() + m[2][2]*n.z());
+    }
+
+    real determinant() const {
+        return m[0][0] * (m[1][1]*m[2][2] - m[1][2]*m[2][1])
+             - m[0][1] * (m[1][0]*m[2][2] - m[1][2]*m[2][0])
+             + m[0][2] * (m[1][0]*m[2][1] - m[1][1]*m[2][0]);
+    }
+
+    // Inversa pela matriz adjunta; só vale se determinant() != 0
+    affine_transform inverse() const {
+        real inv_det = 1 / determinant();
+        affine_transform x;
+        x.m[0][0] = (m[1][1]*m[2][2] - m[1][2]*m[2][1]) * inv_det;
+        x.m[0][1] = (m[0][2]*m[2][1] - m[0][1]*m[2][2]) * inv_det;
+        x.m[0][2] = (m[0][1]*m[1][2] - m[0][2]*m[1][1]) * inv_det;
+        x.m[1][0] = (m[1][2]*m[2][0] - m[1][0]*m[2][2]) * inv_det;
+        x.m[1][1] = (m[0][0]*m[2][2] - m[0][2]*m[2][0]) * inv_det;
+        x.m[1][2] = (m[0][2]*m[1][0] - m[0][0]*m[1][2]) * inv_det;
+        x.m[2][0] = (m[1][0]*m[2][1] - m[1][1]*m[2][0]) * inv_det;
+        x.m[2][1] = (m[0][1]*m[2][0] - m[0][0]*m[2][1]) * inv_det;
+        x.m[2][2] = (m[0][0]*m[1][1] - m[0][1]*m[1][0]) * inv_det;
+        for (int i = 0; i < 3; i++)
+            x.m[i][3] = -(x.m[i][0]*m[0][3] + x.m[i][1]*m[1][3] + x.m[i][2]*m[2][3]);
+        return x;
+    }
+
+    // Caixa que envolve a caixa dada depois de transformada (os 8 cantos)
+    aabb box(const aabb& b) const {
+        aabb out;
+        for (int corner = 0; corner < 8; corner++) {
+            point3 p((corner & 1) ? b.x.max : b.x.min,
+                     (corner & 2) ? b.y.max : b.y.min,
+                     (corner & 4) ? b.z.max : b.z.min);
+            point3 q = point(p);
+            out = aabb(out, aabb(q, q));
+        }
+        return out;
+    }
+
+    // Limite do erro de cada coordenada de point(p), sabendo que cada
+    // coordenada de p já tem erro de até p_error: o erro de p propagado pela
+    // matriz mais o arredondamento das três multiplicações e somas
+    real point_error(const point3& p, real p_error) const {
+        real bound = 0;
+        for (int i = 0; i < 3; i++) {
+            real row = std::fabs(m[i][0]) + std::fabs(m[i][1]) + std::fabs(m[i][2]);
+            real magnitude = std::fabs(m[i][0]*p.x()) + std::fabs(m[i][1]*p.y()) + std::fabs(m[i][2]*p.z())
+                           + std::fabs(m[i][3]);
+            bound = std::fmax(bound, (1 + rounding_error<real>(3)) * row * p_error
+                                     + rounding_error<real>(3) * magnitude);
+        }
+        return bound;
+    }
+};
+
+
+// Material usado por instance quando a instância não troca o material da geometria
+constexpr material_id keep_material = ~material_id(0);
+
+// Cópia de uma geometria compartilhada (um sphere_batch, uma BVH, qualquer
+// hittable) posicionada por uma transformação afim, opcionalmente com outro
+// material. A geometria é guardada uma vez só; cada instância custa a
+// transformação, a sua inversa e a caixa.
+//
+// O raio é levado para o espaço do objeto sem normalizar a direção, então o t
+// do acerto vale nos dois espaços. O ponto, a normal e o erro do ponto voltam
+// para o espaço do mundo.
+class instance final : public hittable {
+  public:
+    // to_world precisa ser invertível (determinante diferente de zero)
+    instance(shared_ptr<const hittable> object, const affine_transform& to_world,
+             material_id mat = keep_material)
+      : object(std::move(object)), to_world(to_world), to_object(to_world.inverse()), mat(mat)
+    {
+        bbox = to_world.box(this->object->bounding_box());
+    }
+
+    const shared_ptr<const hittable>& geometry() const { return object; }
+    const affine_transform& transform() const { return to_world; }
+    material_id material_override() const { return mat; }
+
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        ray local(to_object.point(r.origin()), to_object.vector(r.direction()));
+        if (!object->hit(local, ray_t, rec))
+            return false;
+
+        rec.error = to_world.point_error(rec.p, rec.error);
+        rec.p = to_world.point(rec.p);
+        // A normal já aponta contra o raio local, e a transposta da inversa
+        // preserva o sinal do produto escalar com a direção: continua
+        // apontando contra o raio do mundo, e front_face não muda
+        rec.normal = unit_vector(to_object.transposed(rec.normal));
+        if (mat != keep_material)
+            rec.mat = mat;
+        return true;
+    }
+
+    bool hit_any(const ray& r, interval ray_t) const override {
+        return object->hit_any(ray(to_object.point(r.origin()), to_object.vector(r.direction())), ray_t);
+    }
+
+    aabb bounding_box() const override { return bbox; }
+
+  private:
+    shared_ptr<const hittable> object;
+    affine_transform to_world, to_object;
+    material_id mat;
+    aabb bbox;
+};
+
+
+// Conjunto de instâncias guardadas por valor num vetor contíguo, com uma BVH
+// própria sobre as suas caixas (como o sphere_batch faz com as esferas). Uma
+// multidão de instâncias não aloca nada por instância além do vetor.
+class instance_batch : public hittable {
+  public:
+    void add(const instance& item) {
+        items.push_back(item);
+    }
+
+    size_t size() const { return items.size(); }
+    const instance& operator[](size_t k) const { return items[k]; }
+
+    // Constrói a BVH e reordena as instâncias na ordem das folhas
+    void build() {
+        std::vector<aabb> boxes;
+        boxes.reserve(items.size());
+        for (const auto& item : items)
+            boxes.push_back(item.bounding_box());
+
+        tree.build(boxes);
+
+        std::vector<instance> sorted;
+        sorted.reserve(items.size());
+        for (auto index : tree.order)
+            sorted.push_back(items[index]);
+        items.swap(sorted);
+        tree.order.clear();
+
+        bbox = tree.bounds();
+    }
+
+    const std::vector<bvh_node>& nodes() const { return tree.nodes; }
+
+    // Restaura a partir de instâncias já na ordem das folhas e dos nós prontos
+    // (lidos de um arquivo de cena binário), sem reconstruir a BVH
+    void restore(std::vector<instance> sorted, const bvh_node* nodes, size_t node_count) {
+        items = std::move(sorted);
+        tree.nodes.assign(nodes, nodes + node_count);
+        tree.order.clear();
+        bbox = tree.bounds();
+    }
+
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        return tree.traverse(r, ray_t, [&](uint32_t first, uint32_t count, interval& t) {
+            bool hit_anything = false;
+            for (auto k = first; k < first + count; k++) {
+                if (items[k].hit(r, t, rec)) {
+                    hit_anything = true;
+                    t.max = rec.t;
+                }
+            }
+            return hit_anything;
+        });
+    }
+
+    bool hit_any(const ray& r, interval ray_t) const override {
+        return tree.occluded(r, ray_t, [&](uint32_t first, uint32_t count, interval& t) {
+            for (auto k = first; k < first + count; k++)
+                if (items[k].hit_any(r, t))
+                    return true;
+            return false;
+        });
+    }
+
+    aabb bounding_box() const override { return bbox; }
+
+  private:
+    std::vector<instance> items;
+    bvh_tree tree;
+    aabb bbox;
+};
+
+#endif
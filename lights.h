@@ -0,0 +1,134 @@
+#ifndef LIGHTS_H
+#define LIGHTS_H
+
+#include "rtweekend.h"
+#include "vec3.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+
+// Ponto escolhido numa luz por light_list::sample
+struct light_sample {
+    point3 p;
+    vec3   normal;          // Normal geométrica da luz em p
+    vec3   shading_normal;  // Normal que um acerto em p teria no hit_record (para os pesos de MIS)
+    color  emission;
+};
+
+// Lista das superfícies emissoras da cena, em coordenadas do mundo, para a
+// amostragem direta das luzes (next-event estimation): de um ponto difuso, a
+// câmera escolhe um ponto numa luz e testa só se ele é visível, em vez de
+// esperar que um rebote aleatório acerte a luz por acaso.
+//
+// Cada luz é escolhida com probabilidade proporcional à sua área "útil" e o
+// ponto é uniforme nessa área. A área útil de um triângulo é a área dele; a
+// de uma esfera é o hemisfério voltado para o ponto sombreado (2πr²), que
+// contém todo o pedaço da esfera que pode ser visto dali. Assim a densidade
+// por área é a mesma, 1 / total_area(), em todo ponto de luz que um raio pode
+// atingir, e a densidade de um acerto na luz vindo de um rebote (para o peso
+// de MIS) não depende de saber qual luz foi atingida.
+class light_list {
+  public:
+    void add_sphere(const point3& center, double radius, const color& emission) {
+        light l;
+        l.sphere = true;
+        l.a = center;
+        l.radius = radius;
+        l.emission = emission;
+        add(l, 2 * pi * radius * radius);
+    }
+
+    // Triângulo emissor, com as normais de sombreamento dos vértices se a malha
+    // as tiver (senão nulas: a normal de sombreamento é a geométrica)
+    void add_triangle(const point3& a, const point3& b, const point3& c, const color& emission,
+                      const vec3& na = vec3(), const vec3& nb = vec3(), const vec3& nc = vec3()) {
+        light l;
+        l.a = a;
+        l.e1 = b - a;
+        l.e2 = c - a;
+        l.na = na;
+        l.nb = nb;
+        l.nc = nc;
+        l.emission = emission;
+        vec3 n = cross(l.e1, l.e2);
+        add(l, 0.5 * n.length());
+    }
+
+    void clear() {
+        lights.clear();
+        cdf.clear();
+    }
+
+    bool empty() const { return lights.empty(); }
+    size_t size() const { return lights.size(); }
+    double total_area() const { return cdf.empty() ? 0 : cdf.back(); }
+
+    // Escolhe uma luz com u_pick e um ponto nela com (u, v), visto de 'origin'.
+    // Retorna false se a lista está vazia.
+    bool sample(const point3& origin, double u_pick, double u, double v, light_sample& out) const {
+        if (lights.empty())
+            return false;
+        auto found = std::upper_bound(cdf.begin(), cdf.end(), u_pick * cdf.back());
+        const light& l = lights[std::min<size_t>(size_t(found - cdf.begin()), lights.size() - 1)];
+        out.emission = l.emission;
+
+        if (l.sphere) {
+            // Ponto uniforme no hemisfério voltado para 'origin'
+            vec3 axis = origin - l.a;
+            axis = axis.near_zero() ? vec3(0, 0, 1) : unit_vector(axis);
+            vec3 t = unit_vector(cross(std::fabs(axis.x()) > 0.9 ? vec3(0, 1, 0) : vec3(1, 0, 0), axis));
+            vec3 b = cross(axis, t);
+            double z = u;
+            double r = std::sqrt(std::fmax(0.0, 1 - z*z));
+            double phi = 2 * pi * v;
+            vec3 d = r * std::cos(phi) * t + r * std::sin(phi) * b + z * axis;
+            out.p = l.a + l.radius * d;
+            out.normal = d;
+            out.shading_normal = d;
+            return true;
+        }
+
+        // Ponto uniforme no triângulo
+        double su = std::sqrt(u);
+        double b1 = su * (1 - v), b2 = su * v, b0 = 1 - b1 - b2;
+        out.p = l.a + b1 * l.e1 + b2 * l.e2;
+        out.normal = unit_vector(cross(l.e1, l.e2));
+        vec3 shading = b0 * l.na + b1 * l.nb + b2 * l.nc;
+        out.shading_normal = shading.length_squared() > 0 ? unit_vector(shading) : out.normal;
+        return true;
+    }
+
+    // Densidade, por ângulo sólido, de sample() gerar a direção até um ponto de
+    // luz a distância² 'distance_squared', cuja normal faz cosseno 'cosine'
+    // com a direção
+    double pdf(double distance_squared, double cosine) const {
+        cosine = std::fabs(cosine);
+        if (!(cosine > 0))
+            return infinity;
+        return distance_squared / (cosine * cdf.back());
+    }
+
+  private:
+    struct light {
+        bool   sphere = false;
+        point3 a;           // Centro da esfera ou primeiro vértice do triângulo
+        vec3   e1, e2;      // Arestas do triângulo
+        vec3   na, nb, nc;  // Normais de sombreamento dos vértices (nulas se não houver)
+        double radius = 0;
+        color  emission;
+    };
+
+    std::vector<light> lights;
+    std::vector<double> cdf;  // Soma das áreas úteis até cada luz, inclusive
+
+    void add(const light& l, double area) {
+        if (!(area > 0))
+            return;  // Degenerada: nunca é atingida
+        lights.push_back(l);
+        cdf.push_back(total_area() + area);
+    }
+};
+
+#endif
@@ -1,4 +1,6 @@
 #include "rtweekend.h"
+#include "arena.h"
+#include "bvh.h"
 #include "camera.h"
 #include "hittable.h"
 #include "hittable_list.h"
@@ -6,30 +8,36 @@
 #include "sphere.h"
 
 int main() {
+    material_table materials;
+    // As esferas ficam em blocos contíguos da arena, liberados juntos no fim
+    object_arena arena;
     hittable_list world;
 
     // chão
-    auto ground_material = make_shared<lambertian>(color(0.5, 0.5, 0.5));
-    world.add(make_shared<sphere>(point3(0,-1000,0), 1000, ground_material));
+    auto ground_material = materials.add(lambertian(color(0.5, 0.5, 0.5)));
+    world.add(arena.make<sphere>(point3(0,-1000,0), 1000, ground_material));
 
     // esfera de vidro (central)
-    auto material1 = make_shared<dielectric>(1.5);
-    world.add(make_shared<sphere>(point3(0, 1, 0), 1.0, material1));
+    auto material1 = materials.add(dielectric(1.5));
+    world.add(arena.make<sphere>(point3(0, 1, 0), 1.0, material1));
 
     // Esfera Marrom Fosca (à esquerda)
-    auto material2 = make_shared<lambertian>(color(0.4, 0.2, 0.1));
-    world.add(make_shared<sphere>(point3(-2.5, 1, 0), 1.0, material2));
+    auto material2 = materials.add(lambertian(color(0.4, 0.2, 0.1)));
+    world.add(arena.make<sphere>(point3(-2.5, 1, 0), 1.0, material2));
 
     // Esfera de Metal (à direita)
-    auto material3 = make_shared<metal>(color(0.7, 0.6, 0.5), 0.0);
-    world.add(make_shared<sphere>(point3(2.5, 1, 0), 1.0, material3));
+    auto material3 = materials.add(metal(color(0.7, 0.6, 0.5), 0.0));
+    world.add(arena.make<sphere>(point3(2.5, 1, 0), 1.0, material3));
 
     // Pequenas esferas adicionais para enriquecer a cena
-    world.add(make_shared<sphere>(point3(1.5, 0.6, 1.5), 0.6, make_shared<metal>(color(0.8, 0.2, 0.2), 0.4)));
-    world.add(make_shared<sphere>(point3(-1.5, 0.6, 1.5), 0.6, make_shared<lambertian>(color(0.2, 0.8, 0.2))));
-    world.add(make_shared<sphere>(point3(0.0, 0.4, 2.0), 0.4, make_shared<dielectric>(1.5)));
-    world.add(make_shared<sphere>(point3(-0.8, 0.3, 2.8), 0.3, make_shared<metal>(color(0.2, 0.2, 0.8), 0.8)));
-    world.add(make_shared<sphere>(point3(0.8, 0.3, 2.8), 0.3, make_shared<lambertian>(color(0.8, 0.8, 0.2))));
+    world.add(arena.make<sphere>(point3(1.5, 0.6, 1.5), 0.6, materials.add(metal(color(0.8, 0.2, 0.2), 0.4))));
+    world.add(arena.make<sphere>(point3(-1.5, 0.6, 1.5), 0.6, materials.add(lambertian(color(0.2, 0.8, 0.2)))));
+    world.add(arena.make<sphere>(point3(0.0, 0.4, 2.0), 0.4, materials.add(dielectric(1.5))));
+    world.add(arena.make<sphere>(point3(-0.8, 0.3, 2.8), 0.3, materials.add(metal(color(0.2, 0.2, 0.8), 0.8))));
+    world.add(arena.make<sphere>(point3(0.8, 0.3, 2.8), 0.3, materials.add(lambertian(color(0.8, 0.8, 0.2)))));
+
+    // Organiza os objetos numa BVH para acelerar os testes de interseção
+    world = hittable_list(make_shared<bvh>(world));
 
     // Configurações de câmera e renderização
     camera cam;
@@ -51,7 +59,7 @@ int main() {
     cam.focus_dist    = 10.0; // Distância de foco
 
     // Iniciar o processo de renderização
-    cam.render(world);
+    cam.render(world, materials);
 }
 
 
@@ -1,4 +1,6 @@
 #include "rtweekend.h"
+#include "arena.h"
+#include "bvh.h"
 #include "camera.h"
 #include "hittable.h"
 #include "hittable_list.h"
@@ -6,19 +8,25 @@
 #include "sphere.h"
 
 int main() {
+    material_table materials;
+    // As esferas ficam em blocos contíguos da arena, liberados juntos no fim
+    object_arena arena;
     hittable_list world;
 
-    auto material_ground = make_shared<lambertian>(color(0.8, 0.8, 0.0));
-    auto material_center = make_shared<lambertian>(color(0.1, 0.2, 0.5));
-    auto material_left   = make_shared<dielectric>(1.50);
-    auto material_bubble = make_shared<dielectric>(1.00 / 1.50);
-    auto material_right  = make_shared<metal>(color(0.8, 0.6, 0.2), 1.0);
+    auto material_ground = materials.add(lambertian(color(0.8, 0.8, 0.0)));
+    auto material_center = materials.add(lambertian(color(0.1, 0.2, 0.5)));
+    auto material_left   = materials.add(dielectric(1.50));
+    auto material_bubble = materials.add(dielectric(1.00 / 1.50));
+    auto material_right  = materials.add(metal(color(0.8, 0.6, 0.2), 1.0));
 
-    world.add(make_shared<sphere>(point3( 0.0, -100.5, -1.0), 100.0, material_ground));  // Chão
-    world.add(make_shared<sphere>(point3( 0.0,    0.0, -1.2),   0.5, material_center));  
-    world.add(make_shared<sphere>(point3(-1.0,    0.0, -1.0),   0.5, material_left));    
-    world.add(make_shared<sphere>(point3(-1.0,    0.0, -1.0),   0.4, material_bubble));  
-    world.add(make_shared<sphere>(point3( 1.0,    0.0, -1.0),   0.5, material_right));   
+    world.add(arena.make<sphere>(point3( 0.0, -100.5, -1.0), 100.0, material_ground));  // Chão
+    world.add(arena.make<sphere>(point3( 0.0,    0.0, -1.2),   0.5, material_center));  
+    world.add(arena.make<sphere>(point3(-1.0,    0.0, -1.0),   0.5, material_left));    
+    world.add(arena.make<sphere>(point3(-1.0,    0.0, -1.0),   0.4, material_bubble));  
+    world.add(arena.make<sphere>(point3( 1.0,    0.0, -1.0),   0.5, material_right));   
+
+    // Organiza os objetos numa BVH para acelerar os testes de interseção
+    world = hittable_list(make_shared<bvh>(world));
 
     camera cam;
 
@@ -35,7 +43,7 @@ int main() {
     cam.defocus_angle = 10.0;  
     cam.focus_dist    = 3.4;
 
-    cam.render(world); 
+    cam.render(world, materials); 
 }
 
 // Configuração mais leve, mas ainda sim renderiza uma cena mais complexa, ideal para computadores medianos.
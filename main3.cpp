@@ -1,8 +1,20 @@
+#include "rtweekend.h"
+#include "bvh.h"
+#include "camera.h"
+#include "hittable.h"
+#include "hittable_list.h"
+#include "material.h"
+#include "sphere.h"
+#include "sphere_batch.h"
+
 int main() {
-    hittable_list world;
+    material_table materials;
+
+    // Todas as esferas da cena ficam num único sphere_batch, que as testa com SIMD
+    auto spheres = make_shared<sphere_batch>();
 
-    auto ground_material = make_shared<lambertian>(color(0.5, 0.5, 0.5));
-    world.add(make_shared<sphere>(point3(0,-1000,0), 1000, ground_material));
+    auto ground_material = materials.add(lambertian(color(0.5, 0.5, 0.5)));
+    spheres->add(point3(0,-1000,0), 1000, ground_material);
 
     for (int a = -11; a < 11; a++) {
         for (int b = -11; b < 11; b++) {
@@ -10,36 +22,40 @@ int main() {
             point3 center(a + 0.9*random_double(), 0.2, b + 0.9*random_double());
 
             if ((center - point3(4, 0.2, 0)).length() > 0.9) {
-                shared_ptr<material> sphere_material;
+                material_id sphere_material;
 
                 if (choose_mat < 0.8) {
                     // difusa
                     auto albedo = color::random() * color::random();
-                    sphere_material = make_shared<lambertian>(albedo);
-                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
+                    sphere_material = materials.add(lambertian(albedo));
+                    spheres->add(center, 0.2, sphere_material);
                 } else if (choose_mat < 0.95) {
                     // metal
                     auto albedo = color::random(0.5, 1);
                     auto fuzz = random_double(0, 0.5);
-                    sphere_material = make_shared<metal>(albedo, fuzz);
-                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
+                    sphere_material = materials.add(metal(albedo, fuzz));
+                    spheres->add(center, 0.2, sphere_material);
                 } else {
                     // glass
-                    sphere_material = make_shared<dielectric>(1.5);
-                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
+                    sphere_material = materials.add(dielectric(1.5));
+                    spheres->add(center, 0.2, sphere_material);
                 }
             }
         }
     }
 
-    auto material1 = make_shared<dielectric>(1.5);
-    world.add(make_shared<sphere>(point3(0, 1, 0), 1.0, material1));
+    auto material1 = materials.add(dielectric(1.5));
+    spheres->add(point3(0, 1, 0), 1.0, material1);
+
+    auto material2 = materials.add(lambertian(color(0.4, 0.2, 0.1)));
+    spheres->add(point3(-4, 1, 0), 1.0, material2);
 
-    auto material2 = make_shared<lambertian>(color(0.4, 0.2, 0.1));
-    world.add(make_shared<sphere>(point3(-4, 1, 0), 1.0, material2));
+    auto material3 = materials.add(metal(color(0.7, 0.6, 0.5), 0.0));
+    spheres->add(point3(4, 1, 0), 1.0, material3);
 
-    auto material3 = make_shared<metal>(color(0.7, 0.6, 0.5), 0.0);
-    world.add(make_shared<sphere>(point3(4, 1, 0), 1.0, material3));
+    // Organiza as esferas na BVH interna do batch
+    spheres->build();
+    hittable_list world(spheres);
 
     camera cam;
 
@@ -56,7 +72,7 @@ int main() {
     cam.defocus_angle = 0.6;
     cam.focus_dist    = 10.0;
 
-    cam.render(world);
+    cam.render(world, materials);
 }
 
 
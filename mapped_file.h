@@ -0,0 +1,179 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+    #define RT_NO_MMAP
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+
+// Arquivo mapeado em memória, para leitura (open) ou para escrita (create).
+// Em sistemas sem mmap o arquivo é lido inteiro para um buffer, ou montado
+// num buffer e gravado em close(), com a mesma interface.
+class mapped_file {
+  public:
+    mapped_file() {}
+    ~mapped_file() { close(); }
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    bool open(const std::string& path) {
+        close();
+#ifdef RT_NO_MMAP
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file)
+            return false;
+        fallback.resize(size_t(file.tellg()));
+        file.seekg(0);
+        if (!file.read(fallback.data(), std::streamsize(fallback.size())))
+            return false;
+        bytes = fallback.data();
+        length = fallback.size();
+        return true;
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            ::close(fd);
+            return false;
+        }
+
+        length = size_t(st.st_size);
+        if (length > 0) {
+            void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                ::close(fd);
+                length = 0;
+                return false;
+            }
+            bytes = static_cast<const char*>(p);
+        }
+        ::close(fd);  // O mapeamento continua válido depois de fechar o descritor
+        return true;
+#endif
+    }
+
+    // Cria (ou trunca) o arquivo com 'size' bytes, já reservados no disco, e o
+    // mapeia para leitura e escrita: o que for escrito em writable_data() vai
+    // para o arquivo, sem passar por buffers do processo.
+    bool create(const std::string& path, size_t size) {
+        close();
+#ifdef RT_NO_MMAP
+        if (!std::ofstream(path, std::ios::binary))
+            return false;
+        fallback.assign(size, 0);
+        fallback_path = path;
+        bytes = fallback.data();
+        length = size;
+        writable = true;
+        return true;
+#else
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+            return false;
+
+        // Reserva o espaço agora: num arquivo esparso, faltar disco no meio do
+        // render viraria um SIGBUS na escrita pelo mapeamento
+        bool reserved = ftruncate(fd, off_t(size)) == 0;
+#if defined(__linux__)
+        if (reserved && size > 0)
+            reserved = posix_fallocate(fd, 0, off_t(size)) == 0;
+#endif
+        if (!reserved) {
+            ::close(fd);
+            return false;
+        }
+
+        length = size;
+        if (length > 0) {
+            void* p = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (p == MAP_FAILED) {
+                ::close(fd);
+                length = 0;
+                return false;
+            }
+            bytes = static_cast<const char*>(p);
+        }
+        ::close(fd);
+        writable = true;
+        return true;
+#endif
+    }
+
+    // Grava no arquivo as páginas que contêm [offset, offset + size) e, com
+    // 'release', as tira da memória do processo (voltam do arquivo se forem
+    // acessadas de novo). Só nos arquivos criados com create().
+    bool sync(size_t offset, size_t size, bool release) {
+#ifdef RT_NO_MMAP
+        (void)offset;
+        (void)size;
+        (void)release;
+        return writable;
+#else
+        if (!writable || offset >= length)
+            return false;
+        size = std::min(size, length - offset);
+        size_t page = size_t(sysconf(_SC_PAGESIZE));
+        size_t start = offset / page * page;
+        char* p = const_cast<char*>(bytes) + start;
+        size_t n = offset + size - start;
+        if (msync(p, n, MS_SYNC) != 0)
+            return false;
+        if (release)
+            madvise(p, n, MADV_DONTNEED);
+        return true;
+#endif
+    }
+
+    // Desfaz o mapeamento. Retorna false se o conteúdo de um arquivo criado
+    // com create() não pôde ser gravado.
+    bool close() {
+        bool ok = true;
+#ifndef RT_NO_MMAP
+        if (bytes && length > 0) {
+            if (writable)
+                ok = msync(const_cast<char*>(bytes), length, MS_SYNC) == 0;
+            munmap(const_cast<char*>(bytes), length);
+        }
+#else
+        if (writable) {
+            std::ofstream file(fallback_path, std::ios::binary);
+            ok = bool(file.write(fallback.data(), std::streamsize(fallback.size())));
+        }
+        fallback.clear();
+#endif
+        bytes = nullptr;
+        length = 0;
+        writable = false;
+        return ok;
+    }
+
+    const char* data() const { return bytes; }
+    char* writable_data() { return writable ? const_cast<char*>(bytes) : nullptr; }
+    size_t size() const { return length; }
+
+  private:
+    const char* bytes = nullptr;
+    size_t length = 0;
+    bool writable = false;
+#ifdef RT_NO_MMAP
+    std::vector<char> fallback;
+    std::string fallback_path;
+#endif
+};
+
+#endif
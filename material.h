@@ -2,84 +2,116 @@
 #define MATERIAL_H
 
 #include "hittable.h"
+#include "sampler.h"
 
-// Classe base abstrata para materiais que definem como os raios interagem com as superfícies
+#include <vector>
+
+// Número de valores de material::kind
+constexpr int material_kind_count = 5;
+
+// Material que define como os raios interagem com as superfícies. Os tipos de
+// material são distinguidos por uma etiqueta ('type') em vez de herança com
+// métodos virtuais: todos cabem na mesma struct, ficam juntos numa tabela da
+// cena e são referenciados nos hit_records por um índice de 32 bits.
 class material {
   public:
-    virtual ~material() = default;
+    enum class kind : uint8_t {
+        absorber,    // Não espalha luz (absorve tudo)
+        lambertian,  // Difuso
+        metal,       // Reflexão especular com rugosidade
+        dielectric,  // Refração (vidro, água)
+        diffuse_light  // Emite luz igualmente em todas as direções, dos dois lados, e não espalha
+    };
+
+    kind   type = kind::absorber;
+    color  albedo = color(0,0,0);     // Cor base (lambertian e metal)
+    double fuzz = 0;                  // Rugosidade do metal (0 a 1)
+    double refraction_index = 1;      // Índice de refração do dielétrico
+    color  emission = color(0,0,0);   // Radiância emitida (diffuse_light)
+
+    bool emits() const { return type == kind::diffuse_light; }
+
+    // Cor própria da superfície, sem iluminação, para os dados auxiliares do
+    // filtro de ruído: o albedo nos difusos e metais, branco no vidro e a
+    // tonalidade da emissão nas luzes
+    color surface_color() const {
+        switch (type) {
+            case kind::lambertian:
+            case kind::metal:      return albedo;
+            case kind::dielectric: return color(1,1,1);
+            case kind::diffuse_light: {
+                double peak = std::fmax(emission.x(), std::fmax(emission.y(), emission.z()));
+                return peak > 0 ? emission / peak : color(0,0,0);
+            }
+            case kind::absorber:   break;
+        }
+        return color(0,0,0);
+    }
 
-    // Determina como um raio é espalhado ao atingir uma superfície
+    // Determina como um raio é espalhado ao atingir uma superfície. Os números
+    // aleatórios vêm do amostrador da thread (current_sampler()), na dimensão
+    // que a câmera reservou para este rebote.
     // Retorna true se o raio foi espalhado, false se foi absorvido
     // r_in: raio incidente
     // rec: registro de interseção contendo informações sobre o ponto de interseção
     // attenuation: cor atenuada do raio espalhado
     // scattered: raio espalhado resultante
-    virtual bool scatter(
-        const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered
-    ) const {
+    bool scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered) const {
+        switch (type) {
+            case kind::lambertian: return scatter_lambertian(rec, attenuation, scattered);
+            case kind::metal:      return scatter_metal(r_in, rec, attenuation, scattered);
+            case kind::dielectric: return scatter_dielectric(r_in, rec, attenuation, scattered);
+            case kind::absorber:
+            case kind::diffuse_light: break;
+        }
         return false;  // Material padrão não espalha luz (absorve tudo)
     }
-};
 
-// Material difuso que espalha a luz igualmente em todas as direções (superfície fosca)
-class lambertian : public material {
-    public:
-      // albedo: cor base do material (refletância difusa)
-      lambertian(const color& albedo) : albedo(albedo) {}
-  
-      bool scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered)
-      const override {
-          // Gera uma direção de espalhamento aleatória em um hemisfério centrado na normal
-          auto scatter_direction = rec.normal + random_unit_vector();
-  
-          // Evita direção de espalhamento degenerada (vetor zero)
-          if (scatter_direction.near_zero())
-              scatter_direction = rec.normal;
-  
-          // Cria um novo raio espalhado a partir do ponto de interseção
-          scattered = ray(rec.p, scatter_direction);
-          attenuation = albedo;  // A cor é atenuada pelo albedo do material
-          return true;  // Sempre espalha a luz
-      }
-  
-    private:
-      color albedo;  // Cor base do material
-};
+    // As funções de cada tipo também são usadas diretamente pelo integrador
+    // wavefront, que já separou os acertos por tipo e não precisa do switch
 
-// Material metálico que reflete a luz como um espelho (pode ter rugosidade)
-class metal : public material {
-  public:
-    // albedo: cor do material
-    // fuzz: fator de rugosidade (0 = espelho perfeito, 1 = superfície muito rugosa)
-    metal(const color& albedo, double fuzz) : albedo(albedo), fuzz(fuzz < 1 ? fuzz : 1) {}
+    // Material difuso que espalha a luz igualmente em todas as direções (superfície fosca)
+    bool scatter_lambertian(const hit_record& rec, color& attenuation, ray& scattered) const {
+        // Gera uma direção de espalhamento aleatória em um hemisfério centrado na normal
+        auto s = current_sampler().get_2d();
+        auto scatter_direction = rec.normal + sample_unit_sphere(s.u, s.v);
+
+        // Evita direção de espalhamento degenerada (vetor zero)
+        if (scatter_direction.near_zero())
+            scatter_direction = rec.normal;
+
+        // Cria um novo raio espalhado a partir do ponto de interseção
+        scattered = ray(rec.p, scatter_direction);
+        attenuation = albedo;  // A cor é atenuada pelo albedo do material
+        return true;  // Sempre espalha a luz
+    }
 
-    bool scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered)
-    const override {
+    // Densidade (por ângulo sólido) com que scatter_lambertian gera a direção
+    // dada: a normal mais um ponto na esfera unitária dá a distribuição do
+    // cosseno, cos θ / π. Como o albedo é a BRDF vezes π, a BRDF vezes o
+    // cosseno numa direção é albedo * pdf_lambertian.
+    double pdf_lambertian(const hit_record& rec, const vec3& direction) const {
+        double cosine = dot(rec.normal, unit_vector(direction));
+        return cosine > 0 ? cosine / pi : 0;
+    }
+
+    // Material metálico que reflete a luz como um espelho (pode ter rugosidade)
+    bool scatter_metal(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered) const {
         // Calcula a direção refletida
         vec3 reflected = reflect(r_in.direction(), rec.normal);
         // Adiciona rugosidade à direção refletida
-        reflected = unit_vector(reflected) + (fuzz * random_unit_vector());
+        auto s = current_sampler().get_2d();
+        reflected = unit_vector(reflected) + (fuzz * sample_unit_sphere(s.u, s.v));
         scattered = ray(rec.p, reflected);
         attenuation = albedo;
         // Verifica se o raio refletido está acima da superfície
         return (dot(scattered.direction(), rec.normal) > 0);
     }
 
-  private:
-    color albedo;  // Cor do material
-    double fuzz;   // Fator de rugosidade (0 a 1)
-};
-
-// Material dielétrico que refrata a luz (como vidro, água, etc.)
-class dielectric : public material {
-  public:
-    // refraction_index: índice de refração do material (ex: 1.5 para vidro)
-    dielectric(double refraction_index) : refraction_index(refraction_index) {}
-
-    bool scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered)
-    const override {
+    // Material dielétrico que refrata a luz (como vidro, água, etc.)
+    bool scatter_dielectric(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered) const {
         attenuation = color(1.0, 1.0, 1.0);  // Os dielétricos não absorvem luz
-        
+
         // Determina o índice de refração relativo (ar->material ou material->ar)
         double ri = rec.front_face ? (1.0/refraction_index) : refraction_index;
 
@@ -92,7 +124,7 @@ class dielectric : public material {
         vec3 direction;
 
         // Usa a reflexão ou refração baseado no ângulo crítico e no efeito de Fresnel
-        if (cannot_refract || reflectance(cos_theta, ri) > random_double())
+        if (cannot_refract || reflectance(cos_theta, ri) > current_sampler().get_1d())
             direction = reflect(unit_direction, rec.normal);  // Reflexão
         else
             direction = refract(unit_direction, rec.normal, ri);  // Refração
@@ -102,8 +134,6 @@ class dielectric : public material {
     }
 
   private:
-    double refraction_index;  // Índice de refração do material
-
     // Aproximação de Schlick para o coeficiente de reflexão de Fresnel
     // Usado para calcular a probabilidade de reflexão em diferentes ângulos
     static double reflectance(double cosine, double refraction_index) {
@@ -114,4 +144,67 @@ class dielectric : public material {
     }
 };
 
-#endif
\ No newline at end of file
+// Os tipos abaixo só preenchem os campos de material; não acrescentam dados,
+// então podem ser copiados para a tabela de materiais como 'material'.
+
+// Material difuso que espalha a luz igualmente em todas as direções (superfície fosca)
+class lambertian : public material {
+  public:
+    // albedo: cor base do material (refletância difusa)
+    lambertian(const color& albedo) {
+        type = kind::lambertian;
+        this->albedo = albedo;
+    }
+};
+
+// Material metálico que reflete a luz como um espelho (pode ter rugosidade)
+class metal : public material {
+  public:
+    // albedo: cor do material
+    // fuzz: fator de rugosidade (0 = espelho perfeito, 1 = superfície muito rugosa)
+    metal(const color& albedo, double fuzz) {
+        type = kind::metal;
+        this->albedo = albedo;
+        this->fuzz = fuzz < 1 ? fuzz : 1;
+    }
+};
+
+// Material dielétrico que refrata a luz (como vidro, água, etc.)
+class dielectric : public material {
+  public:
+    // refraction_index: índice de refração do material (ex: 1.5 para vidro)
+    dielectric(double refraction_index) {
+        type = kind::dielectric;
+        this->refraction_index = refraction_index;
+    }
+};
+
+// Superfície que emite luz (lâmpada). É amostrada diretamente pela câmera
+// quando está na lista de luzes da cena (light_list).
+class diffuse_light : public material {
+  public:
+    // emission: radiância emitida; valores acima de 1 são o normal para luzes pequenas
+    diffuse_light(const color& emission) {
+        type = kind::diffuse_light;
+        this->emission = emission;
+    }
+};
+
+// Tabela de materiais da cena. Os objetos guardam só o índice (material_id)
+// do seu material, então um acerto não copia ponteiros nem mexe em contadores
+// de referência.
+class material_table {
+  public:
+    std::vector<material> materials;
+
+    material_id add(const material& mat) {
+        materials.push_back(mat);
+        return material_id(materials.size() - 1);
+    }
+
+    const material& operator[](material_id id) const { return materials[id]; }
+
+    size_t size() const { return materials.size(); }
+};
+
+#endif
@@ -0,0 +1,276 @@
+#ifndef MESH_FILE_H
+#define MESH_FILE_H
+
+#include "file_blocks.h"
+#include "mapped_file.h"
+#include "scene_tokenizer.h"
+#include "triangle_mesh.h"
+
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+// Leitura de malhas: arquivos OBJ (texto) e o formato binário .rtmesh, que
+// guarda os arrays da triangle_mesh e a BVH já construída.
+//
+// load_mesh() lê um OBJ uma vez e grava ao lado dele um cache "<arquivo>.rtmesh";
+// as execuções seguintes mapeiam o cache em memória e copiam os arrays direto
+// para a malha, sem parsing nem construção da BVH. O cache é refeito quando o
+// OBJ é mais novo que ele ou quando foi gravado por um build de outra precisão.
+
+
+// Arrays de uma malha num arquivo binário (no .rtmesh e nos objetos do .rtbin)
+struct mesh_file_arrays {
+    uint64_t vertex_count, triangle_count, node_count, has_normals;
+    // Posições, a partir do início do arquivo, de cada array
+    uint64_t positions_offset, normals_offset, indices_offset, nodes_offset;
+};
+
+struct mesh_file_header {
+    char     magic[8];   // "RTMESH01"
+    uint32_t real_size;  // sizeof(real) de quem gravou
+    uint32_t reserved;
+    mesh_file_arrays arrays;
+};
+
+constexpr char mesh_file_magic[8] = { 'R', 'T', 'M', 'E', 'S', 'H', '0', '1' };
+
+// Acrescenta os blocos com os arrays da malha; as posições vão para 'out'
+inline void add_mesh_blocks(std::vector<file_block>& blocks, mesh_file_arrays& out, const triangle_mesh& mesh) {
+    auto d = mesh.data();
+    out.vertex_count = d.vertex_count;
+    out.triangle_count = d.triangle_count;
+    out.node_count = d.node_count;
+    out.has_normals = d.normals ? 1 : 0;
+    blocks.push_back({ &out.positions_offset, d.positions, 3 * d.vertex_count * sizeof(real) });
+    blocks.push_back({ &out.normals_offset,   d.normals,   d.normals ? 3 * d.vertex_count * sizeof(float) : 0 });
+    blocks.push_back({ &out.indices_offset,   d.indices,   3 * d.triangle_count * sizeof(uint32_t) });
+    blocks.push_back({ &out.nodes_offset,     d.nodes,     d.node_count * sizeof(bvh_node) });
+}
+
+// Lê os arrays de uma malha de um arquivo mapeado, conferindo que cabem no
+// arquivo e que os índices e os nós da BVH não apontam para fora dos arrays
+inline bool read_mesh_arrays(const char* bytes, size_t size, const mesh_file_arrays& src, triangle_mesh& out,
+                             std::string& error) {
+    uint64_t nv = src.vertex_count, nt = src.triangle_count;
+    if (nv > UINT32_MAX || nt > UINT32_MAX
+        || !file_array_fits(size, src.positions_offset, 3 * nv, sizeof(real))
+        || (src.has_normals && !file_array_fits(size, src.normals_offset, 3 * nv, sizeof(float)))
+        || !file_array_fits(size, src.indices_offset, 3 * nt, sizeof(uint32_t))
+        || !file_array_fits(size, src.nodes_offset, src.node_count, sizeof(bvh_node))
+        || (nt > 0 && src.node_count == 0)) {
+        error = "arrays da malha truncados ou corrompidos";
+        return false;
+    }
+
+    // Conferidos no próprio mapeamento; restore() faz a única cópia
+    std::vector<bvh_node> nodes_copy;
+    std::vector<uint32_t> indices_copy;
+    std::vector<real> positions_copy;
+    std::vector<float> normals_copy;
+    const bvh_node* nodes = file_array(bytes, src.nodes_offset, src.node_count, nodes_copy);
+    if (!valid_bvh_nodes(nodes, src.node_count, nt)) {
+        error = "nó de BVH inválido na malha";
+        return false;
+    }
+
+    const uint32_t* indices = file_array(bytes, src.indices_offset, 3 * nt, indices_copy);
+    for (uint64_t k = 0; k < 3 * nt; k++) {
+        if (indices[k] >= nv) {
+            error = "índice de vértice inválido na malha";
+            return false;
+        }
+    }
+
+    out.restore({ nv, file_array(bytes, src.positions_offset, 3 * nv, positions_copy),
+                  src.has_normals ? file_array(bytes, src.normals_offset, 3 * nv, normals_copy) : nullptr,
+                  nt, indices, nodes, src.node_count });
+    return true;
+}
+
+// Grava num arquivo temporário e o renomeia, para que uma execução
+// interrompida ou duas em paralelo nunca deixem um cache pela metade
+inline bool save_mesh_binary(const std::string& path, const triangle_mesh& mesh) {
+    std::string temp = path + ".tmp";
+    {
+        std::ofstream file(temp, std::ios::binary);
+        if (!file)
+            return false;
+
+        mesh_file_header header = {};
+        std::memcpy(header.magic, mesh_file_magic, 8);
+        header.real_size = sizeof(real);
+        std::vector<file_block> blocks;
+        add_mesh_blocks(blocks, header.arrays, mesh);
+        if (!write_file_blocks(file, &header, sizeof header, blocks) || !file.flush())
+            return false;
+    }
+
+#ifdef _WIN32
+    std::remove(path.c_str());  // No Windows rename não substitui um arquivo existente
+#endif
+    return std::rename(temp.c_str(), path.c_str()) == 0;
+}
+
+inline bool load_mesh_binary(const char* bytes, size_t size, triangle_mesh& out, std::string& error) {
+    mesh_file_header header;
+    if (size < sizeof header || std::memcmp(bytes, mesh_file_magic, 8) != 0) {
+        error = "cabeçalho de malha binária inválido";
+        return false;
+    }
+    std::memcpy(&header, bytes, sizeof header);
+    if (header.real_size != sizeof(real)) {
+        error = header.real_size == 4 ? "malha binária gravada em float; use o build com RT_USE_FLOAT"
+                                      : "malha binária gravada em double; use o build sem RT_USE_FLOAT";
+        return false;
+    }
+    return read_mesh_arrays(bytes, size, header.arrays, out, error);
+}
+
+
+// Índice de um vértice numa face OBJ: 1 é o primeiro, -1 o último lido até ali
+inline bool parse_obj_index(const char*& p, const char* end, size_t count, int64_t& out) {
+    int64_t i;
+    auto result = std::from_chars(p, end, i);
+    if (result.ec != std::errc() || i == 0)
+        return false;
+    p = result.ptr;
+    out = i > 0 ? i - 1 : int64_t(count) + i;
+    return out >= 0 && uint64_t(out) < count;
+}
+
+// Lê um OBJ: vértices (v), normais (vn) e faces (f, com v, v/vt, v//vn ou
+// v/vt/vn). Polígonos são divididos em leque de triângulos. Coordenadas de
+// textura, grupos, suavização e materiais do OBJ são ignorados; a malha toda
+// usa o material que for atribuído a ela.
+//
+// O texto é percorrido uma vez, sem cópias. Cada par (posição, normal) usado
+// pelas faces vira um vértice da malha, então vértices compartilhados entre
+// faces com a mesma normal são guardados uma vez só.
+inline bool load_obj(const char* text, size_t size, triangle_mesh& out, std::string& error) {
+    scene_tokenizer in(text, text + size);
+    std::vector<point3> positions;
+    std::vector<vec3> normals;
+    std::unordered_map<uint64_t, uint32_t> vertex_of;
+    std::vector<uint32_t> face;
+    std::string keyword, corner;
+
+    auto fail = [&](const std::string& message) {
+        error = "linha " + std::to_string(in.line) + ": " + message;
+        return false;
+    };
+
+    while (in.next_line()) {
+        in.word(keyword);
+
+        if (keyword == "v") {
+            double x, y, z, w;
+            if (!in.number(x) || !in.number(y) || !in.number(z))
+                return fail("v espera <x> <y> <z>");
+            if (!in.at_line_end() && !in.number(w))  // Coordenada homogênea opcional, ignorada
+                return fail("valor inválido em v");
+            positions.emplace_back(x, y, z);
+
+        } else if (keyword == "vn") {
+            double x, y, z;
+            if (!in.number(x) || !in.number(y) || !in.number(z))
+                return fail("vn espera <x> <y> <z>");
+            normals.emplace_back(x, y, z);
+
+        } else if (keyword == "f") {
+            face.clear();
+            while (in.word(corner)) {
+                const char* p = corner.data();
+                const char* end = p + corner.size();
+                int64_t v, n = -1, skip;
+                if (!parse_obj_index(p, end, positions.size(), v))
+                    return fail("índice de vértice inválido '" + corner + "'");
+                if (p < end && *p == '/') {
+                    p++;
+                    if (p < end && *p != '/' && !parse_obj_index(p, end, size_t(INT64_MAX), skip))
+                        return fail("índice de textura inválido '" + corner + "'");
+                    if (p < end && *p == '/') {
+                        p++;
+                        if (!parse_obj_index(p, end, normals.size(), n))
+                            return fail("índice de normal inválido '" + corner + "'");
+                    }
+                }
+                if (p != end)
+                    return fail("vértice de face inválido '" + corner + "'");
+
+                uint64_t key = uint64_t(v) | (uint64_t(n + 1) << 32);
+                auto found = vertex_of.find(key);
+                if (found == vertex_of.end()) {
+                    uint32_t index = n >= 0 ? out.add_vertex(positions[size_t(v)], normals[size_t(n)])
+                                            : out.add_vertex(positions[size_t(v)]);
+                    found = vertex_of.emplace(key, index).first;
+                }
+                face.push_back(found->second);
+            }
+            if (face.size() < 3)
+                return fail("face com menos de 3 vértices");
+            for (size_t k = 1; k + 1 < face.size(); k++)
+                out.add_triangle(face[0], face[k], face[k + 1]);
+            continue;  // word() já consumiu a linha inteira
+
+        } else if (keyword == "vt" || keyword == "o" || keyword == "g" || keyword == "s"
+                   || keyword == "usemtl" || keyword == "mtllib" || keyword == "l" || keyword == "p") {
+            continue;  // Ignorados
+
+        } else {
+            return fail("instrução OBJ desconhecida '" + keyword + "'");
+        }
+
+        if (!in.at_line_end())
+            return fail("valores sobrando no fim da linha");
+    }
+
+    if (out.triangle_count() == 0) {
+        error = "malha sem triângulos";
+        return false;
+    }
+    out.build();
+    return true;
+}
+
+// Carrega uma malha de um OBJ ou de um .rtmesh (reconhecido pelo cabeçalho).
+// Para um OBJ, usa o cache "<arquivo>.rtmesh" quando ele é válido e mais novo
+// que o OBJ; senão (inclusive quando o cache está corrompido) lê o OBJ e tenta
+// gravar o cache de novo (uma falha ao gravar não impede o render).
+inline bool load_mesh(const std::string& path, triangle_mesh& out, std::string& error) {
+    mapped_file file;
+    if (!file.open(path)) {
+        error = "não foi possível abrir " + path;
+        return false;
+    }
+    if (file.size() >= 8 && std::memcmp(file.data(), mesh_file_magic, 8) == 0)
+        return load_mesh_binary(file.data(), file.size(), out, error);
+
+    std::string cache_path = path + ".rtmesh";
+    std::error_code ec;
+    auto source_time = std::filesystem::last_write_time(path, ec);
+    auto cache_time = std::filesystem::last_write_time(cache_path, ec);
+    if (!ec && cache_time >= source_time) {
+        mapped_file cache;
+        std::string ignored;
+        triangle_mesh cached;
+        if (cache.open(cache_path) && load_mesh_binary(cache.data(), cache.size(), cached, ignored)) {
+            cached.mat = out.mat;
+            out = std::move(cached);
+            return true;
+        }
+    }
+
+    if (!load_obj(file.data(), file.size(), out, error))
+        return false;
+    save_mesh_binary(cache_path, out);
+    return true;
+}
+
+#endif
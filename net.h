@@ -0,0 +1,421 @@
+#ifndef NET_H
+#define NET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+    #define RT_NO_SOCKETS
+#else
+    #include <cerrno>
+    #include <fcntl.h>
+    #include <netdb.h>
+    #include <poll.h>
+    #include <sys/socket.h>
+    #include <sys/un.h>
+    #include <unistd.h>
+#endif
+
+
+// Sockets e mensagens do render distribuído. Os endereços são
+// "unix:/caminho/do/socket" (socket local) ou "host:porta" (TCP; ":porta"
+// escuta em todas as interfaces). Em plataformas sem sockets POSIX as
+// funções falham com uma mensagem de erro.
+//
+// Cada mensagem é um cabeçalho fixo (tipo e tamanho) seguido do conteúdo,
+// na ordem de bytes da máquina, como nas cenas .rtbin: coordenador e workers
+// precisam rodar em máquinas de mesma arquitetura.
+
+struct net_message {
+    uint32_t type = 0;
+    std::vector<char> payload;
+
+    template <typename T>
+    void put(const T& value) {
+        const char* p = reinterpret_cast<const char*>(&value);
+        payload.insert(payload.end(), p, p + sizeof(T));
+    }
+
+    void put_bytes(const void* data, size_t size) {
+        const char* p = static_cast<const char*>(data);
+        payload.insert(payload.end(), p, p + size);
+    }
+};
+
+// Leitura sequencial do conteúdo de uma mensagem; cada get falha (retorna
+// false) em vez de ler além do fim
+class net_reader {
+  public:
+    net_reader(const char* data, size_t size) : p(data), end(data + size) {}
+    explicit net_reader(const net_message& m) : net_reader(m.payload.data(), m.payload.size()) {}
+
+    template <typename T>
+    bool get(T& value) {
+        return get_bytes(&value, sizeof(T));
+    }
+
+    bool get_bytes(void* out, size_t size) {
+        if (size_t(end - p) < size)
+            return false;
+        std::memcpy(out, p, size);
+        p += size;
+        return true;
+    }
+
+    const char* position() const { return p; }
+    size_t remaining() const { return size_t(end - p); }
+
+  private:
+    const char* p;
+    const char* end;
+};
+
+struct net_message_header {
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t size;
+};
+
+// Limite do conteúdo de uma mensagem, para que um cabeçalho corrompido não
+// provoque uma alocação absurda
+constexpr uint64_t net_max_message_size = uint64_t(1) << 34;
+
+
+// Socket com fechamento automático
+class socket_handle {
+  public:
+    socket_handle() {}
+    explicit socket_handle(int fd) : fd(fd) {}
+    ~socket_handle() { close(); }
+
+    socket_handle(socket_handle&& other) noexcept : fd(other.fd) { other.fd = -1; }
+    socket_handle& operator=(socket_handle&& other) noexcept {
+        if (this != &other) {
+            close();
+            fd = other.fd;
+            other.fd = -1;
+        }
+        return *this;
+    }
+
+    socket_handle(const socket_handle&) = delete;
+    socket_handle& operator=(const socket_handle&) = delete;
+
+    int get() const { return fd; }
+    bool valid() const { return fd >= 0; }
+
+    void close() {
+#ifndef RT_NO_SOCKETS
+        if (fd >= 0)
+            ::close(fd);
+#endif
+        fd = -1;
+    }
+
+  private:
+    int fd = -1;
+};
+
+
+#ifdef RT_NO_SOCKETS
+
+inline bool listen_on(const std::string&, socket_handle&, std::string& error) {
+    error = "render distribuído não é suportado nesta plataforma";
+    return false;
+}
+
+inline bool connect_to(const std::string&, socket_handle&, std::string& error) {
+    error = "render distribuído não é suportado nesta plataforma";
+    return false;
+}
+
+#else
+
+// Separa "unix:/caminho" ou "host:porta"
+inline bool parse_address(const std::string& address, bool& is_unix, std::string& host, std::string& port) {
+    if (address.compare(0, 5, "unix:") == 0) {
+        is_unix = true;
+        host = address.substr(5);
+        return !host.empty() && host.size() < sizeof(sockaddr_un::sun_path);
+    }
+    is_unix = false;
+    auto colon = address.rfind(':');
+    if (colon == std::string::npos || colon + 1 == address.size())
+        return false;
+    host = address.substr(0, colon);
+    port = address.substr(colon + 1);
+    return true;
+}
+
+inline sockaddr_un unix_address(const std::string& path) {
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return addr;
+}
+
+inline bool listen_on(const std::string& address, socket_handle& out, std::string& error) {
+    bool is_unix;
+    std::string host, port;
+    if (!parse_address(address, is_unix, host, port)) {
+        error = "endereço inválido '" + address + "' (use unix:/caminho ou host:porta)";
+        return false;
+    }
+
+    if (is_unix) {
+        socket_handle s(::socket(AF_UNIX, SOCK_STREAM, 0));
+        sockaddr_un addr = unix_address(host);
+        ::unlink(host.c_str());  // Socket deixado por uma execução anterior
+        if (!s.valid() || ::bind(s.get(), reinterpret_cast<sockaddr*>(&addr), sizeof addr) != 0
+            || ::listen(s.get(), 64) != 0) {
+            error = "não foi possível escutar em " + address + ": " + std::strerror(errno);
+            return false;
+        }
+        out = std::move(s);
+        return true;
+    }
+
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    addrinfo* list = nullptr;
+    if (::getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &list) != 0) {
+        error = "endereço não encontrado: " + address;
+        return false;
+    }
+    for (addrinfo* a = list; a; a = a->ai_next) {
+        socket_handle s(::socket(a->ai_family, a->ai_socktype, a->ai_protocol));
+        if (!s.valid())
+            continue;
+        int yes = 1;
+        ::setsockopt(s.get(), SOL_SOCKET, SO_REUSEADDR, &yes, sizeof yes);
+        if (::bind(s.get(), a->ai_addr, a->ai_addrlen) == 0 && ::listen(s.get(), 64) == 0) {
+            out = std::move(s);
+            break;
+        }
+    }
+    ::freeaddrinfo(list);
+    if (!out.valid()) {
+        error = "não foi possível escutar em " + address + ": " + std::strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+inline bool connect_to(const std::string& address, socket_handle& out, std::string& error) {
+    bool is_unix;
+    std::string host, port;
+    if (!parse_address(address, is_unix, host, port)) {
+        error = "endereço inválido '" + address + "' (use unix:/caminho ou host:porta)";
+        return false;
+    }
+
+    if (is_unix) {
+        socket_handle s(::socket(AF_UNIX, SOCK_STREAM, 0));
+        sockaddr_un addr = unix_address(host);
+        if (!s.valid() || ::connect(s.get(), reinterpret_cast<sockaddr*>(&addr), sizeof addr) != 0) {
+            error = "não foi possível conectar em " + address + ": " + std::strerror(errno);
+            return false;
+        }
+        out = std::move(s);
+        return true;
+    }
+
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* list = nullptr;
+    if (::getaddrinfo(host.empty() ? "localhost" : host.c_str(), port.c_str(), &hints, &list) != 0) {
+        error = "endereço não encontrado: " + address;
+        return false;
+    }
+    for (addrinfo* a = list; a; a = a->ai_next) {
+        socket_handle s(::socket(a->ai_family, a->ai_socktype, a->ai_protocol));
+        if (s.valid() && ::connect(s.get(), a->ai_addr, a->ai_addrlen) == 0) {
+            out = std::move(s);
+            break;
+        }
+    }
+    ::freeaddrinfo(list);
+    if (!out.valid()) {
+        error = "não foi possível conectar em " + address + ": " + std::strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+inline void set_nonblocking(const socket_handle& s) {
+    int flags = ::fcntl(s.get(), F_GETFL, 0);
+    ::fcntl(s.get(), F_SETFL, flags | O_NONBLOCK);
+}
+
+// Envia todos os bytes. Em sockets não bloqueantes espera o socket aceitar
+// mais dados por até timeout_ms a cada trecho. MSG_NOSIGNAL evita que um
+// par desconectado encerre o processo com SIGPIPE.
+inline bool send_all(const socket_handle& s, const void* data, size_t size, int timeout_ms = 30000) {
+    const char* p = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t n = ::send(s.get(), p, size, MSG_NOSIGNAL);
+        if (n > 0) {
+            p += n;
+            size -= size_t(n);
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            pollfd pfd = { s.get(), POLLOUT, 0 };
+            if (::poll(&pfd, 1, timeout_ms) <= 0)
+                return false;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+inline bool send_message(const socket_handle& s, const net_message& m) {
+    net_message_header header = { m.type, 0, m.payload.size() };
+    return send_all(s, &header, sizeof header) && send_all(s, m.payload.data(), m.payload.size());
+}
+
+// Recebe exatamente 'size' bytes de um socket bloqueante
+inline bool recv_all(const socket_handle& s, void* out, size_t size) {
+    char* p = static_cast<char*>(out);
+    while (size > 0) {
+        ssize_t n = ::recv(s.get(), p, size, 0);
+        if (n > 0) {
+            p += n;
+            size -= size_t(n);
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Recebe uma mensagem inteira de um socket bloqueante
+inline bool recv_message(const socket_handle& s, net_message& m) {
+    net_message_header header;
+    if (!recv_all(s, &header, sizeof header) || header.size > net_max_message_size)
+        return false;
+    m.type = header.type;
+    m.payload.resize(size_t(header.size));
+    return recv_all(s, m.payload.data(), m.payload.size());
+}
+
+// Caixa de entrada de um socket não bloqueante: acumula o que chegar e
+// entrega as mensagens conforme ficam completas
+class net_inbox {
+  public:
+    // Lê o que estiver disponível. Retorna false se a conexão foi fechada ou falhou.
+    bool read_from(const socket_handle& s) {
+        char chunk[65536];
+        while (true) {
+            ssize_t n = ::recv(s.get(), chunk, sizeof chunk, 0);
+            if (n > 0) {
+                buffer.insert(buffer.end(), chunk, chunk + n);
+            } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                return true;
+            } else if (n < 0 && errno == EINTR) {
+                continue;
+            } else {
+                return false;
+            }
+        }
+    }
+
+    // Retira a próxima mensagem completa. 'corrupt' indica um cabeçalho inválido.
+    bool next(net_message& m, bool& corrupt) {
+        corrupt = false;
+        net_message_header header;
+        if (buffer.size() - start < sizeof header)
+            return false;
+        std::memcpy(&header, buffer.data() + start, sizeof header);
+        if (header.size > net_max_message_size) {
+            corrupt = true;
+            return false;
+        }
+        if (buffer.size() - start - sizeof header < header.size)
+            return false;
+
+        const char* body = buffer.data() + start + sizeof header;
+        m.type = header.type;
+        m.payload.assign(body, body + header.size);
+        start += sizeof header + size_t(header.size);
+
+        // Descarta o que já foi consumido
+        if (start == buffer.size()) {
+            buffer.clear();
+            start = 0;
+        } else if (start > buffer.size() / 2) {
+            buffer.erase(buffer.begin(), buffer.begin() + std::ptrdiff_t(start));
+            start = 0;
+        }
+        return true;
+    }
+
+  private:
+    std::vector<char> buffer;
+    size_t start = 0;
+};
+
+// Mensagem já codificada (cabeçalho e conteúdo), que pode ser posta na saída
+// de várias conexões sem ser copiada
+using net_encoded = std::shared_ptr<const std::vector<char>>;
+
+inline net_encoded encode_message(const net_message& m) {
+    net_message_header header = { m.type, 0, m.payload.size() };
+    auto out = std::make_shared<std::vector<char>>(sizeof header + m.payload.size());
+    std::memcpy(out->data(), &header, sizeof header);
+    if (!m.payload.empty())
+        std::memcpy(out->data() + sizeof header, m.payload.data(), m.payload.size());
+    return out;
+}
+
+// Caixa de saída de um socket não bloqueante: guarda as mensagens e envia o
+// que o socket aceitar, sem esperar, para que um par que parou de ler não
+// trave quem envia
+class net_outbox {
+  public:
+    void push(const net_message& m) { push(encode_message(m)); }
+    void push(net_encoded m) { queue.push_back(std::move(m)); }
+
+    bool empty() const { return queue.empty(); }
+
+    // Envia o que couber agora. Retorna false se a conexão falhou.
+    bool write_to(const socket_handle& s) {
+        while (!queue.empty()) {
+            const std::vector<char>& front = *queue.front();
+            ssize_t n = ::send(s.get(), front.data() + sent, front.size() - sent, MSG_NOSIGNAL);
+            if (n > 0) {
+                sent += size_t(n);
+                if (sent == front.size()) {
+                    queue.pop_front();
+                    sent = 0;
+                }
+            } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                return true;
+            } else if (n < 0 && errno == EINTR) {
+                continue;
+            } else {
+                return false;
+            }
+        }
+        return true;
+    }
+
+  private:
+    std::deque<net_encoded> queue;
+    size_t sent = 0;  // Bytes já enviados da primeira mensagem
+};
+
+#endif
+
+#endif
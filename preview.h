@@ -0,0 +1,319 @@
+#ifndef PREVIEW_H
+#define PREVIEW_H
+
+#include "camera.h"
+#include "image_writer.h"
+#include "net.h"
+#include "scene.h"
+#include "scene_tokenizer.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Prévia interativa: a cena e a BVH ficam carregadas e a câmera é editada por
+// comandos de texto, um por linha, lidos da entrada padrão ou de um cliente
+// conectado a um socket (net.h):
+//   camera <parâmetro> <valores>   como nas cenas (camera lookfrom 0 2 5)
+//   denoise on|off                 liga ou desliga o filtro de ruído
+//   quit                           encerra
+//
+// Cada vista é renderizada em passes de 1, 4, 16, 64... amostras por pixel,
+// até samples_per_pixel, sempre continuando as amostras do passe anterior, e
+// cada passe completo é enviado como um quadro PPM binário (P6), com a
+// geração e as amostras num comentário do cabeçalho. A sequência de quadros
+// pode ser vista com 'ffplay -f image2pipe -vcodec ppm -'.
+//
+// Um comando novo cancela o passe em andamento: as threads param antes do
+// próximo pixel (camera::render_pass), os comandos acumulados são aplicados
+// juntos e a vista nova recomeça do passe de 1 amostra. Assim a latência entre
+// uma edição e o primeiro quadro dela é a de um pixel em andamento mais o
+// passe de 1 amostra, e não a do render inteiro.
+
+// Comandos recebidos e ainda não aplicados, compartilhados entre a thread que
+// lê a entrada e a que renderiza
+struct preview_inbox {
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::string> lines;
+    std::chrono::steady_clock::time_point first_arrival;  // Chegada do comando pendente mais antigo
+    bool closed = false;    // A entrada acabou
+    bool abandoned = false; // Ninguém vai receber mais quadros: para sem terminar a vista
+    std::atomic<bool> cancel{false};  // Interrompe o passe em andamento
+
+    void push(std::string line) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (lines.empty())
+                first_arrival = std::chrono::steady_clock::now();
+            lines.push_back(std::move(line));
+            cancel = true;
+        }
+        changed.notify_all();
+    }
+
+    // Fim da entrada. Com 'abandon', o passe em andamento é cancelado.
+    void close(bool abandon) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+            abandoned = abandon;
+            if (abandon)
+                cancel = true;
+        }
+        changed.notify_all();
+    }
+};
+
+// Aplica um comando à câmera. Linhas vazias e comentários são aceitos sem
+// fazer nada. Um comando inválido não muda a câmera.
+inline bool apply_preview_command(camera& cam, const std::string& line, bool& quit, std::string& error) {
+    scene_tokenizer in(line.data(), line.data() + line.size());
+    if (!in.next_line())
+        return true;
+    std::string keyword, name;
+    in.word(keyword);
+
+    if (keyword == "quit" && in.at_line_end()) {
+        quit = true;
+        return true;
+    }
+    if (keyword == "denoise") {
+        if (!in.word(name) || !in.at_line_end() || (name != "on" && name != "off")) {
+            error = "denoise espera on ou off";
+            return false;
+        }
+        cam.denoise = (name == "on");
+        return true;
+    }
+    if (keyword != "camera") {
+        error = "comando desconhecido '" + keyword + "'";
+        return false;
+    }
+
+    if (!in.word(name)) {
+        error = "camera espera <parâmetro> <valores>";
+        return false;
+    }
+    double values[3];
+    int count = 0;
+    while (!in.at_line_end()) {
+        if (count == 3 || !in.number(values[count])) {
+            error = "valor inválido para camera " + name;
+            return false;
+        }
+        count++;
+    }
+    return apply_camera_param(cam, name, values, count, error);
+}
+
+// A thread de leitura para de ler depois do quit
+inline bool is_preview_quit(const std::string& line) {
+    scene_tokenizer in(line.data(), line.data() + line.size());
+    std::string keyword;
+    return in.next_line() && in.word(keyword) && keyword == "quit" && in.at_line_end();
+}
+
+// Quadro da prévia: o PPM binário da imagem com um comentário logo depois do
+// "P6", que os leitores de PPM ignoram
+inline byte_buffer encode_preview_frame(const framebuffer& image, uint64_t generation, int samples) {
+    byte_buffer ppm = encode_ppm(image);
+    std::string comment = "# geracao " + std::to_string(generation) + " amostras " + std::to_string(samples) + '\n';
+    ppm.insert(ppm.begin() + 3, comment.begin(), comment.end());
+    return ppm;
+}
+
+// Renderiza e envia quadros até o comando quit, o fim da entrada (depois de
+// terminar a vista atual, se a entrada não foi abandonada) ou uma falha de
+// send_frame. Retorna false só na falha de envio; 'quit' indica se o comando
+// quit foi recebido.
+inline bool run_preview_session(thread_pool& pool, scene& world, preview_inbox& inbox,
+                                const std::function<bool(const byte_buffer&)>& send_frame, bool& quit) {
+    using clock = std::chrono::steady_clock;
+    auto ms_since = [](clock::time_point t) {
+        return std::chrono::duration<double, std::milli>(clock::now() - t).count();
+    };
+
+    camera& cam = world.cam;
+    accumulation_buffer accum;
+    framebuffer image;
+    uint64_t generation = 0;
+    int shown = 0;  // Amostras por pixel do último quadro enviado da vista atual
+    clock::time_point requested;
+    quit = false;
+
+    while (true) {
+        // Aplica tudo o que chegou desde a última vista. Se nenhum comando
+        // valeu (só erros), a vista atual continua de onde parou.
+        bool changed = generation == 0;
+        {
+            std::lock_guard<std::mutex> lock(inbox.mutex);
+            clock::time_point arrival = inbox.lines.empty() ? clock::now() : inbox.first_arrival;
+            for (; !inbox.lines.empty() && !quit; inbox.lines.pop_front()) {
+                std::string error;
+                if (apply_preview_command(cam, inbox.lines.front(), quit, error))
+                    changed = true;
+                else
+                    std::cerr << "Prévia: " << error << '\n';
+            }
+            if (quit || inbox.abandoned)
+                return true;
+            inbox.cancel = false;
+            if (changed)
+                requested = arrival;
+        }
+
+        if (changed) {
+            generation++;
+            shown = 0;
+            accum.resize(cam.image_width, cam.height());
+        }
+        int max_samples = std::max(cam.samples_per_pixel, 1);
+        bool complete = shown >= max_samples;
+        for (int target = 1; !complete; target *= 4) {
+            int samples = std::min(target, max_samples);
+            if (samples <= shown)
+                continue;
+            if (!cam.render_pass(pool, world.root(), world.materials, accum, samples, inbox.cancel, image))
+                break;
+            if (!send_frame(encode_preview_frame(image, generation, samples)))
+                return false;
+            if (shown == 0)
+                std::clog << "Prévia " << generation << ": " << image.width << 'x' << image.height
+                          << ", primeiro quadro em " << ms_since(requested) << " ms\n";
+            shown = samples;
+            if (samples == max_samples) {
+                std::clog << "Prévia " << generation << ": " << samples << " amostras em "
+                          << ms_since(requested) << " ms\n";
+                complete = true;
+            }
+        }
+        if (!complete)
+            continue;
+
+        // Vista pronta: espera o próximo comando ou o fim da entrada
+        std::unique_lock<std::mutex> lock(inbox.mutex);
+        inbox.changed.wait(lock, [&] { return !inbox.lines.empty() || inbox.closed; });
+        if (inbox.lines.empty())
+            return true;
+    }
+}
+
+// Prévia com os comandos na entrada padrão e os quadros na saída padrão. O fim
+// da entrada termina a vista atual e encerra.
+inline bool preview_stdio(scene& world, std::string& error) {
+    auto inbox = std::make_shared<preview_inbox>();
+    std::thread reader([inbox] {
+        std::string line;
+        while (std::getline(std::cin, line)) {
+            bool quit = is_preview_quit(line);
+            inbox->push(std::move(line));
+            if (quit)
+                break;
+        }
+        inbox->close(false);
+    });
+
+    set_stdout_binary();
+    thread_pool pool(world.cam.num_threads);
+    bool quit;
+    bool ok = run_preview_session(pool, world, *inbox, [](const byte_buffer& frame) {
+        std::cout.write(reinterpret_cast<const char*>(frame.data()), std::streamsize(frame.size()));
+        std::cout.flush();
+        return bool(std::cout);
+    }, quit);
+
+    // Depois de uma falha de escrita a thread pode continuar presa lendo a
+    // entrada; ela só usa o inbox, que é compartilhado
+    if (ok)
+        reader.join();
+    else
+        reader.detach();
+    if (!ok)
+        error = "falha ao escrever os quadros na saída padrão";
+    return ok;
+}
+
+
+#ifndef RT_NO_SOCKETS
+
+// Prévia servida em 'address': atende um cliente por vez, que envia os
+// comandos e recebe os quadros na mesma conexão. A câmera editada por um
+// cliente continua valendo para o próximo. Só retorna com o comando quit ou
+// se não puder escutar no endereço.
+inline bool preview_server(const std::string& address, scene& world, std::string& error) {
+    socket_handle listener;
+    if (!listen_on(address, listener, error))
+        return false;
+    thread_pool pool(world.cam.num_threads);
+    std::clog << "Prévia em " << address << '\n';
+
+    bool quit = false;
+    while (!quit) {
+        int fd = ::accept(listener.get(), nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            error = std::string("accept: ") + std::strerror(errno);
+            return false;
+        }
+        auto client = std::make_shared<socket_handle>(fd);
+        auto inbox = std::make_shared<preview_inbox>();
+        std::clog << "Prévia: cliente conectado\n";
+
+        std::thread reader([client, inbox] {
+            std::string pending;
+            char chunk[4096];
+            while (true) {
+                ssize_t n = ::recv(client->get(), chunk, sizeof chunk, 0);
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n <= 0)
+                    break;
+                pending.append(chunk, size_t(n));
+                size_t start = 0, end;
+                bool quit = false;
+                while (!quit && (end = pending.find('\n', start)) != std::string::npos) {
+                    std::string line = pending.substr(start, end - start);
+                    quit = is_preview_quit(line);
+                    inbox->push(std::move(line));
+                    start = end + 1;
+                }
+                pending.erase(0, start);
+                if (quit)
+                    break;
+            }
+            inbox->close(true);
+        });
+
+        run_preview_session(pool, world, *inbox, [&](const byte_buffer& frame) {
+            return send_all(*client, frame.data(), frame.size());
+        }, quit);
+
+        // Desbloqueia o recv da thread de leitura, se ela ainda estiver nele
+        ::shutdown(client->get(), SHUT_RDWR);
+        reader.join();
+        std::clog << "Prévia: cliente desconectado\n";
+    }
+    return true;
+}
+
+#else
+
+inline bool preview_server(const std::string&, scene&, std::string& error) {
+    error = "prévia por socket não é suportada nesta plataforma";
+    return false;
+}
+
+#endif
+
+#endif
@@ -0,0 +1,279 @@
+#include "rtweekend.h"
+#include "camera.h"
+#include "distributed.h"
+#include "preview.h"
+#include "scene.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <string>
+
+// Renderizador que lê a cena de um arquivo, em vez de tê-la compilada no código.
+// Uso:
+//   render <cena> [opções] > imagem.ppm
+//   render --worker <endereço> [-t threads]
+//
+// Cenas com quadros-chave (keyframe) são renderizadas como animação, um arquivo
+// por quadro: -o é obrigatório e os '#' do nome viram o número do quadro
+// (-o quadros/frame_####.png).
+//
+// Opções:
+//   -o <arquivo>       Escreve a imagem no arquivo (.ppm, .png ou .pfm) em vez da saída padrão
+//   -t <threads>       Número de threads (padrão: RT_THREADS ou todos os núcleos)
+//   -s <semente>       Semente do gerador aleatório
+//   --spp <n>          Amostras por pixel
+//   --width <n>        Largura da imagem
+//   --sampler <tipo>   sobol (padrão, menos ruído) ou random
+//   --integrator <tipo> path (padrão) ou wavefront
+//   --sort-rays <on|off>  No wavefront, ordena os raios de cada rebote por octante da direção e
+//                      posição da origem, para percorrer a BVH com mais coerência (padrão: off)
+//   --light-sampling <on|off>  Amostragem direta das luzes da cena (padrão: on, ou o que a cena definir)
+//   --denoise <on|off> Filtro de ruído guiado por albedo, normal e profundidade (padrão: off)
+//   --aov <arquivo>    Grava também o albedo, a normal e a profundidade do primeiro acerto, em
+//                      <arquivo>.albedo.pfm, <arquivo>.normal.pfm e <arquivo>.depth.pfm (liga o --denoise)
+//   --frames <a>:<b>   Nas animações, renderiza só os quadros de a até b (inclusive)
+//   --serve <endereço> Coordena um render distribuído: escuta em unix:/caminho ou host:porta e
+//                      divide a imagem entre os workers que se conectarem (render --worker)
+//   --preview <endereço|->  Prévia interativa: mantém a cena carregada, lê comandos (camera <parâmetro>
+//                      <valores>, denoise on|off, quit) da entrada padrão (-) ou de um cliente em
+//                      unix:/caminho ou host:porta e devolve quadros PPM cada vez mais refinados
+//                      (largura padrão 320); veja preview.h
+//   --block <n>        Lado dos blocos do render distribuído (padrão: 64)
+//   --timeout <s>      Desconecta o worker que passar de s segundos num bloco (padrão: sem limite)
+//   --stream <on|off>  Grava a imagem direto num arquivo mapeado em memória, faixa por faixa,
+//                      para imagens maiores que a memória; exige -o com .ppm ou .pfm (padrão: off)
+//   --checkpoint <arquivo>  Grava o progresso no arquivo e, se ele já existir, continua dele
+//                      (com --spp maior, acrescenta amostras a um render pronto)
+//   --checkpoint-interval <s>  Segundos entre checkpoints dentro de um passe (padrão: 300)
+//   --trace <arquivo>  Grava a linha do tempo dos tiles (JSON do Chrome); exige compilar com -DRT_STATS
+//   --save <arquivo>   Salva a cena (.rtbin para binário, texto nos outros casos) e sai
+
+static void usage() {
+    std::cerr << "Uso: render <cena> [-o saida] [-t threads] [-s semente] [--spp n] [--width n] [--sampler sobol|random]"
+                 " [--integrator path|wavefront] [--sort-rays on|off] [--light-sampling on|off] [--denoise on|off] [--aov arquivo] [--frames a:b] [--serve endereço [--block n] [--timeout s]] [--preview endereço|-]"
+                 " [--stream on|off] [--checkpoint arquivo [--checkpoint-interval s]] [--trace trace.json] [--save cena.rtbin]\n"
+                 "     render --worker <endereço> [-t threads]\n";
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        usage();
+        return 1;
+    }
+
+    std::string error;
+    if (std::string(argv[1]) == "--worker") {
+        if (argc != 3 && !(argc == 5 && std::string(argv[3]) == "-t")) {
+            usage();
+            return 1;
+        }
+        if (!render_worker(argv[2], argc == 5 ? std::atoi(argv[4]) : 0, error)) {
+            std::cerr << "Worker: " << error << '\n';
+            return 1;
+        }
+        return 0;
+    }
+
+    std::string scene_path = argv[1];
+    std::string save_path;
+    std::string aov_path;
+    scene world;
+
+    auto start = std::chrono::steady_clock::now();
+    if (!load_scene(scene_path, world, error)) {
+        std::cerr << scene_path << ": " << error << '\n';
+        return 1;
+    }
+    auto loaded = std::chrono::steady_clock::now();
+    std::clog << "Cena carregada: " << world.spheres.size() << " esferas, "
+              << world.instances.size() << " instâncias de " << world.objects.size() << " objetos, "
+              << world.materials.size() << " materiais, " << world.lights.size() << " luzes em "
+              << std::chrono::duration<double, std::milli>(loaded - start).count() << " ms\n";
+
+    camera& cam = world.cam;
+    int first_frame = 0;
+    int last_frame = world.path.frame_count() - 1;
+    std::string serve_address;
+    std::string preview_address;
+    bool width_given = false;
+    bool stream = false;
+    distributed_options distributed;
+    for (int k = 2; k < argc; k++) {
+        std::string arg = argv[k];
+        if (k + 1 >= argc) {
+            usage();
+            return 1;
+        }
+        std::string value = argv[++k];
+
+        if (arg == "-o") {
+            cam.output_file = value;
+            cam.output_format = image_format_from_path(value);
+        } else if (arg == "-t") {
+            cam.num_threads = std::atoi(value.c_str());
+        } else if (arg == "-s") {
+            cam.seed = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (arg == "--spp") {
+            cam.samples_per_pixel = std::atoi(value.c_str());
+        } else if (arg == "--width") {
+            cam.image_width = std::atoi(value.c_str());
+            width_given = true;
+        } else if (arg == "--sampler" && (value == "sobol" || value == "random")) {
+            cam.sampler = (value == "sobol") ? sample_pattern::sobol : sample_pattern::random;
+        } else if (arg == "--integrator" && (value == "path" || value == "wavefront")) {
+            cam.integrator = (value == "path") ? integrator_type::path : integrator_type::wavefront;
+        } else if (arg == "--sort-rays" && (value == "on" || value == "off")) {
+            cam.sort_rays = (value == "on");
+        } else if (arg == "--light-sampling" && (value == "on" || value == "off")) {
+            cam.light_sampling = (value == "on");
+        } else if (arg == "--denoise" && (value == "on" || value == "off")) {
+            cam.denoise = (value == "on");
+        } else if (arg == "--aov") {
+            aov_path = value;
+        } else if (arg == "--frames") {
+            auto colon = value.find(':');
+            if (colon == std::string::npos) {
+                usage();
+                return 1;
+            }
+            first_frame = std::atoi(value.substr(0, colon).c_str());
+            last_frame = std::atoi(value.substr(colon + 1).c_str());
+        } else if (arg == "--serve") {
+            serve_address = value;
+        } else if (arg == "--preview") {
+            preview_address = value;
+        } else if (arg == "--stream" && (value == "on" || value == "off")) {
+            stream = (value == "on");
+        } else if (arg == "--block") {
+            distributed.block_size = std::atoi(value.c_str());
+        } else if (arg == "--timeout") {
+            distributed.timeout = std::atof(value.c_str());
+        } else if (arg == "--checkpoint") {
+            cam.checkpoint_file = value;
+        } else if (arg == "--checkpoint-interval") {
+            cam.checkpoint_interval = std::atof(value.c_str());
+        } else if (arg == "--trace") {
+            if (!render_stats_enabled) {
+                std::cerr << "--trace exige compilar com -DRT_STATS\n";
+                return 1;
+            }
+            cam.trace_file = value;
+        } else if (arg == "--save") {
+            save_path = value;
+        } else {
+            usage();
+            return 1;
+        }
+    }
+
+    if (!check_camera_size(cam, error)) {
+        std::cerr << error << '\n';
+        return 1;
+    }
+
+    if (!save_path.empty()) {
+        if (!save_scene(save_path, world)) {
+            std::cerr << "Erro ao salvar " << save_path << '\n';
+            return 1;
+        }
+        return 0;
+    }
+
+    if (!cam.checkpoint_file.empty()) {
+        if (!serve_address.empty() || !world.path.empty()) {
+            std::cerr << "--checkpoint não funciona com render distribuído nem com animações\n";
+            return 1;
+        }
+        cam.scene_hash = hash_scene(world);
+    }
+
+    if (!aov_path.empty()) {
+        if (!world.path.empty()) {
+            std::cerr << "--aov não funciona com animações\n";
+            return 1;
+        }
+        cam.denoise = true;
+    }
+    if (cam.denoise && !serve_address.empty()) {
+        std::cerr << "--denoise não funciona com render distribuído\n";
+        return 1;
+    }
+    if (!serve_address.empty() && !world.path.empty()) {
+        std::cerr << "--serve não funciona com animações\n";
+        return 1;
+    }
+
+    if (stream) {
+        if (!serve_address.empty() || !preview_address.empty() || !world.path.empty()
+            || !cam.checkpoint_file.empty() || cam.denoise) {
+            std::cerr << "--stream não funciona com --serve, --preview, animações, --checkpoint nem --denoise/--aov\n";
+            return 1;
+        }
+        if (cam.output_file.empty()) {
+            std::cerr << "--stream precisa de -o com um arquivo .ppm ou .pfm\n";
+            return 1;
+        }
+    }
+
+    if (!preview_address.empty()) {
+        if (!serve_address.empty() || !cam.checkpoint_file.empty() || !aov_path.empty()) {
+            std::cerr << "--preview não funciona com --serve, --checkpoint nem --aov\n";
+            return 1;
+        }
+        if (!width_given)
+            cam.image_width = 320;
+        bool ok = preview_address == "-" ? preview_stdio(world, error)
+                                         : preview_server(preview_address, world, error);
+        if (!ok) {
+            std::cerr << error << '\n';
+            return 1;
+        }
+        return 0;
+    }
+
+    if (stream) {
+        if (!cam.render_streamed(world.root(), world.materials, cam.output_file, cam.output_format))
+            return 1;
+    } else if (!serve_address.empty()) {
+        framebuffer image;
+        if (!render_coordinator(serve_address, world, distributed, image, error)) {
+            std::cerr << error << '\n';
+            return 1;
+        }
+        if (cam.output_file.empty()) {
+            set_stdout_binary();
+            write_image(std::cout, image, cam.output_format);
+        } else if (!write_image(cam.output_file, image, cam.output_format)) {
+            std::cerr << "Erro ao escrever " << cam.output_file << '\n';
+            return 1;
+        }
+    } else if (!world.path.empty()) {
+        if (cam.output_file.empty()) {
+            std::cerr << "Animações precisam de -o com o nome dos quadros (por exemplo, -o frame_####.png)\n";
+            return 1;
+        }
+        if (first_frame < 0 || last_frame < first_frame) {
+            std::cerr << "Intervalo de quadros inválido\n";
+            return 1;
+        }
+        if (!cam.render_sequence(world.root(), world.materials, world.path, cam.output_file,
+                                 first_frame, last_frame + 1))
+            return 1;
+    } else {
+        if (!cam.render(world.root(), world.materials))
+            return 1;
+        if (!aov_path.empty()) {
+            framebuffer albedo, normal, depth;
+            cam.aovs().resolve(albedo, normal, depth);
+            for (auto [name, image] : { std::pair{ ".albedo.pfm", &albedo }, std::pair{ ".normal.pfm", &normal },
+                                        std::pair{ ".depth.pfm", &depth } }) {
+                if (!write_image(aov_path + name, *image, image_format::pfm)) {
+                    std::cerr << "Erro ao escrever " << aov_path + name << '\n';
+                    return 1;
+                }
+            }
+        }
+    }
+    if (render_stats_enabled)
+        print_render_stats(std::clog, cam.stats());
+}
@@ -0,0 +1,208 @@
+#ifndef RENDER_STATS_H
+#define RENDER_STATS_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Instrumentação do render: contadores de cada etapa (raios, testes de
+// interseção, nós visitados, espalhamentos por material, fim dos caminhos) e
+// o tempo de cada tile, que também pode ser gravado como uma linha do tempo no
+// formato de trace do Chrome (chrome://tracing ou ui.perfetto.dev).
+//
+// Só existe quando compilado com -DRT_STATS. Sem ela, RT_STAT(...) não gera
+// código nenhum e o render não mede nada. Cada thread conta no seu próprio
+// render_stats (sem atômicos nem locks); a câmera soma os de todas as threads
+// só no fim do render.
+#ifdef RT_STATS
+constexpr bool render_stats_enabled = true;
+#else
+constexpr bool render_stats_enabled = false;
+#endif
+
+// Motivo pelo qual um caminho terminou
+enum class path_end : uint8_t {
+    escaped,    // Saiu da cena (luz do céu)
+    absorbed,   // O material não espalhou o raio
+    black,      // Throughput praticamente zero
+    roulette,   // Cortado pela roleta russa
+    max_depth,  // Atingiu max_depth rebotes
+    light       // Atingiu uma superfície emissora
+};
+
+constexpr int path_end_count = 6;
+
+// Tempo de um tile (ou de um passe inteiro, com tile = -1), em microssegundos
+// desde o início do render (numa animação, desde o início do primeiro quadro)
+struct tile_timing {
+    int      pass;
+    int      tile;
+    int      worker;
+    double   start_us;
+    double   duration_us;
+    uint64_t samples;
+    int      frame = -1;  // Quadro da animação, ou -1 fora de uma
+};
+
+struct render_stats {
+    // Comprimento máximo separado no histograma; caminhos maiores vão no último
+    static constexpr int path_length_bins = 64;
+
+    uint64_t rays = 0;                    // Raios testados contra a cena
+    uint64_t intersection_tests = 0;      // Testes raio-primitivo
+    uint64_t bvh_nodes_visited = 0;       // Nós de BVH cuja caixa foi testada
+    uint64_t list_nodes_visited = 0;      // Objetos percorridos em hittable_list
+    uint64_t shadow_rays = 0;             // Raios de sombra até as luzes (também contados em rays)
+    uint64_t occluded_shadow_rays = 0;    // Raios de sombra bloqueados antes da luz
+    uint64_t secondary_rays = 0;          // Raios de rebote do wavefront (depois dos de câmera)
+    uint64_t sorted_rays = 0;             // Raios de rebote reordenados por coerência (sort_rays)
+    uint64_t octant_switches = 0;         // Raios de rebote seguidos com octantes de direção diferentes
+    double   ray_sort_us = 0;             // Tempo gasto ordenando os raios
+    uint64_t scatter_calls[5] = {};       // Por material::kind
+    uint64_t path_ends[path_end_count] = {};
+    uint64_t path_lengths[path_length_bins] = {};  // Raios por caminho
+    std::vector<tile_timing> tiles;
+
+    void end_path(path_end reason, int length) {
+        path_ends[int(reason)]++;
+        path_lengths[std::min(std::max(length, 0), path_length_bins - 1)]++;
+    }
+
+    void merge(const render_stats& other) {
+        rays += other.rays;
+        intersection_tests += other.intersection_tests;
+        bvh_nodes_visited += other.bvh_nodes_visited;
+        list_nodes_visited += other.list_nodes_visited;
+        shadow_rays += other.shadow_rays;
+        occluded_shadow_rays += other.occluded_shadow_rays;
+        secondary_rays += other.secondary_rays;
+        sorted_rays += other.sorted_rays;
+        octant_switches += other.octant_switches;
+        ray_sort_us += other.ray_sort_us;
+        for (int k = 0; k < 5; k++)
+            scatter_calls[k] += other.scatter_calls[k];
+        for (int k = 0; k < path_end_count; k++)
+            path_ends[k] += other.path_ends[k];
+        for (int k = 0; k < path_length_bins; k++)
+            path_lengths[k] += other.path_lengths[k];
+        tiles.insert(tiles.end(), other.tiles.begin(), other.tiles.end());
+    }
+};
+
+// Contadores da thread atual. A câmera aponta cada thread do pool para o
+// registro do seu worker (render_stats_scope); fora do render é nulo e nada é
+// contado. É um ponteiro simples para que o acesso não passe pela
+// inicialização preguiçosa das variáveis thread_local com construtor.
+inline render_stats*& active_render_stats() {
+    thread_local render_stats* active = nullptr;
+    return active;
+}
+
+class render_stats_scope {
+  public:
+    explicit render_stats_scope(render_stats& stats) : previous(active_render_stats()) {
+        active_render_stats() = &stats;
+    }
+    ~render_stats_scope() { active_render_stats() = previous; }
+
+    render_stats_scope(const render_stats_scope&) = delete;
+    render_stats_scope& operator=(const render_stats_scope&) = delete;
+
+  private:
+    render_stats* previous;
+};
+
+#ifdef RT_STATS
+#define RT_STAT(statement) \
+    do { if (render_stats* rt_stats_ = active_render_stats()) rt_stats_->statement; } while (0)
+#else
+#define RT_STAT(statement) do {} while (0)
+#endif
+
+
+inline const char* path_end_name(int reason) {
+    static const char* names[path_end_count] = { "escaped", "absorbed", "black", "roulette", "max_depth", "light" };
+    return names[reason];
+}
+
+// Resumo legível dos contadores
+inline void print_render_stats(std::ostream& out, const render_stats& s) {
+    auto per_ray = [&](uint64_t v) { return s.rays ? double(v) / double(s.rays) : 0.0; };
+
+    out << "Raios: " << s.rays << '\n'
+        << "Testes de interseção: " << s.intersection_tests << " (" << per_ray(s.intersection_tests) << " por raio)\n"
+        << "Nós de BVH visitados: " << s.bvh_nodes_visited << " (" << per_ray(s.bvh_nodes_visited) << " por raio)\n"
+        << "Objetos de lista visitados: " << s.list_nodes_visited << '\n'
+        << "Espalhamentos: absorber " << s.scatter_calls[0] << ", lambertian " << s.scatter_calls[1]
+        << ", metal " << s.scatter_calls[2] << ", dielectric " << s.scatter_calls[3]
+        << ", diffuse_light " << s.scatter_calls[4] << '\n';
+    if (s.shadow_rays)
+        out << "Raios de sombra: " << s.shadow_rays << " (" << s.occluded_shadow_rays << " bloqueados)\n";
+    if (s.secondary_rays)
+        out << "Raios de rebote no wavefront: " << s.secondary_rays << ", trocas de octante entre raios seguidos: "
+            << 100.0 * double(s.octant_switches) / double(s.secondary_rays) << "%\n";
+    if (s.sorted_rays)
+        out << "Raios ordenados: " << s.sorted_rays << " em " << s.ray_sort_us / 1000 << " ms ("
+            << 1000 * s.ray_sort_us / double(s.sorted_rays) << " ns por raio)\n";
+
+    out << "Fim dos caminhos:";
+    for (int k = 0; k < path_end_count; k++)
+        out << ' ' << path_end_name(k) << ' ' << s.path_ends[k];
+    out << '\n';
+
+    out << "Raios por caminho:";
+    for (int k = 0; k < render_stats::path_length_bins; k++)
+        if (s.path_lengths[k])
+            out << ' ' << k << (k == render_stats::path_length_bins - 1 ? "+" : "") << ':' << s.path_lengths[k];
+    out << '\n';
+
+    double min_us = 0, max_us = 0, sum_us = 0;
+    size_t count = 0;
+    for (const auto& t : s.tiles) {
+        if (t.tile < 0)
+            continue;
+        min_us = count ? std::min(min_us, t.duration_us) : t.duration_us;
+        max_us = std::max(max_us, t.duration_us);
+        sum_us += t.duration_us;
+        count++;
+    }
+    if (count)
+        out << "Tempo por tile (ms): mínimo " << min_us / 1000 << ", médio " << sum_us / count / 1000
+            << ", máximo " << max_us / 1000 << " (" << count << " tiles)\n";
+}
+
+// Grava os tempos dos tiles e dos passes como eventos completos ("ph": "X")
+// do formato de trace do Chrome, uma faixa por thread do pool. Numa animação,
+// o quadro vai no nome dos passes e nos argumentos de cada evento.
+inline bool write_chrome_trace(const std::string& path, const render_stats& s) {
+    std::ofstream out(path);
+    if (!out)
+        return false;
+
+    out << "{\"traceEvents\": [\n";
+    bool first = true;
+    for (const auto& t : s.tiles) {
+        out << (first ? "" : ",\n");
+        first = false;
+        if (t.tile < 0 && t.frame >= 0)
+            out << "{\"name\": \"quadro " << t.frame << ", passe " << t.pass + 1 << "\", \"cat\": \"pass\"";
+        else if (t.tile < 0)
+            out << "{\"name\": \"passe " << t.pass + 1 << "\", \"cat\": \"pass\"";
+        else
+            out << "{\"name\": \"tile " << t.tile << "\", \"cat\": \"tile\"";
+        out << ", \"ph\": \"X\", \"pid\": 0, \"tid\": " << t.worker
+            << ", \"ts\": " << t.start_us << ", \"dur\": " << t.duration_us
+            << ", \"args\": {";
+        if (t.frame >= 0)
+            out << "\"frame\": " << t.frame << ", ";
+        out << "\"pass\": " << t.pass << ", \"samples\": " << t.samples << "}}";
+    }
+    out << "\n],\n\"displayTimeUnit\": \"ms\"}\n";
+    return bool(out);
+}
+
+#endif
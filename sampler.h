@@ -0,0 +1,133 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include "rtweekend.h"
+
+#include <array>
+#include <cstdint>
+
+// Fonte dos números usados para amostrar cada caminho (posição no pixel, ponto
+// na lente, direções de espalhamento, roleta russa). Cada número pertence a
+// uma "dimensão" do caminho, que a câmera escolhe antes de cada uso.
+//
+// Com sample_pattern::sobol, as amostras de um pixel seguem uma sequência de
+// Sobol de baixa discrepância: as N primeiras amostras cobrem cada par de
+// dimensões de forma bem mais uniforme que números independentes, o que reduz
+// o ruído para o mesmo número de amostras. Cada par de dimensões usa a
+// sequência 2D (0,2) de Sobol com embaralhamento de Owen por hash e índice
+// embaralhado (Burley, "Practical Hash-based Owen Scrambling", 2020), então
+// não há limite de dimensões e pixels vizinhos não se correlacionam.
+//
+// Com sample_pattern::random, tudo vem de random_double().
+enum class sample_pattern : uint8_t {
+    random,
+    sobol
+};
+
+struct sample2 {
+    double u, v;
+};
+
+class path_sampler {
+  public:
+    // Começa a amostra 'index' do pixel 'pixel', na dimensão 0
+    void start(sample_pattern p, uint64_t seed, uint64_t pixel, uint32_t sample_index) {
+        pattern = p;
+        pixel_key = hash_u64(seed ^ hash_u64(pixel));
+        index = sample_index;
+        dimension = 0;
+    }
+
+    // Posiciona a próxima leitura numa dimensão fixa. A câmera reserva as mesmas
+    // dimensões para cada rebote em todas as amostras, para que os valores de
+    // uma mesma decisão venham sempre da mesma sequência.
+    void set_dimension(uint32_t d) { dimension = d; }
+
+    double get_1d() {
+        if (pattern == sample_pattern::random)
+            return random_double();
+        uint64_t h = hash_u64(pixel_key + dimension++);
+        uint32_t i = nested_uniform_scramble(index, uint32_t(h));
+        // Primeira dimensão de Sobol (reverse_bits(i)) já embaralhada: as duas
+        // inversões de nested_uniform_scramble se cancelam com a da sequência
+        return to_unit(reverse_bits(laine_karras_permutation(i, uint32_t(h >> 32))));
+    }
+
+    sample2 get_2d() {
+        if (pattern == sample_pattern::random) {
+            double u = random_double();
+            return { u, random_double() };
+        }
+        uint64_t h = hash_u64(pixel_key + dimension);
+        uint64_t h2 = hash_u64(h);
+        dimension += 2;
+        uint32_t i = nested_uniform_scramble(index, uint32_t(h));
+        return { to_unit(reverse_bits(laine_karras_permutation(i, uint32_t(h >> 32)))),
+                 to_unit(reverse_bits(laine_karras_permutation(reversed_sobol_dimension1(i), uint32_t(h2)))) };
+    }
+
+  private:
+    sample_pattern pattern = sample_pattern::random;
+    uint64_t pixel_key = 0;
+    uint32_t index = 0;
+    uint32_t dimension = 0;
+
+    static double to_unit(uint32_t x) { return x * (1.0 / 4294967296.0); }
+
+    static uint32_t reverse_bits(uint32_t x) {
+        x = (x << 16) | (x >> 16);
+        x = ((x & 0x00ff00ffu) << 8) | ((x & 0xff00ff00u) >> 8);
+        x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+        x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+        x = ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+        return x;
+    }
+
+    // Segunda dimensão de Sobol com os bits invertidos. A dimensão é linear nos
+    // bits do índice (sobre GF(2)), então é a soma (xor) das contribuições de
+    // cada byte, tabeladas uma vez. O índice embaralhado usa os 32 bits, e o
+    // laço bit a bit custaria 32 iterações com desvios imprevisíveis.
+    static uint32_t reversed_sobol_dimension1(uint32_t i) {
+        static const auto tables = [] {
+            std::array<std::array<uint32_t, 256>, 4> t{};
+            uint32_t v[32];
+            v[0] = 1u << 31;
+            for (int bit = 1; bit < 32; bit++)
+                v[bit] = v[bit-1] ^ (v[bit-1] >> 1);
+            for (int byte = 0; byte < 4; byte++)
+                for (uint32_t value = 0; value < 256; value++) {
+                    uint32_t result = 0;
+                    for (int bit = 0; bit < 8; bit++)
+                        if (value & (1u << bit))
+                            result ^= v[8*byte + bit];
+                    t[byte][value] = reverse_bits(result);
+                }
+            return t;
+        }();
+        return tables[0][i & 0xff] ^ tables[1][(i >> 8) & 0xff]
+             ^ tables[2][(i >> 16) & 0xff] ^ tables[3][i >> 24];
+    }
+
+    // Permutação de Laine-Karras: cada bit só é afetado pelos bits menos
+    // significativos, como no embaralhamento de Owen com os bits invertidos
+    static uint32_t laine_karras_permutation(uint32_t x, uint32_t seed) {
+        x += seed;
+        x ^= x * 0x6c50b47cu;
+        x ^= x * 0xb82f1e52u;
+        x ^= x * 0xc7afe638u;
+        x ^= x * 0x8d22f6e6u;
+        return x;
+    }
+
+    static uint32_t nested_uniform_scramble(uint32_t x, uint32_t seed) {
+        return reverse_bits(laine_karras_permutation(reverse_bits(x), seed));
+    }
+};
+
+// Amostrador da thread atual; a câmera o reinicia a cada amostra de cada pixel
+inline path_sampler& current_sampler() {
+    thread_local path_sampler sampler;
+    return sampler;
+}
+
+#endif
@@ -0,0 +1,1024 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include "camera.h"
+#include "hittable_list.h"
+#include "instance.h"
+#include "lights.h"
+#include "mapped_file.h"
+#include "material.h"
+#include "mesh_file.h"
+#include "scene_tokenizer.h"
+#include "sphere_batch.h"
+
+#include <algorithm>
+#include <charconv>
+#include <climits>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+
+// Cena completa: tabela de materiais, esferas, objetos e as suas instâncias,
+// parâmetros da câmera e, nas animações, a trajetória da câmera.
+//
+// Formato de texto (.scene), uma instrução por linha, '#' inicia comentário:
+//
+//   camera <parâmetro> <valores...>       por exemplo: camera lookfrom 13 2 3
+//   material <nome> lambertian <r> <g> <b>
+//   material <nome> metal <r> <g> <b> <fuzz>
+//   material <nome> dielectric <índice de refração>
+//   material <nome> light <r> <g> <b>     superfície emissora, com a radiância emitida
+//   sphere <x> <y> <z> <raio> <nome do material>
+//   object <nome>                         início de um objeto: as esferas até 'end'
+//   end                                   são dele, e não da cena
+//   mesh <nome> <arquivo.obj> <material>  objeto feito de uma malha de triângulos
+//   instance <objeto> <modificadores...>  cópia do objeto; modificadores:
+//       material <nome>                   troca o material de todo o objeto
+//       translate <x> <y> <z>
+//       rotate <eixo x y z> <graus>
+//       scale <sx> <sy> <sz>
+//       matrix <12 números>               matriz 3x4 por linhas (a 4ª coluna é a translação)
+//   keyframe <quadro> <lookfrom x y z> <lookat x y z> <vfov> <focus_dist>
+//
+// Cenas com quadros-chave são animações: a câmera segue a trajetória que passa
+// por eles (camera_path), do quadro 0 até o último quadro-chave.
+//
+// As transformações de uma instância são aplicadas na ordem em que aparecem:
+// "scale 2 2 2 rotate 0 1 0 45 translate 3 0 0" primeiro escala, depois gira
+// e por último desloca o objeto. O objeto é guardado uma vez só, não importa
+// quantas instâncias o usem. O caminho de uma malha é relativo ao diretório
+// do arquivo de cena; veja load_mesh para o cache binário das malhas.
+//
+// Números aceitam a forma a/b (por exemplo, camera aspect_ratio 16/9).
+//
+// Esferas e triângulos com material light são as luzes da cena: a câmera as
+// amostra diretamente a partir das superfícies difusas (veja light_list). Uma
+// esfera emissora dentro de um objeto só pode ser instanciada com escala
+// uniforme, para continuar sendo uma esfera.
+//
+// Formato binário (.rtbin): cabeçalho fixo seguido dos arrays das esferas e dos
+// nós da BVH (da cena, de cada objeto e das instâncias), já na ordem final e
+// alinhados em 64 bytes. O arquivo é mapeado
+// em memória e copiado direto para o sphere_batch, sem parsing nem construção
+// da BVH, o que carrega milhões de esferas em milissegundos.
+
+// Objeto nomeado da cena, referenciado pelas instâncias: um grupo de esferas
+// ou uma malha de triângulos
+struct scene_object {
+    std::string name;
+    shared_ptr<sphere_batch> spheres;
+    shared_ptr<triangle_mesh> mesh;
+    std::string mesh_path;  // Arquivo de onde a malha foi lida (vazio se veio de um .rtbin)
+
+    shared_ptr<const hittable> geometry() const {
+        if (mesh)
+            return mesh;
+        return spheres;
+    }
+};
+
+class scene {
+  public:
+    material_table materials;
+    sphere_batch spheres;              // Esferas soltas, fora de qualquer objeto
+    std::vector<scene_object> objects;
+    instance_batch instances;
+    light_list lights;                 // Esferas e triângulos emissores, em coordenadas do mundo
+    camera cam;
+    camera_path path;
+
+    scene() = default;
+
+    // root() aponta para membros da própria cena
+    scene(const scene&) = delete;
+    scene& operator=(const scene&) = delete;
+
+    // Constrói as BVHs das esferas soltas e das instâncias (os objetos já vêm
+    // prontos) e liga a raiz. Chamada depois de montar a cena.
+    void build() {
+        spheres.build();
+        instances.build();
+        link();
+    }
+
+    // Liga a raiz às esferas e às instâncias, quando as BVHs já estão prontas
+    void link() {
+        both.clear();
+        both.add(shared_ptr<hittable>(shared_ptr<hittable>(), &spheres));
+        both.add(shared_ptr<hittable>(shared_ptr<hittable>(), &instances));
+    }
+
+    // O que a câmera renderiza. Sem instâncias é o próprio sphere_batch, sem
+    // nenhuma chamada virtual a mais.
+    const hittable& root() const {
+        if (instances.size() == 0)
+            return spheres;
+        if (spheres.size() == 0)
+            return instances;
+        return both;
+    }
+
+    // Monta a lista de luzes a partir das esferas soltas e das instâncias e
+    // liga a câmera a ela. Chamada depois de build() ou link(). Retorna false
+    // se uma esfera emissora está numa instância que não a leva numa esfera.
+    bool collect_lights(std::string& error) {
+        lights.clear();
+        auto add_spheres = [&](const sphere_batch& batch, const affine_transform* to_world, material_id override) {
+            auto d = batch.data();
+            for (size_t k = 0; k < d.count; k++) {
+                const material& m = materials[override != keep_material ? override : d.mat[k]];
+                if (!m.emits())
+                    continue;
+                point3 center(d.cx[k], d.cy[k], d.cz[k]);
+                double radius = d.radius[k];
+                if (to_world) {
+                    double scale;
+                    if (!uniform_scale(*to_world, scale)) {
+                        error = "esfera emissora numa instância com escala não uniforme";
+                        return false;
+                    }
+                    center = to_world->point(center);
+                    radius *= scale;
+                }
+                lights.add_sphere(center, radius, m.emission);
+            }
+            return true;
+        };
+
+        if (!add_spheres(spheres, nullptr, keep_material))
+            return false;
+
+        std::map<const hittable*, const scene_object*> object_of;
+        for (const auto& object : objects)
+            object_of[object.geometry().get()] = &object;
+        for (size_t k = 0; k < instances.size(); k++) {
+            const instance& item = instances[k];
+            const scene_object& object = *object_of[item.geometry().get()];
+            if (object.spheres) {
+                if (!add_spheres(*object.spheres, &item.transform(), item.material_override()))
+                    return false;
+                continue;
+            }
+
+            const triangle_mesh& mesh = *object.mesh;
+            const material& m = materials[item.material_override() != keep_material ? item.material_override()
+                                                                                      : mesh.mat];
+            if (!m.emits())
+                continue;
+            // As normais vão para o mundo como em instance::hit, pela
+            // transposta da inversa
+            affine_transform to_world = item.transform(), to_object = to_world.inverse();
+            auto d = mesh.data();
+            auto position = [&](uint32_t i) {
+                return to_world.point(point3(d.positions[3*size_t(i)], d.positions[3*size_t(i) + 1],
+                                             d.positions[3*size_t(i) + 2]));
+            };
+            auto normal = [&](uint32_t i) {
+                if (!d.normals)
+                    return vec3();
+                vec3 n(d.normals[3*size_t(i)], d.normals[3*size_t(i) + 1], d.normals[3*size_t(i) + 2]);
+                return n.near_zero() ? vec3() : unit_vector(to_object.transposed(n));
+            };
+            for (size_t t = 0; t < d.triangle_count; t++) {
+                const uint32_t* v = d.indices + 3*t;
+                lights.add_triangle(position(v[0]), position(v[1]), position(v[2]), m.emission,
+                                    normal(v[0]), normal(v[1]), normal(v[2]));
+            }
+        }
+
+        cam.lights = &lights;
+        return true;
+    }
+
+  private:
+    hittable_list both;  // Ponteiros sem posse para spheres e instances
+
+    // Se a parte linear da transformação é uma rotação (ou reflexão) vezes uma
+    // escala uniforme, que leva esferas em esferas; 'scale' recebe a escala
+    static bool uniform_scale(const affine_transform& x, double& scale) {
+        vec3 columns[3];
+        for (int j = 0; j < 3; j++)
+            columns[j] = vec3(x.m[0][j], x.m[1][j], x.m[2][j]);
+        double s2 = columns[0].length_squared();
+        double tolerance = 1e-5 * s2;
+        for (int i = 0; i < 3; i++)
+            for (int j = i; j < 3; j++)
+                if (std::fabs(dot(columns[i], columns[j]) - (i == j ? s2 : 0)) > tolerance)
+                    return false;
+        scale = std::sqrt(s2);
+        return true;
+    }
+};
+
+
+// Limites dos tamanhos da câmera: cada lado da imagem tem no máximo
+// camera_max_size pixels e cada pixel no máximo camera_max_samples amostras
+constexpr int camera_max_size = 65536;
+constexpr int camera_max_samples = 1 << 20;
+
+// Confere os tamanhos que decidem a alocação da imagem e a divisão em tiles.
+// É a mesma conferência para as cenas em texto e binárias, a linha de comando
+// e a prévia.
+inline bool check_camera_size(int image_width, double aspect_ratio, int samples_per_pixel, int tile_size,
+                              std::string& error) {
+    auto range = [](int lo, int hi) { return " deve estar entre " + std::to_string(lo) + " e " + std::to_string(hi); };
+    if (image_width < 1 || image_width > camera_max_size)
+        error = "camera image_width" + range(1, camera_max_size);
+    else if (samples_per_pixel < 1 || samples_per_pixel > camera_max_samples)
+        error = "camera samples_per_pixel" + range(1, camera_max_samples);
+    else if (tile_size < 1 || tile_size > camera_max_size)
+        error = "camera tile_size" + range(1, camera_max_size);
+    else if (!(aspect_ratio > 0) || !(image_width / aspect_ratio >= 1 && image_width / aspect_ratio <= camera_max_size))
+        error = "camera aspect_ratio deve dar uma altura entre 1 e " + std::to_string(camera_max_size) + " pixels";
+    else
+        return true;
+    return false;
+}
+
+inline bool check_camera_size(const camera& cam, std::string& error) {
+    return check_camera_size(cam.image_width, cam.aspect_ratio, cam.samples_per_pixel, cam.tile_size, error);
+}
+
+// Atribui um parâmetro da câmera pelo nome. Retorna false, com a mensagem em
+// 'error' e sem mudar a câmera, se o nome não existir, se o número de valores
+// não for o esperado ou se o valor estiver fora dos limites.
+inline bool apply_camera_param(camera& cam, const std::string& name, const double* values, int count,
+                               std::string& error) {
+    auto set_vec = [&](vec3& v) { v = vec3(values[0], values[1], values[2]); };
+    auto expect = [&](int n) { return count == n; };
+
+    // Converter para int um valor fora da faixa seria comportamento indefinido
+    if (count == 1 && (name == "image_width" || name == "samples_per_pixel" || name == "max_depth"
+                       || name == "russian_roulette_depth" || name == "tile_size" || name == "min_samples"
+                       || name == "progressive_passes")
+        && !(values[0] >= INT_MIN && values[0] <= INT_MAX)) {
+        error = "camera " + name + " espera um inteiro";
+        return false;
+    }
+    if (name == "seed" && count == 1 && !(values[0] >= 0 && values[0] < 0x1p64)) {
+        error = "camera seed espera um inteiro não negativo";
+        return false;
+    }
+
+    // Os tamanhos são conferidos com o valor novo antes de mudar a câmera
+    if (count == 1) {
+        int width = cam.image_width, spp = cam.samples_per_pixel, tile = cam.tile_size;
+        double aspect = cam.aspect_ratio;
+        if (name == "image_width")       width = int(values[0]);
+        if (name == "samples_per_pixel") spp = int(values[0]);
+        if (name == "tile_size")         tile = int(values[0]);
+        if (name == "aspect_ratio")      aspect = values[0];
+        if (!check_camera_size(width, aspect, spp, tile, error))
+            return false;
+    }
+
+    if (name == "aspect_ratio"           && expect(1)) { cam.aspect_ratio = values[0]; return true; }
+    if (name == "image_width"            && expect(1)) { cam.image_width = int(values[0]); return true; }
+    if (name == "samples_per_pixel"      && expect(1)) { cam.samples_per_pixel = int(values[0]); return true; }
+    if (name == "max_depth"              && expect(1)) { cam.max_depth = int(values[0]); return true; }
+    if (name == "vfov"                   && expect(1)) { cam.vfov = values[0]; return true; }
+    if (name == "lookfrom"               && expect(3)) { set_vec(cam.lookfrom); return true; }
+    if (name == "lookat"                 && expect(3)) { set_vec(cam.lookat); return true; }
+    if (name == "vup"                    && expect(3)) { set_vec(cam.vup); return true; }
+    if (name == "defocus_angle"          && expect(1)) { cam.defocus_angle = values[0]; return true; }
+    if (name == "focus_dist"             && expect(1)) { cam.focus_dist = values[0]; return true; }
+    if (name == "russian_roulette_depth" && expect(1)) { cam.russian_roulette_depth = int(values[0]); return true; }
+    if (name == "sky_intensity"          && expect(1)) { cam.sky_intensity = values[0]; return true; }
+    if (name == "light_sampling"         && expect(1)) { cam.light_sampling = values[0] != 0; return true; }
+    if (name == "seed"                   && expect(1)) { cam.seed = uint64_t(values[0]); return true; }
+    if (name == "tile_size"              && expect(1)) { cam.tile_size = int(values[0]); return true; }
+    if (name == "adaptive_sampling"      && expect(1)) { cam.adaptive_sampling = values[0] != 0; return true; }
+    if (name == "min_samples"            && expect(1)) { cam.min_samples = int(values[0]); return true; }
+    if (name == "adaptive_threshold"     && expect(1)) { cam.adaptive_threshold = values[0]; return true; }
+    if (name == "progressive_passes"     && expect(1)) { cam.progressive_passes = int(values[0]); return true; }
+    error = "parâmetro de câmera desconhecido ou com número errado de valores '" + name + "'";
+    return false;
+}
+
+
+// base_dir é o diretório de onde os caminhos das malhas são relativos
+inline bool load_scene_text(const char* text, size_t size, scene& out, std::string& error,
+                            const std::string& base_dir = "") {
+    scene_tokenizer in(text, text + size);
+    std::map<std::string, material_id> names;
+    std::map<std::string, size_t> object_names;
+    std::string keyword, name, kind;
+    sphere_batch* current = &out.spheres;  // Onde vão as esferas: a cena ou o objeto aberto
+    bool in_object = false;
+
+    auto fail = [&](const std::string& message) {
+        error = "linha " + std::to_string(in.line) + ": " + message;
+        return false;
+    };
+
+    auto numbers = [&](double* v, int n) {
+        for (int k = 0; k < n; k++)
+            if (!in.number(v[k]))
+                return false;
+        return true;
+    };
+
+    while (in.next_line()) {
+        in.word(keyword);
+
+        if (keyword == "sphere") {
+            double x, y, z, r;
+            if (!in.number(x) || !in.number(y) || !in.number(z) || !in.number(r))
+                return fail("esfera espera <x> <y> <z> <raio> <material>");
+            if (!in.word(name))
+                return fail("esfera sem material");
+            auto found = names.find(name);
+            if (found == names.end())
+                return fail("material desconhecido '" + name + "'");
+            current->add(point3(x, y, z), r, found->second);
+
+        } else if (keyword == "object") {
+            if (in_object)
+                return fail("objeto dentro de outro objeto");
+            if (!in.word(name))
+                return fail("object espera <nome>");
+            if (object_names.count(name))
+                return fail("objeto repetido '" + name + "'");
+            object_names[name] = out.objects.size();
+            out.objects.push_back({ name, make_shared<sphere_batch>(), nullptr, "" });
+            current = out.objects.back().spheres.get();
+            in_object = true;
+
+        } else if (keyword == "end") {
+            if (!in_object)
+                return fail("end sem object");
+            if (current->size() == 0)
+                return fail("objeto vazio '" + out.objects.back().name + "'");
+            current->build();
+            current = &out.spheres;
+            in_object = false;
+
+        } else if (keyword == "mesh") {
+            if (in_object)
+                return fail("malha dentro de um objeto");
+            std::string file;
+            if (!in.word(name) || !in.word(file) || !in.word(kind))
+                return fail("mesh espera <nome> <arquivo> <material>");
+            if (object_names.count(name))
+                return fail("objeto repetido '" + name + "'");
+            auto found = names.find(kind);
+            if (found == names.end())
+                return fail("material desconhecido '" + kind + "'");
+
+            std::filesystem::path mesh_path(file);
+            if (mesh_path.is_relative() && !base_dir.empty())
+                mesh_path = std::filesystem::path(base_dir) / mesh_path;
+            auto mesh = make_shared<triangle_mesh>();
+            std::string mesh_error;
+            if (!load_mesh(mesh_path.string(), *mesh, mesh_error))
+                return fail(mesh_path.string() + ": " + mesh_error);
+            mesh->mat = found->second;
+
+            std::error_code ec;
+            auto absolute = std::filesystem::absolute(mesh_path, ec);
+            object_names[name] = out.objects.size();
+            out.objects.push_back({ name, nullptr, mesh, (ec ? mesh_path : absolute).string() });
+
+        } else if (keyword == "instance") {
+            if (in_object)
+                return fail("instância dentro de um objeto");
+            if (!in.word(name))
+                return fail("instance espera <objeto> <modificadores>");
+            auto found = object_names.find(name);
+            if (found == object_names.end())
+                return fail("objeto desconhecido '" + name + "'");
+
+            affine_transform to_world;
+            material_id mat = keep_material;
+            std::string op;
+            double v[12];
+            while (in.word(op)) {
+                if (op == "translate" && numbers(v, 3)) {
+                    to_world = affine_transform::translate(vec3(v[0], v[1], v[2])) * to_world;
+                } else if (op == "rotate" && numbers(v, 4)) {
+                    if (v[0] == 0 && v[1] == 0 && v[2] == 0)
+                        return fail("eixo de rotação nulo");
+                    to_world = affine_transform::rotate(vec3(v[0], v[1], v[2]), v[3]) * to_world;
+                } else if (op == "scale" && numbers(v, 3)) {
+                    to_world = affine_transform::scale(vec3(v[0], v[1], v[2])) * to_world;
+                } else if (op == "matrix" && numbers(v, 12)) {
+                    affine_transform x;
+                    for (int k = 0; k < 12; k++)
+                        x.m[k / 4][k % 4] = real(v[k]);
+                    to_world = x * to_world;
+                } else if (op == "material" && in.word(kind)) {
+                    auto m = names.find(kind);
+                    if (m == names.end())
+                        return fail("material desconhecido '" + kind + "'");
+                    mat = m->second;
+                } else {
+                    return fail("modificador de instância inválido '" + op + "' (use material, translate, "
+                                "rotate, scale ou matrix, com os seus valores)");
+                }
+            }
+            if (!(std::fabs(to_world.determinant()) > 0))
+                return fail("transformação não invertível");
+            out.instances.add(instance(out.objects[found->second].geometry(), to_world, mat));
+
+        } else if (keyword == "material") {
+            if (!in.word(name) || !in.word(kind))
+                return fail("material espera <nome> <tipo> <parâmetros>");
+
+            double v[4];
+            material mat;
+            if (kind == "lambertian") {
+                if (!in.number(v[0]) || !in.number(v[1]) || !in.number(v[2]))
+                    return fail("lambertian espera <r> <g> <b>");
+                mat = lambertian(color(v[0], v[1], v[2]));
+            } else if (kind == "metal") {
+                if (!in.number(v[0]) || !in.number(v[1]) || !in.number(v[2]) || !in.number(v[3]))
+                    return fail("metal espera <r> <g> <b> <fuzz>");
+                mat = metal(color(v[0], v[1], v[2]), v[3]);
+            } else if (kind == "dielectric") {
+                if (!in.number(v[0]))
+                    return fail("dielectric espera <índice de refração>");
+                mat = dielectric(v[0]);
+            } else if (kind == "light") {
+                if (!in.number(v[0]) || !in.number(v[1]) || !in.number(v[2]))
+                    return fail("light espera <r> <g> <b>");
+                mat = diffuse_light(color(v[0], v[1], v[2]));
+            } else {
+                return fail("tipo de material desconhecido '" + kind + "'");
+            }
+            names[name] = out.materials.add(mat);
+
+        } else if (keyword == "keyframe") {
+            double v[9];
+            for (double& x : v)
+                if (!in.number(x))
+                    return fail("keyframe espera <quadro> <lookfrom x y z> <lookat x y z> <vfov> <focus_dist>");
+            if (v[0] < 0)
+                return fail("quadro negativo em keyframe");
+            out.path.add({ v[0], point3(v[1], v[2], v[3]), point3(v[4], v[5], v[6]), v[7], v[8] });
+
+        } else if (keyword == "camera") {
+            if (!in.word(name))
+                return fail("camera espera <parâmetro> <valores>");
+            double values[3];
+            int count = 0;
+            while (!in.at_line_end()) {
+                if (count == 3 || !in.number(values[count]))
+                    return fail("valor inválido para camera " + name);
+                count++;
+            }
+            std::string message;
+            if (!apply_camera_param(out.cam, name, values, count, message))
+                return fail(message);
+
+        } else {
+            return fail("instrução desconhecida '" + keyword + "'");
+        }
+
+        if (!in.at_line_end())
+            return fail("valores sobrando no fim da linha");
+    }
+
+    if (in_object)
+        return fail("objeto '" + out.objects.back().name + "' sem end");
+
+    out.build();
+    return out.collect_lights(error);
+}
+
+// Menor representação decimal que lê de volta exatamente o mesmo valor. Com
+// float, imprimir o float (e não a sua conversão para double) evita saídas
+// como 0.10000000149011612.
+template <typename T>
+inline std::string format_number(T x) {
+    char buffer[32];
+    auto result = std::to_chars(buffer, buffer + sizeof buffer, x);
+    return std::string(buffer, result.ptr);
+}
+
+inline std::string format_vec3(const vec3& v) {
+    return format_number(v.x()) + ' ' + format_number(v.y()) + ' ' + format_number(v.z());
+}
+
+// Malhas que não vieram de um arquivo (lidas de um .rtbin) são referenciadas
+// pelo nome dado em mesh_files[k] para o objeto k; save_scene grava esses
+// arquivos.
+inline void save_scene_text(std::ostream& out, const scene& s, const std::vector<std::string>& mesh_files = {}) {
+    const camera& c = s.cam;
+    out << "camera aspect_ratio " << format_number(c.aspect_ratio) << '\n'
+        << "camera image_width " << c.image_width << '\n'
+        << "camera samples_per_pixel " << c.samples_per_pixel << '\n'
+        << "camera max_depth " << c.max_depth << '\n'
+        << "camera vfov " << format_number(c.vfov) << '\n'
+        << "camera lookfrom " << format_vec3(c.lookfrom) << '\n'
+        << "camera lookat " << format_vec3(c.lookat) << '\n'
+        << "camera vup " << format_vec3(c.vup) << '\n'
+        << "camera defocus_angle " << format_number(c.defocus_angle) << '\n'
+        << "camera focus_dist " << format_number(c.focus_dist) << '\n'
+        << "camera russian_roulette_depth " << c.russian_roulette_depth << '\n'
+        << "camera sky_intensity " << format_number(c.sky_intensity) << '\n'
+        << "camera light_sampling " << (c.light_sampling ? 1 : 0) << '\n'
+        << "camera seed " << c.seed << '\n'
+        << "camera tile_size " << c.tile_size << '\n'
+        << "camera adaptive_sampling " << (c.adaptive_sampling ? 1 : 0) << '\n'
+        << "camera min_samples " << c.min_samples << '\n'
+        << "camera adaptive_threshold " << format_number(c.adaptive_threshold) << '\n'
+        << "camera progressive_passes " << c.progressive_passes << "\n\n";
+
+    for (size_t k = 0; k < s.materials.size(); k++) {
+        const material& m = s.materials[material_id(k)];
+        out << "material m" << k << ' ';
+        switch (m.type) {
+            case material::kind::lambertian: out << "lambertian " << format_vec3(m.albedo); break;
+            case material::kind::metal:      out << "metal " << format_vec3(m.albedo) << ' ' << format_number(m.fuzz); break;
+            case material::kind::dielectric: out << "dielectric " << format_number(m.refraction_index); break;
+            case material::kind::diffuse_light: out << "light " << format_vec3(m.emission); break;
+            case material::kind::absorber:   out << "lambertian 0 0 0"; break;
+        }
+        out << '\n';
+    }
+    out << '\n';
+
+    for (const auto& key : s.path.keys)
+        out << "keyframe " << format_number(key.frame) << ' ' << format_vec3(key.lookfrom) << ' '
+            << format_vec3(key.lookat) << ' ' << format_number(key.vfov) << ' '
+            << format_number(key.focus_dist) << '\n';
+    if (!s.path.empty())
+        out << '\n';
+
+    auto write_spheres = [&](const sphere_batch& batch) {
+        auto d = batch.data();
+        for (size_t k = 0; k < d.count; k++)
+            out << "sphere " << format_vec3(point3(d.cx[k], d.cy[k], d.cz[k])) << ' '
+                << format_number(d.radius[k]) << " m" << d.mat[k] << '\n';
+    };
+    write_spheres(s.spheres);
+
+    // Os objetos são gravados como o0, o1, ... e as instâncias com a matriz
+    // final, que lê de volta exatamente a mesma transformação
+    std::map<const hittable*, size_t> object_index;
+    for (size_t k = 0; k < s.objects.size(); k++) {
+        const scene_object& object = s.objects[k];
+        object_index[object.geometry().get()] = k;
+        if (object.mesh) {
+            const std::string& file = !object.mesh_path.empty() ? object.mesh_path
+                                    : k < mesh_files.size() ? mesh_files[k] : object.mesh_path;
+            out << "\nmesh o" << k << ' ' << file << " m" << object.mesh->mat << '\n';
+            continue;
+        }
+        out << "\nobject o" << k << '\n';
+        write_spheres(*object.spheres);
+        out << "end\n";
+    }
+    if (s.instances.size() > 0)
+        out << '\n';
+    for (size_t k = 0; k < s.instances.size(); k++) {
+        const instance& item = s.instances[k];
+        out << "instance o" << object_index[item.geometry().get()];
+        if (item.material_override() != keep_material)
+            out << " material m" << item.material_override();
+        out << " matrix";
+        for (const auto& row : item.transform().m)
+            for (real x : row)
+                out << ' ' << format_number(x);
+        out << '\n';
+    }
+}
+
+
+// Hash do conteúdo da cena (materiais, esferas, objetos e instâncias), usado pelos checkpoints para
+// reconhecer a cena de um render. Não inclui a câmera, que a câmera mesma
+// identifica (camera::checkpoint_key), nem a trajetória das animações.
+inline uint64_t hash_scene(const scene& s) {
+    uint64_t h = 0;
+    auto mix = [&](const void* data, size_t size) {
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        for (size_t k = 0; k < size; k += 8) {
+            uint64_t word = 0;
+            std::memcpy(&word, p + k, std::min<size_t>(8, size - k));
+            h = hash_u64(h ^ word);
+        }
+    };
+
+    for (size_t k = 0; k < s.materials.size(); k++) {
+        const material& m = s.materials[material_id(k)];
+        double values[9] = { double(m.type), m.albedo.x(), m.albedo.y(), m.albedo.z(), m.fuzz, m.refraction_index,
+                             m.emission.x(), m.emission.y(), m.emission.z() };
+        mix(values, sizeof values);
+    }
+    auto mix_spheres = [&](const sphere_batch& batch) {
+        auto d = batch.data();
+        mix(d.cx, d.count * sizeof(real));
+        mix(d.cy, d.count * sizeof(real));
+        mix(d.cz, d.count * sizeof(real));
+        mix(d.radius, d.count * sizeof(real));
+        mix(d.mat, d.count * sizeof(material_id));
+    };
+    mix_spheres(s.spheres);
+
+    std::map<const hittable*, uint64_t> object_index;
+    for (size_t k = 0; k < s.objects.size(); k++) {
+        const scene_object& object = s.objects[k];
+        object_index[object.geometry().get()] = k;
+        if (object.mesh) {
+            auto d = object.mesh->data();
+            uint64_t sizes[3] = { d.vertex_count, d.triangle_count, object.mesh->mat };
+            mix(sizes, sizeof sizes);
+            mix(d.positions, 3 * d.vertex_count * sizeof(real));
+            if (d.normals)
+                mix(d.normals, 3 * d.vertex_count * sizeof(float));
+            mix(d.indices, 3 * d.triangle_count * sizeof(uint32_t));
+        } else {
+            h = hash_u64(h ^ object.spheres->size());
+            mix_spheres(*object.spheres);
+        }
+    }
+    for (size_t k = 0; k < s.instances.size(); k++) {
+        const instance& item = s.instances[k];
+        uint64_t ids[2] = { object_index[item.geometry().get()], item.material_override() };
+        mix(ids, sizeof ids);
+        mix(item.transform().m, sizeof item.transform().m);
+    }
+    return h;
+}
+
+
+// Estruturas do formato binário. Todos os campos têm tamanho fixo; o arquivo é
+// escrito na ordem de bytes da máquina (little-endian nas plataformas comuns).
+struct scene_file_camera {
+    double   aspect_ratio, vfov, defocus_angle, focus_dist, adaptive_threshold, sky_intensity;
+    double   lookfrom[3], lookat[3], vup[3];
+    int32_t  image_width, samples_per_pixel, max_depth, russian_roulette_depth;
+    int32_t  min_samples, progressive_passes, adaptive_sampling, tile_size;
+    int32_t  light_sampling, reserved;
+    uint64_t seed;
+};
+
+struct scene_file_material {
+    uint32_t type;
+    uint32_t reserved;
+    double   albedo[3];
+    double   fuzz;
+    double   refraction_index;
+    double   emission[3];
+};
+
+struct scene_file_keyframe {
+    double   frame;
+    double   lookfrom[3], lookat[3];
+    double   vfov, focus_dist;
+};
+
+// Arrays de um conjunto de esferas: as esferas soltas da cena ou um objeto
+struct scene_file_spheres {
+    uint64_t sphere_count, node_count;
+    // Posições, a partir do início do arquivo, de cada array
+    uint64_t cx_offset, cy_offset, cz_offset, radius_offset, mat_offset, nodes_offset;
+};
+
+// Objeto da cena: kind 0 é um grupo de esferas, 1 é uma malha (com o seu material)
+struct scene_file_object {
+    uint32_t kind;
+    uint32_t material;
+    scene_file_spheres spheres;
+    mesh_file_arrays mesh;
+};
+
+struct scene_file_instance {
+    uint32_t object;
+    uint32_t material;   // keep_material se a instância não troca o material
+    double   matrix[12]; // Matriz 3x4 por linhas
+};
+
+struct scene_file_header {
+    char     magic[8];   // "RTSCENE6"
+    uint32_t real_size;  // sizeof(real) de quem gravou: 8 (double) ou 4 (float)
+    uint32_t reserved;
+    uint64_t material_count, keyframe_count, object_count, instance_count, instance_node_count;
+    // Posições, a partir do início do arquivo, de cada array. objects_offset
+    // aponta para um scene_file_object por objeto.
+    uint64_t materials_offset, keyframes_offset, objects_offset, instances_offset, instance_nodes_offset;
+    scene_file_spheres spheres;
+    scene_file_camera cam;
+};
+
+constexpr char scene_file_magic[8] = { 'R', 'T', 'S', 'C', 'E', 'N', 'E', '6' };
+
+inline bool write_scene_binary(std::ostream& file, const scene& s) {
+    const camera& c = s.cam;
+
+    scene_file_header header = {};
+    std::memcpy(header.magic, scene_file_magic, 8);
+    header.real_size = sizeof(real);
+    header.material_count = s.materials.size();
+    header.keyframe_count = s.path.keys.size();
+    header.object_count = s.objects.size();
+    header.instance_count = s.instances.size();
+    header.instance_node_count = s.instances.nodes().size();
+
+    header.cam = { c.aspect_ratio, c.vfov, c.defocus_angle, c.focus_dist, c.adaptive_threshold, c.sky_intensity,
+                   { c.lookfrom.x(), c.lookfrom.y(), c.lookfrom.z() },
+                   { c.lookat.x(), c.lookat.y(), c.lookat.z() },
+                   { c.vup.x(), c.vup.y(), c.vup.z() },
+                   c.image_width, c.samples_per_pixel, c.max_depth, c.russian_roulette_depth,
+                   c.min_samples, c.progressive_passes, c.adaptive_sampling ? 1 : 0, c.tile_size,
+                   c.light_sampling ? 1 : 0, 0, c.seed };
+
+    std::vector<scene_file_material> mats(s.materials.size());
+    for (size_t k = 0; k < mats.size(); k++) {
+        const material& m = s.materials[material_id(k)];
+        mats[k] = { uint32_t(m.type), 0, { m.albedo.x(), m.albedo.y(), m.albedo.z() },
+                    m.fuzz, m.refraction_index, { m.emission.x(), m.emission.y(), m.emission.z() } };
+    }
+
+    std::vector<scene_file_keyframe> keys(s.path.keys.size());
+    for (size_t k = 0; k < keys.size(); k++) {
+        const camera_keyframe& key = s.path.keys[k];
+        keys[k] = { key.frame, { key.lookfrom.x(), key.lookfrom.y(), key.lookfrom.z() },
+                    { key.lookat.x(), key.lookat.y(), key.lookat.z() }, key.vfov, key.focus_dist };
+    }
+
+    std::map<const hittable*, uint32_t> object_index;
+    for (size_t k = 0; k < s.objects.size(); k++)
+        object_index[s.objects[k].geometry().get()] = uint32_t(k);
+
+    std::vector<scene_file_instance> instances(s.instances.size());
+    for (size_t k = 0; k < instances.size(); k++) {
+        const instance& item = s.instances[k];
+        instances[k].object = object_index[item.geometry().get()];
+        instances[k].material = item.material_override();
+        for (int j = 0; j < 12; j++)
+            instances[k].matrix[j] = item.transform().m[j / 4][j % 4];
+    }
+
+    std::vector<file_block> blocks = {
+        { &header.materials_offset, mats.data(), mats.size() * sizeof(scene_file_material) },
+        { &header.keyframes_offset, keys.data(), keys.size() * sizeof(scene_file_keyframe) },
+        { &header.instances_offset, instances.data(), instances.size() * sizeof(scene_file_instance) },
+        { &header.instance_nodes_offset, s.instances.nodes().data(), s.instances.nodes().size() * sizeof(bvh_node) },
+    };
+
+    auto add_spheres = [&](scene_file_spheres& out, const sphere_batch& batch) {
+        auto d = batch.data();
+        out.sphere_count = d.count;
+        out.node_count = d.node_count;
+        blocks.push_back({ &out.cx_offset,     d.cx,     d.count * sizeof(real) });
+        blocks.push_back({ &out.cy_offset,     d.cy,     d.count * sizeof(real) });
+        blocks.push_back({ &out.cz_offset,     d.cz,     d.count * sizeof(real) });
+        blocks.push_back({ &out.radius_offset, d.radius, d.count * sizeof(real) });
+        blocks.push_back({ &out.mat_offset,    d.mat,    d.count * sizeof(material_id) });
+        blocks.push_back({ &out.nodes_offset,  d.nodes,  d.node_count * sizeof(bvh_node) });
+    };
+    add_spheres(header.spheres, s.spheres);
+
+    // A tabela de objetos é um bloco cujo conteúdo (as posições dos arrays de
+    // cada objeto) só fica pronto depois que todos os blocos são posicionados
+    std::vector<scene_file_object> objects(s.objects.size());
+    blocks.push_back({ &header.objects_offset, objects.data(), objects.size() * sizeof(scene_file_object) });
+    for (size_t k = 0; k < objects.size(); k++) {
+        const scene_object& object = s.objects[k];
+        if (object.mesh) {
+            objects[k].kind = 1;
+            objects[k].material = object.mesh->mat;
+            add_mesh_blocks(blocks, objects[k].mesh, *object.mesh);
+        } else {
+            add_spheres(objects[k].spheres, *object.spheres);
+        }
+    }
+
+    return write_file_blocks(file, &header, sizeof header, blocks);
+}
+
+inline bool save_scene_binary(const std::string& path, const scene& s) {
+    std::ofstream file(path, std::ios::binary);
+    return file && write_scene_binary(file, s);
+}
+
+// Lê um conjunto de esferas do arquivo mapeado para o batch
+inline bool read_scene_spheres(const char* bytes, size_t size, const scene_file_spheres& src,
+                               uint64_t material_count, sphere_batch& out, std::string& error) {
+    auto fits = [&](uint64_t offset, uint64_t count, uint64_t element) {
+        return file_array_fits(size, offset, count, element);
+    };
+    uint64_t n = src.sphere_count;
+    if (!fits(src.cx_offset, n, sizeof(real)) || !fits(src.cy_offset, n, sizeof(real))
+        || !fits(src.cz_offset, n, sizeof(real)) || !fits(src.radius_offset, n, sizeof(real))
+        || !fits(src.mat_offset, n, sizeof(material_id))
+        || !fits(src.nodes_offset, src.node_count, sizeof(bvh_node))
+        || (n > 0 && src.node_count == 0)) {
+        error = "arquivo de cena binária truncado ou corrompido";
+        return false;
+    }
+
+    // Os arrays são conferidos e copiados direto do mapeamento para o batch
+    std::vector<bvh_node> nodes_copy;
+    std::vector<material_id> mat_copy;
+    std::vector<real> cx_copy, cy_copy, cz_copy, radius_copy;
+    const bvh_node* nodes = file_array(bytes, src.nodes_offset, src.node_count, nodes_copy);
+    if (!valid_bvh_nodes(nodes, src.node_count, n)) {
+        error = "nó de BVH inválido na cena binária";
+        return false;
+    }
+
+    const material_id* mat = file_array(bytes, src.mat_offset, n, mat_copy);
+    for (uint64_t k = 0; k < n; k++) {
+        if (mat[k] >= material_count) {
+            error = "índice de material inválido na cena binária";
+            return false;
+        }
+    }
+
+    out.restore({ n, file_array(bytes, src.cx_offset, n, cx_copy), file_array(bytes, src.cy_offset, n, cy_copy),
+                  file_array(bytes, src.cz_offset, n, cz_copy), file_array(bytes, src.radius_offset, n, radius_copy),
+                  mat, nodes, src.node_count });
+    return true;
+}
+
+inline bool load_scene_binary(const char* bytes, size_t size, scene& out, std::string& error) {
+    scene_file_header header;
+    if (size < sizeof header || std::memcmp(bytes, scene_file_magic, 8) != 0) {
+        error = (size >= 8 && std::memcmp(bytes, scene_file_magic, 7) == 0)
+              ? "cena binária de outra versão do formato; grave-a de novo a partir do texto"
+              : "cabeçalho de cena binária inválido";
+        return false;
+    }
+    std::memcpy(&header, bytes, sizeof header);
+
+    // Os arrays e os nós da BVH são gravados na precisão do renderizador, então
+    // um arquivo float só pode ser lido pelo build float (e vice-versa)
+    if (header.real_size != sizeof(real)) {
+        error = header.real_size == 4 ? "cena binária gravada em float; use o build com RT_USE_FLOAT"
+                                      : "cena binária gravada em double; use o build sem RT_USE_FLOAT";
+        return false;
+    }
+
+    auto fits = [&](uint64_t offset, uint64_t count, uint64_t element) {
+        return file_array_fits(size, offset, count, element);
+    };
+    if (!fits(header.materials_offset, header.material_count, sizeof(scene_file_material))
+        || !fits(header.keyframes_offset, header.keyframe_count, sizeof(scene_file_keyframe))
+        || !fits(header.objects_offset, header.object_count, sizeof(scene_file_object))
+        || !fits(header.instances_offset, header.instance_count, sizeof(scene_file_instance))
+        || !fits(header.instance_nodes_offset, header.instance_node_count, sizeof(bvh_node))
+        || (header.instance_count > 0 && header.instance_node_count == 0)) {
+        error = "arquivo de cena binária truncado ou corrompido";
+        return false;
+    }
+
+    // A BVH das instâncias é conferida antes de ler os objetos, para que uma
+    // cena corrompida (inclusive a recebida por um worker) falhe logo
+    std::vector<bvh_node> instance_nodes_copy;
+    const bvh_node* instance_nodes = file_array(bytes, header.instance_nodes_offset,
+                                                header.instance_node_count, instance_nodes_copy);
+    if (!valid_bvh_nodes(instance_nodes, header.instance_node_count, header.instance_count)) {
+        error = "nó de BVH inválido na cena binária";
+        return false;
+    }
+
+    for (uint64_t k = 0; k < header.material_count; k++) {
+        scene_file_material m;
+        std::memcpy(&m, bytes + header.materials_offset + k * sizeof m, sizeof m);
+        if (m.type > uint32_t(material::kind::diffuse_light)) {
+            error = "tipo de material inválido na cena binária";
+            return false;
+        }
+        material mat_k;
+        mat_k.type = material::kind(m.type);
+        mat_k.albedo = color(m.albedo[0], m.albedo[1], m.albedo[2]);
+        mat_k.fuzz = m.fuzz;
+        mat_k.refraction_index = m.refraction_index;
+        mat_k.emission = color(m.emission[0], m.emission[1], m.emission[2]);
+        out.materials.add(mat_k);
+    }
+
+    if (!read_scene_spheres(bytes, size, header.spheres, header.material_count, out.spheres, error))
+        return false;
+
+    for (uint64_t k = 0; k < header.object_count; k++) {
+        scene_file_object src;
+        std::memcpy(&src, bytes + header.objects_offset + k * sizeof src, sizeof src);
+        std::string name = "o" + std::to_string(k);
+        if (src.kind == 1) {
+            auto mesh = make_shared<triangle_mesh>();
+            if (src.material >= header.material_count) {
+                error = "índice de material inválido na cena binária";
+                return false;
+            }
+            if (!read_mesh_arrays(bytes, size, src.mesh, *mesh, error))
+                return false;
+            mesh->mat = src.material;
+            out.objects.push_back({ name, nullptr, mesh, "" });
+        } else if (src.kind == 0) {
+            auto batch = make_shared<sphere_batch>();
+            if (!read_scene_spheres(bytes, size, src.spheres, header.material_count, *batch, error))
+                return false;
+            out.objects.push_back({ name, batch, nullptr, "" });
+        } else {
+            error = "tipo de objeto inválido na cena binária";
+            return false;
+        }
+    }
+
+    std::vector<instance> instances;
+    instances.reserve(header.instance_count);
+    for (uint64_t k = 0; k < header.instance_count; k++) {
+        scene_file_instance src;
+        std::memcpy(&src, bytes + header.instances_offset + k * sizeof src, sizeof src);
+        affine_transform to_world;
+        for (int j = 0; j < 12; j++)
+            to_world.m[j / 4][j % 4] = real(src.matrix[j]);
+        if (src.object >= header.object_count
+            || (src.material != keep_material && src.material >= header.material_count)
+            || !(std::fabs(to_world.determinant()) > 0)) {
+            error = "instância inválida na cena binária";
+            return false;
+        }
+        instances.emplace_back(out.objects[src.object].geometry(), to_world, src.material);
+    }
+    out.instances.restore(std::move(instances), instance_nodes, header.instance_node_count);
+    out.link();
+    if (!out.collect_lights(error))
+        return false;
+
+    for (uint64_t k = 0; k < header.keyframe_count; k++) {
+        scene_file_keyframe key;
+        std::memcpy(&key, bytes + header.keyframes_offset + k * sizeof key, sizeof key);
+        if (!(key.frame >= 0)) {
+            error = "quadro-chave inválido na cena binária";
+            return false;
+        }
+        out.path.add({ key.frame, point3(key.lookfrom[0], key.lookfrom[1], key.lookfrom[2]),
+                       point3(key.lookat[0], key.lookat[1], key.lookat[2]), key.vfov, key.focus_dist });
+    }
+
+    const scene_file_camera& c = header.cam;
+    camera& cam = out.cam;
+    cam.aspect_ratio = c.aspect_ratio;
+    cam.vfov = c.vfov;
+    cam.defocus_angle = c.defocus_angle;
+    cam.focus_dist = c.focus_dist;
+    cam.adaptive_threshold = c.adaptive_threshold;
+    cam.sky_intensity = c.sky_intensity;
+    cam.lookfrom = point3(c.lookfrom[0], c.lookfrom[1], c.lookfrom[2]);
+    cam.lookat = point3(c.lookat[0], c.lookat[1], c.lookat[2]);
+    cam.vup = vec3(c.vup[0], c.vup[1], c.vup[2]);
+    cam.image_width = c.image_width;
+    cam.samples_per_pixel = c.samples_per_pixel;
+    cam.max_depth = c.max_depth;
+    cam.russian_roulette_depth = c.russian_roulette_depth;
+    cam.min_samples = c.min_samples;
+    cam.progressive_passes = c.progressive_passes;
+    cam.adaptive_sampling = c.adaptive_sampling != 0;
+    cam.tile_size = c.tile_size;
+    cam.light_sampling = c.light_sampling != 0;
+    cam.seed = c.seed;
+    return check_camera_size(cam, error);
+}
+
+// Carrega uma cena em qualquer um dos formatos; o binário é reconhecido pelo
+// cabeçalho, não pela extensão
+inline bool load_scene(const std::string& path, scene& out, std::string& error) {
+    mapped_file file;
+    if (!file.open(path)) {
+        error = "não foi possível abrir " + path;
+        return false;
+    }
+
+    // Qualquer versão do formato binário vai para o leitor binário, que
+    // recusa as que não forem a atual
+    if (file.size() >= 8 && std::memcmp(file.data(), scene_file_magic, 7) == 0)
+        return load_scene_binary(file.data(), file.size(), out, error);
+    return load_scene_text(file.data(), file.size(), out, error,
+                           std::filesystem::path(path).parent_path().string());
+}
+
+// Salva no formato indicado pela extensão (.rtbin para binário, texto nos outros casos)
+inline bool save_scene(const std::string& path, const scene& s) {
+    if (path.size() >= 6 && path.compare(path.size() - 6, 6, ".rtbin") == 0)
+        return save_scene_binary(path, s);
+
+    // As malhas lidas de um .rtbin não têm arquivo de origem: vão para
+    // "<cena>.o<k>.rtmesh", ao lado da cena, e o texto as referencia pelo nome
+    // (relativo ao diretório da cena)
+    std::vector<std::string> mesh_files(s.objects.size());
+    for (size_t k = 0; k < s.objects.size(); k++) {
+        const scene_object& object = s.objects[k];
+        if (object.mesh && object.mesh_path.empty()) {
+            std::string mesh_path = path + ".o" + std::to_string(k) + ".rtmesh";
+            if (!save_mesh_binary(mesh_path, *object.mesh))
+                return false;
+            mesh_files[k] = std::filesystem::path(mesh_path).filename().string();
+        }
+    }
+
+    std::ofstream file(path);
+    if (!file)
+        return false;
+    save_scene_text(file, s, mesh_files);
+    return bool(file);
+}
+
+#endif
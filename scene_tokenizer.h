@@ -0,0 +1,86 @@
+#ifndef SCENE_TOKENIZER_H
+#define SCENE_TOKENIZER_H
+
+#include <charconv>
+#include <cstring>
+#include <string>
+
+
+// Leitor de tokens sobre um arquivo de texto, linha por linha, com '#' iniciando
+// comentário (cenas .scene e malhas OBJ), sem cópias nem alocação por número
+class scene_tokenizer {
+  public:
+    int line = 0;
+
+    scene_tokenizer(const char* begin, const char* end) : pos(begin), end(end) {}
+
+    // Avança para a próxima linha com conteúdo; retorna false no fim do arquivo
+    bool next_line() {
+        while (pos < end) {
+            line_end = static_cast<const char*>(std::memchr(pos, '\n', size_t(end - pos)));
+            if (!line_end)
+                line_end = end;
+            line++;
+
+            // Descarta o comentário
+            auto comment = static_cast<const char*>(std::memchr(pos, '#', size_t(line_end - pos)));
+            cursor = pos;
+            limit = comment ? comment : line_end;
+            pos = (line_end < end) ? line_end + 1 : end;
+
+            skip_spaces();
+            if (cursor < limit)
+                return true;
+        }
+        return false;
+    }
+
+    bool at_line_end() {
+        skip_spaces();
+        return cursor >= limit;
+    }
+
+    bool word(std::string& out) {
+        skip_spaces();
+        auto start = cursor;
+        while (cursor < limit && !is_space(*cursor))
+            cursor++;
+        out.assign(start, cursor);
+        return cursor > start;
+    }
+
+    // Lê um número, aceitando também a forma a/b
+    bool number(double& out) {
+        skip_spaces();
+        auto result = std::from_chars(cursor, limit, out);
+        if (result.ec != std::errc())
+            return false;
+        cursor = result.ptr;
+
+        if (cursor < limit && *cursor == '/') {
+            double denominator;
+            auto div = std::from_chars(cursor + 1, limit, denominator);
+            if (div.ec != std::errc() || denominator == 0)
+                return false;
+            out /= denominator;
+            cursor = div.ptr;
+        }
+        return cursor >= limit || is_space(*cursor);
+    }
+
+  private:
+    const char* pos;
+    const char* end;
+    const char* line_end = nullptr;
+    const char* cursor = nullptr;
+    const char* limit = nullptr;
+
+    static bool is_space(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+    void skip_spaces() {
+        while (cursor < limit && is_space(*cursor))
+            cursor++;
+    }
+};
+
+#endif
@@ -0,0 +1,267 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+// Vetores de doubles (vdouble) e floats (vfloat) com a maior largura disponível
+// na compilação: AVX-512 (8 doubles ou 16 floats), AVX/AVX2 (4 ou 8), SSE2
+// (2 ou 4) ou escalar (1). O conjunto é escolhido pelas flags do compilador
+// (por exemplo -mavx2 ou -march=native); o código que usa os vetores é o mesmo
+// em todos os casos.
+//
+// vreal e simd_width seguem a precisão do renderizador (real): vdouble por
+// padrão, vfloat com RT_USE_FLOAT.
+//
+// viota(base) retorna base, base+1, base+2, ... nas lanes.
+
+#if defined(__AVX512F__)
+    #include <immintrin.h>
+    #define RT_SIMD_NAME "avx512"
+#elif defined(__AVX__)
+    #include <immintrin.h>
+    #define RT_SIMD_NAME "avx"
+#elif defined(__SSE2__) || defined(_M_X64)
+    #include <emmintrin.h>
+    #define RT_SIMD_NAME "sse2"
+#else
+    #include <cmath>
+    #define RT_SIMD_NAME "scalar"
+#endif
+
+
+#if defined(__AVX512F__)
+
+constexpr int simd_double_width = 8;
+constexpr int simd_float_width  = 16;
+
+struct vmask  { __mmask8 m; };
+struct vdouble { __m512d v; };
+
+inline vdouble vload(const double* p)        { return { _mm512_loadu_pd(p) }; }
+inline vdouble vset1(double x)               { return { _mm512_set1_pd(x) }; }
+inline vdouble viota(double base)            { return { _mm512_add_pd(_mm512_set_pd(7,6,5,4,3,2,1,0), _mm512_set1_pd(base)) }; }
+inline void    vstore(double* p, vdouble a)  { _mm512_storeu_pd(p, a.v); }
+
+inline vdouble operator+(vdouble a, vdouble b) { return { _mm512_add_pd(a.v, b.v) }; }
+inline vdouble operator-(vdouble a, vdouble b) { return { _mm512_sub_pd(a.v, b.v) }; }
+inline vdouble operator*(vdouble a, vdouble b) { return { _mm512_mul_pd(a.v, b.v) }; }
+inline vdouble operator/(vdouble a, vdouble b) { return { _mm512_div_pd(a.v, b.v) }; }
+inline vdouble vsqrt(vdouble a)                { return { _mm512_sqrt_pd(a.v) }; }
+inline vdouble vmax(vdouble a, vdouble b)      { return { _mm512_max_pd(a.v, b.v) }; }
+inline vdouble vmin(vdouble a, vdouble b)      { return { _mm512_min_pd(a.v, b.v) }; }
+
+inline vmask operator<(vdouble a, vdouble b)   { return { _mm512_cmp_pd_mask(a.v, b.v, _CMP_LT_OQ) }; }
+inline vmask operator>(vdouble a, vdouble b)   { return { _mm512_cmp_pd_mask(a.v, b.v, _CMP_GT_OQ) }; }
+inline vmask operator>=(vdouble a, vdouble b)  { return { _mm512_cmp_pd_mask(a.v, b.v, _CMP_GE_OQ) }; }
+inline vmask operator&(vmask a, vmask b)       { return { __mmask8(a.m & b.m) }; }
+inline vmask operator|(vmask a, vmask b)       { return { __mmask8(a.m | b.m) }; }
+inline bool  vany(vmask a)                     { return a.m != 0; }
+
+// Para cada lane: m ? a : b
+inline vdouble vselect(vmask m, vdouble a, vdouble b) { return { _mm512_mask_blend_pd(m.m, b.v, a.v) }; }
+
+struct vmaskf { __mmask16 m; };
+struct vfloat { __m512 v; };
+
+inline vfloat vload(const float* p)          { return { _mm512_loadu_ps(p) }; }
+inline vfloat vset1(float x)                 { return { _mm512_set1_ps(x) }; }
+inline vfloat viota(float base)              { return { _mm512_add_ps(_mm512_set_ps(15,14,13,12,11,10,9,8,7,6,5,4,3,2,1,0), _mm512_set1_ps(base)) }; }
+inline void   vstore(float* p, vfloat a)     { _mm512_storeu_ps(p, a.v); }
+
+inline vfloat operator+(vfloat a, vfloat b)  { return { _mm512_add_ps(a.v, b.v) }; }
+inline vfloat operator-(vfloat a, vfloat b)  { return { _mm512_sub_ps(a.v, b.v) }; }
+inline vfloat operator*(vfloat a, vfloat b)  { return { _mm512_mul_ps(a.v, b.v) }; }
+inline vfloat operator/(vfloat a, vfloat b)  { return { _mm512_div_ps(a.v, b.v) }; }
+inline vfloat vsqrt(vfloat a)                { return { _mm512_sqrt_ps(a.v) }; }
+inline vfloat vmax(vfloat a, vfloat b)       { return { _mm512_max_ps(a.v, b.v) }; }
+inline vfloat vmin(vfloat a, vfloat b)       { return { _mm512_min_ps(a.v, b.v) }; }
+
+inline vmaskf operator<(vfloat a, vfloat b)  { return { _mm512_cmp_ps_mask(a.v, b.v, _CMP_LT_OQ) }; }
+inline vmaskf operator>(vfloat a, vfloat b)  { return { _mm512_cmp_ps_mask(a.v, b.v, _CMP_GT_OQ) }; }
+inline vmaskf operator>=(vfloat a, vfloat b) { return { _mm512_cmp_ps_mask(a.v, b.v, _CMP_GE_OQ) }; }
+inline vmaskf operator&(vmaskf a, vmaskf b)  { return { __mmask16(a.m & b.m) }; }
+inline vmaskf operator|(vmaskf a, vmaskf b)  { return { __mmask16(a.m | b.m) }; }
+inline bool   vany(vmaskf a)                 { return a.m != 0; }
+
+inline vfloat vselect(vmaskf m, vfloat a, vfloat b) { return { _mm512_mask_blend_ps(m.m, b.v, a.v) }; }
+
+#elif defined(__AVX__)
+
+constexpr int simd_double_width = 4;
+constexpr int simd_float_width  = 8;
+
+struct vmask { __m256d m; };
+struct vdouble { __m256d v; };
+
+inline vdouble vload(const double* p)        { return { _mm256_loadu_pd(p) }; }
+inline vdouble vset1(double x)               { return { _mm256_set1_pd(x) }; }
+inline vdouble viota(double base)            { return { _mm256_add_pd(_mm256_set_pd(3,2,1,0), _mm256_set1_pd(base)) }; }
+inline void    vstore(double* p, vdouble a)  { _mm256_storeu_pd(p, a.v); }
+
+inline vdouble operator+(vdouble a, vdouble b) { return { _mm256_add_pd(a.v, b.v) }; }
+inline vdouble operator-(vdouble a, vdouble b) { return { _mm256_sub_pd(a.v, b.v) }; }
+inline vdouble operator*(vdouble a, vdouble b) { return { _mm256_mul_pd(a.v, b.v) }; }
+inline vdouble operator/(vdouble a, vdouble b) { return { _mm256_div_pd(a.v, b.v) }; }
+inline vdouble vsqrt(vdouble a)                { return { _mm256_sqrt_pd(a.v) }; }
+inline vdouble vmax(vdouble a, vdouble b)      { return { _mm256_max_pd(a.v, b.v) }; }
+inline vdouble vmin(vdouble a, vdouble b)      { return { _mm256_min_pd(a.v, b.v) }; }
+
+inline vmask operator<(vdouble a, vdouble b)   { return { _mm256_cmp_pd(a.v, b.v, _CMP_LT_OQ) }; }
+inline vmask operator>(vdouble a, vdouble b)   { return { _mm256_cmp_pd(a.v, b.v, _CMP_GT_OQ) }; }
+inline vmask operator>=(vdouble a, vdouble b)  { return { _mm256_cmp_pd(a.v, b.v, _CMP_GE_OQ) }; }
+inline vmask operator&(vmask a, vmask b)       { return { _mm256_and_pd(a.m, b.m) }; }
+inline vmask operator|(vmask a, vmask b)       { return { _mm256_or_pd(a.m, b.m) }; }
+inline bool  vany(vmask a)                     { return _mm256_movemask_pd(a.m) != 0; }
+
+inline vdouble vselect(vmask m, vdouble a, vdouble b) { return { _mm256_blendv_pd(b.v, a.v, m.m) }; }
+
+struct vmaskf { __m256 m; };
+struct vfloat { __m256 v; };
+
+inline vfloat vload(const float* p)          { return { _mm256_loadu_ps(p) }; }
+inline vfloat vset1(float x)                 { return { _mm256_set1_ps(x) }; }
+inline vfloat viota(float base)              { return { _mm256_add_ps(_mm256_set_ps(7,6,5,4,3,2,1,0), _mm256_set1_ps(base)) }; }
+inline void   vstore(float* p, vfloat a)     { _mm256_storeu_ps(p, a.v); }
+
+inline vfloat operator+(vfloat a, vfloat b)  { return { _mm256_add_ps(a.v, b.v) }; }
+inline vfloat operator-(vfloat a, vfloat b)  { return { _mm256_sub_ps(a.v, b.v) }; }
+inline vfloat operator*(vfloat a, vfloat b)  { return { _mm256_mul_ps(a.v, b.v) }; }
+inline vfloat operator/(vfloat a, vfloat b)  { return { _mm256_div_ps(a.v, b.v) }; }
+inline vfloat vsqrt(vfloat a)                { return { _mm256_sqrt_ps(a.v) }; }
+inline vfloat vmax(vfloat a, vfloat b)       { return { _mm256_max_ps(a.v, b.v) }; }
+inline vfloat vmin(vfloat a, vfloat b)       { return { _mm256_min_ps(a.v, b.v) }; }
+
+inline vmaskf operator<(vfloat a, vfloat b)  { return { _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) }; }
+inline vmaskf operator>(vfloat a, vfloat b)  { return { _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ) }; }
+inline vmaskf operator>=(vfloat a, vfloat b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ) }; }
+inline vmaskf operator&(vmaskf a, vmaskf b)  { return { _mm256_and_ps(a.m, b.m) }; }
+inline vmaskf operator|(vmaskf a, vmaskf b)  { return { _mm256_or_ps(a.m, b.m) }; }
+inline bool   vany(vmaskf a)                 { return _mm256_movemask_ps(a.m) != 0; }
+
+inline vfloat vselect(vmaskf m, vfloat a, vfloat b) { return { _mm256_blendv_ps(b.v, a.v, m.m) }; }
+
+#elif defined(__SSE2__) || defined(_M_X64)
+
+constexpr int simd_double_width = 2;
+constexpr int simd_float_width  = 4;
+
+struct vmask { __m128d m; };
+struct vdouble { __m128d v; };
+
+inline vdouble vload(const double* p)        { return { _mm_loadu_pd(p) }; }
+inline vdouble vset1(double x)               { return { _mm_set1_pd(x) }; }
+inline vdouble viota(double base)            { return { _mm_add_pd(_mm_set_pd(1,0), _mm_set1_pd(base)) }; }
+inline void    vstore(double* p, vdouble a)  { _mm_storeu_pd(p, a.v); }
+
+inline vdouble operator+(vdouble a, vdouble b) { return { _mm_add_pd(a.v, b.v) }; }
+inline vdouble operator-(vdouble a, vdouble b) { return { _mm_sub_pd(a.v, b.v) }; }
+inline vdouble operator*(vdouble a, vdouble b) { return { _mm_mul_pd(a.v, b.v) }; }
+inline vdouble operator/(vdouble a, vdouble b) { return { _mm_div_pd(a.v, b.v) }; }
+inline vdouble vsqrt(vdouble a)                { return { _mm_sqrt_pd(a.v) }; }
+inline vdouble vmax(vdouble a, vdouble b)      { return { _mm_max_pd(a.v, b.v) }; }
+inline vdouble vmin(vdouble a, vdouble b)      { return { _mm_min_pd(a.v, b.v) }; }
+
+inline vmask operator<(vdouble a, vdouble b)   { return { _mm_cmplt_pd(a.v, b.v) }; }
+inline vmask operator>(vdouble a, vdouble b)   { return { _mm_cmpgt_pd(a.v, b.v) }; }
+inline vmask operator>=(vdouble a, vdouble b)  { return { _mm_cmpge_pd(a.v, b.v) }; }
+inline vmask operator&(vmask a, vmask b)       { return { _mm_and_pd(a.m, b.m) }; }
+inline vmask operator|(vmask a, vmask b)       { return { _mm_or_pd(a.m, b.m) }; }
+inline bool  vany(vmask a)                     { return _mm_movemask_pd(a.m) != 0; }
+
+// SSE2 não tem blendv, então a seleção é feita com máscaras de bits
+inline vdouble vselect(vmask m, vdouble a, vdouble b) {
+    return { _mm_or_pd(_mm_and_pd(m.m, a.v), _mm_andnot_pd(m.m, b.v)) };
+}
+
+struct vmaskf { __m128 m; };
+struct vfloat { __m128 v; };
+
+inline vfloat vload(const float* p)          { return { _mm_loadu_ps(p) }; }
+inline vfloat vset1(float x)                 { return { _mm_set1_ps(x) }; }
+inline vfloat viota(float base)              { return { _mm_add_ps(_mm_set_ps(3,2,1,0), _mm_set1_ps(base)) }; }
+inline void   vstore(float* p, vfloat a)     { _mm_storeu_ps(p, a.v); }
+
+inline vfloat operator+(vfloat a, vfloat b)  { return { _mm_add_ps(a.v, b.v) }; }
+inline vfloat operator-(vfloat a, vfloat b)  { return { _mm_sub_ps(a.v, b.v) }; }
+inline vfloat operator*(vfloat a, vfloat b)  { return { _mm_mul_ps(a.v, b.v) }; }
+inline vfloat operator/(vfloat a, vfloat b)  { return { _mm_div_ps(a.v, b.v) }; }
+inline vfloat vsqrt(vfloat a)                { return { _mm_sqrt_ps(a.v) }; }
+inline vfloat vmax(vfloat a, vfloat b)       { return { _mm_max_ps(a.v, b.v) }; }
+inline vfloat vmin(vfloat a, vfloat b)       { return { _mm_min_ps(a.v, b.v) }; }
+
+inline vmaskf operator<(vfloat a, vfloat b)  { return { _mm_cmplt_ps(a.v, b.v) }; }
+inline vmaskf operator>(vfloat a, vfloat b)  { return { _mm_cmpgt_ps(a.v, b.v) }; }
+inline vmaskf operator>=(vfloat a, vfloat b) { return { _mm_cmpge_ps(a.v, b.v) }; }
+inline vmaskf operator&(vmaskf a, vmaskf b)  { return { _mm_and_ps(a.m, b.m) }; }
+inline vmaskf operator|(vmaskf a, vmaskf b)  { return { _mm_or_ps(a.m, b.m) }; }
+inline bool   vany(vmaskf a)                 { return _mm_movemask_ps(a.m) != 0; }
+
+inline vfloat vselect(vmaskf m, vfloat a, vfloat b) {
+    return { _mm_or_ps(_mm_and_ps(m.m, a.v), _mm_andnot_ps(m.m, b.v)) };
+}
+
+#else
+
+constexpr int simd_double_width = 1;
+constexpr int simd_float_width  = 1;
+
+struct vmask { bool m; };
+struct vdouble { double v; };
+
+inline vdouble vload(const double* p)        { return { *p }; }
+inline vdouble vset1(double x)               { return { x }; }
+inline vdouble viota(double base)            { return { base }; }
+inline void    vstore(double* p, vdouble a)  { *p = a.v; }
+
+inline vdouble operator+(vdouble a, vdouble b) { return { a.v + b.v }; }
+inline vdouble operator-(vdouble a, vdouble b) { return { a.v - b.v }; }
+inline vdouble operator*(vdouble a, vdouble b) { return { a.v * b.v }; }
+inline vdouble operator/(vdouble a, vdouble b) { return { a.v / b.v }; }
+inline vdouble vsqrt(vdouble a)                { return { std::sqrt(a.v) }; }
+inline vdouble vmax(vdouble a, vdouble b)      { return { a.v > b.v ? a.v : b.v }; }
+inline vdouble vmin(vdouble a, vdouble b)      { return { a.v < b.v ? a.v : b.v }; }
+
+inline vmask operator<(vdouble a, vdouble b)   { return { a.v < b.v }; }
+inline vmask operator>(vdouble a, vdouble b)   { return { a.v > b.v }; }
+inline vmask operator>=(vdouble a, vdouble b)  { return { a.v >= b.v }; }
+inline vmask operator&(vmask a, vmask b)       { return { a.m && b.m }; }
+inline vmask operator|(vmask a, vmask b)       { return { a.m || b.m }; }
+inline bool  vany(vmask a)                     { return a.m; }
+
+inline vdouble vselect(vmask m, vdouble a, vdouble b) { return { m.m ? a.v : b.v }; }
+
+struct vmaskf { bool m; };
+struct vfloat { float v; };
+
+inline vfloat vload(const float* p)          { return { *p }; }
+inline vfloat vset1(float x)                 { return { x }; }
+inline vfloat viota(float base)              { return { base }; }
+inline void   vstore(float* p, vfloat a)     { *p = a.v; }
+
+inline vfloat operator+(vfloat a, vfloat b)  { return { a.v + b.v }; }
+inline vfloat operator-(vfloat a, vfloat b)  { return { a.v - b.v }; }
+inline vfloat operator*(vfloat a, vfloat b)  { return { a.v * b.v }; }
+inline vfloat operator/(vfloat a, vfloat b)  { return { a.v / b.v }; }
+inline vfloat vsqrt(vfloat a)                { return { std::sqrt(a.v) }; }
+inline vfloat vmax(vfloat a, vfloat b)       { return { a.v > b.v ? a.v : b.v }; }
+inline vfloat vmin(vfloat a, vfloat b)       { return { a.v < b.v ? a.v : b.v }; }
+
+inline vmaskf operator<(vfloat a, vfloat b)  { return { a.v < b.v }; }
+inline vmaskf operator>(vfloat a, vfloat b)  { return { a.v > b.v }; }
+inline vmaskf operator>=(vfloat a, vfloat b) { return { a.v >= b.v }; }
+inline vmaskf operator&(vmaskf a, vmaskf b)  { return { a.m && b.m }; }
+inline vmaskf operator|(vmaskf a, vmaskf b)  { return { a.m || b.m }; }
+inline bool   vany(vmaskf a)                 { return a.m; }
+
+inline vfloat vselect(vmaskf m, vfloat a, vfloat b) { return { m.m ? a.v : b.v }; }
+
+#endif
+
+
+#ifdef RT_USE_FLOAT
+using vreal = vfloat;
+constexpr int simd_width = simd_float_width;
+#else
+using vreal = vdouble;
+constexpr int simd_width = simd_double_width;
+#endif
+
+#endif
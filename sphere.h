@@ -2,48 +2,87 @@
 #define SPHERE_H
 
 #include "hittable.h"
+#include "render_stats.h"
 #include "rtweekend.h"
 
 
+// Raízes da interseção entre o raio o + t*d e a esfera (centro - o = oc, raio r),
+// em ordem crescente. Retorna false se o raio não passa pela esfera.
+//
+// O discriminante h² - a·c é calculado como a·(r² - |l|²), onde l vai do ponto
+// do raio mais próximo ao centro, e as raízes usam q = h ± sqrt(discriminante)
+// com o sinal de h. As duas formas evitam o cancelamento catastrófico da fórmula
+// direta em esferas grandes ou distantes, o que importa principalmente em float.
+template <typename T>
+inline bool sphere_roots(const basic_vec3<T>& oc, const basic_vec3<T>& d, T radius, T& root0, T& root1) {
+    auto a = d.length_squared();
+    auto h = dot(d, oc);
+    auto c = oc.length_squared() - radius*radius;
+
+    basic_vec3<T> l = oc - (h/a) * d;
+    auto discriminant = a * (radius*radius - l.length_squared());
+    if (discriminant < 0)
+        return false;
+
+    auto sqrtd = std::sqrt(discriminant);
+    auto q = (h < 0) ? h - sqrtd : h + sqrtd;
+    root0 = c / q;
+    root1 = q / a;
+    if (root0 > root1)
+        std::swap(root0, root1);
+    return true;
+}
+
+// Preenche rec para um acerto em t. O ponto é projetado de volta na superfície,
+// o que limita o seu erro a poucas unidades de arredondamento das coordenadas
+// do centro e do raio, e esse limite vai para rec.error.
+template <typename T>
+inline void sphere_hit_record(const basic_ray<T>& r, T t, const basic_vec3<T>& center, T radius,
+                              material_id mat, basic_hit_record<T>& rec) {
+    basic_vec3<T> outward_normal = unit_vector(r.at(t) - center);
+    rec.t = t;
+    rec.p = center + radius * outward_normal;
+    rec.error = rounding_error<T>(5) * (std::fmax(std::fabs(center.x()), std::fmax(std::fabs(center.y()),
+                                        std::fabs(center.z()))) + radius);
+    rec.set_face_normal(r, outward_normal);
+    rec.mat = mat;
+}
+
+
 class sphere : public hittable {
   private:
     point3 center;
-    double radius;
-    shared_ptr<material> mat;
+    real radius;
+    material_id mat;
+    aabb bbox;
 
   public:
-  sphere(const point3& center, double radius, shared_ptr<material> mat)
-  : center(center), radius(std::fmax(0,radius)), mat(mat) {}
+  sphere(const point3& center, double radius, material_id mat)
+  : center(center), radius(real(std::fmax(0,radius))), mat(mat)
+  {
+      auto rvec = vec3(this->radius, this->radius, this->radius);
+      bbox = aabb(center - rvec, center + rvec);
+  }
 
     bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
-        vec3 oc = center - r.origin();
-        auto a = r.direction().length_squared();
-        auto h = dot(r.direction(), oc);
-        auto c = oc.length_squared() - radius*radius;
-
-        auto discriminant = h*h - a*c;
-        if (discriminant < 0)
+        RT_STAT(intersection_tests++);
+        real root0, root1;
+        if (!sphere_roots(center - r.origin(), r.direction(), radius, root0, root1))
             return false;
 
-        auto sqrtd = std::sqrt(discriminant);
-
         // Acha a root mais próxima que se encontra no range.
-        auto root = (h - sqrtd) / a;
+        auto root = root0;
         if (!ray_t.surrounds(root)) {
-            root = (h + sqrtd) / a;
+            root = root1;
             if (!ray_t.surrounds(root))
                 return false;
         }
 
-        rec.t = root;
-        rec.p = r.at(rec.t);
-        vec3 outward_normal = (rec.p - center) / radius;
-        rec.set_face_normal(r, outward_normal);
-        rec.mat = mat;
-
-
+        sphere_hit_record(r, root, center, radius, mat, rec);
         return true;
     }
+
+    aabb bounding_box() const override { return bbox; }
 };
 
-#endif
\ No newline at end of file
+#endif
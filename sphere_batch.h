@@ -0,0 +1,213 @@
+#ifndef SPHERE_BATCH_H
+#define SPHERE_BATCH_H
+
+#include "bvh.h"
+#include "hittable.h"
+#include "render_stats.h"
+#include "rtweekend.h"
+#include "simd.h"
+#include "sphere.h"
+
+#include <vector>
+
+
+// Conjunto de esferas guardado como estrutura de arrays (SoA): centros, raios e
+// índices de material ficam em vetores separados. Uma BVH interna agrupa as
+// esferas em folhas contíguas, e cada folha é testada contra o raio com
+// instruções SIMD, simd_width esferas por vez, sem chamada virtual por esfera.
+//
+// Depois de adicionar as esferas é preciso chamar build() antes de renderizar.
+class sphere_batch : public hittable {
+  public:
+    void add(const point3& center, double r, material_id mat) {
+        cx.resize(count);
+        cy.resize(count);
+        cz.resize(count);
+        radius.resize(count);
+
+        cx.push_back(center.x());
+        cy.push_back(center.y());
+        cz.push_back(center.z());
+        radius.push_back(real(std::fmax(0, r)));
+        mat_index.push_back(mat);
+        count++;
+    }
+
+    size_t size() const { return count; }
+
+    // Constrói a BVH interna e reordena os arrays na ordem das folhas
+    void build() {
+        cx.resize(count);
+        cy.resize(count);
+        cz.resize(count);
+        radius.resize(count);
+
+        std::vector<aabb> boxes(count);
+        for (size_t k = 0; k < count; k++) {
+            auto rvec = vec3(radius[k], radius[k], radius[k]);
+            auto center = point3(cx[k], cy[k], cz[k]);
+            boxes[k] = aabb(center - rvec, center + rvec);
+        }
+
+        // Folhas com até dois vetores SIMD de esferas
+        tree.build(boxes, 2 * simd_width, simd_width);
+
+        permute(cx);
+        permute(cy);
+        permute(cz);
+        permute(radius);
+        permute(mat_index);
+
+        // Espaço extra no fim para que a última carga SIMD não leia fora do vetor
+        cx.resize(count + simd_width, 0);
+        cy.resize(count + simd_width, 0);
+        cz.resize(count + simd_width, 0);
+        radius.resize(count + simd_width, 0);
+
+        bbox = tree.bounds();
+    }
+
+    // Arrays internos, já na ordem das folhas da BVH
+    struct arrays {
+        size_t count;
+        const real *cx, *cy, *cz, *radius;
+        const material_id* mat;
+        const bvh_node* nodes;
+        size_t node_count;
+    };
+
+    arrays data() const {
+        return { count, cx.data(), cy.data(), cz.data(), radius.data(), mat_index.data(),
+                 tree.nodes.data(), tree.nodes.size() };
+    }
+
+    // Restaura um batch a partir de arrays e nós de BVH prontos (por exemplo,
+    // lidos de um arquivo de cena binário), sem reconstruir a BVH
+    void restore(const arrays& src) {
+        count = src.count;
+        cx.assign(src.cx, src.cx + count);
+        cy.assign(src.cy, src.cy + count);
+        cz.assign(src.cz, src.cz + count);
+        radius.assign(src.radius, src.radius + count);
+        mat_index.assign(src.mat, src.mat + count);
+        tree.nodes.assign(src.nodes, src.nodes + src.node_count);
+        tree.order.clear();
+
+        cx.resize(count + simd_width, 0);
+        cy.resize(count + simd_width, 0);
+        cz.resize(count + simd_width, 0);
+        radius.resize(count + simd_width, 0);
+
+        bbox = tree.bounds();
+    }
+
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        return tree.traverse(r, ray_t, [&](uint32_t first, uint32_t n, interval& t) {
+            real t_hit;
+            int k = nearest(r, t, first, n, t_hit);
+            if (k < 0)
+                return false;
+
+            sphere_hit_record(r, t_hit, point3(cx[k], cy[k], cz[k]), radius[k], mat_index[k], rec);
+
+            t.max = t_hit;
+            return true;
+        });
+    }
+
+    bool hit_any(const ray& r, interval ray_t) const override {
+        return tree.occluded(r, ray_t, [&](uint32_t first, uint32_t n, interval& t) {
+            real t_hit;
+            return nearest(r, t, first, n, t_hit) >= 0;
+        });
+    }
+
+    aabb bounding_box() const override { return bbox; }
+
+  private:
+    size_t count = 0;
+    std::vector<real> cx, cy, cz, radius;
+    std::vector<material_id> mat_index;
+    bvh_tree tree;
+    aabb bbox;
+
+    template <typename T>
+    void permute(std::vector<T>& values) const {
+        std::vector<T> sorted(values.size());
+        for (size_t k = 0; k < tree.order.size(); k++)
+            sorted[k] = values[tree.order[k]];
+        values.swap(sorted);
+    }
+
+    // Testa o raio contra as esferas [first, first+n) e retorna o índice da
+    // interseção mais próxima dentro de ray_t (ou -1), com o t em t_hit.
+    // É a mesma conta de sphere_roots, feita em simd_width esferas por vez.
+    int nearest(const ray& r, const interval& ray_t, uint32_t first, uint32_t n, real& t_hit) const {
+        RT_STAT(intersection_tests += n);
+        const point3& o = r.origin();
+        const vec3& d = r.direction();
+
+        const vreal ox = vset1(o.x()), oy = vset1(o.y()), oz = vset1(o.z());
+        const vreal dx = vset1(d.x()), dy = vset1(d.y()), dz = vset1(d.z());
+        const vreal a = vset1(d.length_squared());
+        const vreal tmin = vset1(ray_t.min), tmax = vset1(ray_t.max);
+        const vreal zero = vset1(real(0));
+        const vreal end = vset1(real(n));
+
+        // As lanes guardam a posição relativa a 'first', que é pequena e
+        // portanto exata mesmo em float
+        vreal best_t = vset1(std::numeric_limits<real>::infinity());
+        vreal best_k = vset1(real(-1));
+
+        for (uint32_t k = first; k < first + n; k += simd_width) {
+            vreal lane = viota(real(k - first));
+
+            vreal ocx = vload(&cx[k]) - ox;
+            vreal ocy = vload(&cy[k]) - oy;
+            vreal ocz = vload(&cz[k]) - oz;
+            vreal rad = vload(&radius[k]);
+
+            vreal h = dx*ocx + dy*ocy + dz*ocz;
+            vreal c = ocx*ocx + ocy*ocy + ocz*ocz - rad*rad;
+
+            vreal s = h / a;
+            vreal lx = ocx - s*dx, ly = ocy - s*dy, lz = ocz - s*dz;
+            vreal discriminant = a * (rad*rad - (lx*lx + ly*ly + lz*lz));
+
+            auto valid = (discriminant >= zero) & (lane < end);
+            if (!vany(valid))
+                continue;
+
+            vreal sqrtd = vsqrt(vmax(discriminant, zero));
+            vreal q = vselect(h < zero, h - sqrtd, h + sqrtd);
+            vreal ra = c / q, rb = q / a;
+            vreal root0 = vmin(ra, rb), root1 = vmax(ra, rb);
+
+            // Prefere a raiz mais próxima; usa a outra se a primeira estiver fora do intervalo
+            auto in0 = (root0 > tmin) & (root0 < tmax);
+            auto in1 = (root1 > tmin) & (root1 < tmax);
+            vreal root = vselect(in0, root0, root1);
+
+            auto closer = valid & (in0 | in1) & (root < best_t);
+            best_t = vselect(closer, root, best_t);
+            best_k = vselect(closer, lane, best_k);
+        }
+
+        // Redução horizontal entre as lanes
+        real ts[simd_width], ks[simd_width];
+        vstore(ts, best_t);
+        vstore(ks, best_k);
+
+        int best = -1;
+        t_hit = std::numeric_limits<real>::infinity();
+        for (int l = 0; l < simd_width; l++) {
+            if (ks[l] >= 0 && ts[l] < t_hit) {
+                t_hit = ts[l];
+                best = int(first) + int(ks[l]);
+            }
+        }
+        return best;
+    }
+};
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef STREAMED_IMAGE_H
+#define STREAMED_IMAGE_H
+
+#include "color.h"
+#include "framebuffer.h"
+#include "image_writer.h"
+#include "mapped_file.h"
+
+#include <cstring>
+#include <string>
+
+// Imagem gravada direto num arquivo mapeado em memória, para renders maiores
+// que a memória (camera::render_streamed). O arquivo é criado já com o tamanho
+// final, cada tile é convertido e escrito no seu lugar assim que fica pronto,
+// e as faixas de linhas terminadas são gravadas no disco e tiradas da memória
+// do processo (flush_rows). Só os formatos sem compressão, em que cada pixel
+// tem posição fixa, funcionam assim: PPM binário e PFM.
+class streamed_image {
+  public:
+    ~streamed_image() { file.close(); }
+
+    bool create(const std::string& path, int width, int height, image_format format, std::string& error) {
+        if (format != image_format::ppm && format != image_format::pfm) {
+            error = path + ": a saída direta para o arquivo só funciona com .ppm (P6) ou .pfm";
+            return false;
+        }
+        this->width = width;
+        this->height = height;
+        this->format = format;
+        std::string text = format == image_format::ppm ? ppm_header(width, height) : pfm_header(width, height);
+        header = text.size();
+        pixel_bytes = format == image_format::ppm ? 3 : 3 * sizeof(float);
+
+        if (!file.create(path, header + size_t(width) * size_t(height) * pixel_bytes)) {
+            error = "não foi possível criar " + path + " com " + std::to_string(width) + 'x'
+                  + std::to_string(height) + " pixels (falta de espaço em disco?)";
+            return false;
+        }
+        std::memcpy(file.writable_data(), text.data(), header);
+        return true;
+    }
+
+    // Escreve as cores lineares de 'tile' com o canto superior esquerdo em (x0, y0)
+    void write_tile(int x0, int y0, const framebuffer& tile) {
+        char* out = file.writable_data();
+        for (int j = 0; j < tile.height; j++) {
+            const float* in = &tile.pixels[size_t(j) * tile.width * 3];
+            char* row = out + row_offset(y0 + j) + size_t(x0) * pixel_bytes;
+            if (format == image_format::pfm) {
+                std::memcpy(row, in, size_t(tile.width) * pixel_bytes);
+            } else {
+                for (int k = 0; k < tile.width * 3; k++)
+                    row[k] = char(to_byte(in[k]));
+            }
+        }
+    }
+
+    // Grava no disco as linhas [y0, y1), já completas, e libera a memória delas
+    bool flush_rows(int y0, int y1) {
+        // O PFM guarda as linhas de baixo para cima, mas a faixa continua contígua
+        size_t first = format == image_format::pfm ? row_offset(y1 - 1) : row_offset(y0);
+        return file.sync(first, size_t(y1 - y0) * row_bytes(), true);
+    }
+
+    // Termina o arquivo. Retorna false se ele não pôde ser gravado.
+    bool close() { return file.close(); }
+
+  private:
+    mapped_file  file;
+    int          width = 0;
+    int          height = 0;
+    image_format format = image_format::ppm;
+    size_t       header = 0;
+    size_t       pixel_bytes = 0;
+
+    size_t row_bytes() const { return size_t(width) * pixel_bytes; }
+
+    size_t row_offset(int j) const {
+        size_t row = format == image_format::pfm ? size_t(height - 1 - j) : size_t(j);
+        return header + row * row_bytes();
+    }
+};
+
+#endif
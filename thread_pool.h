@@ -0,0 +1,157 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// Pool de threads com roubo de trabalho (work stealing).
+// Cada thread tem a sua própria fila de tarefas; quando ela esvazia, a thread
+// rouba tarefas do fim da fila de outra thread. A thread que chama run()
+// também trabalha, como a thread 0.
+class thread_pool {
+  public:
+    // num_threads <= 0 usa a variável de ambiente RT_THREADS, se existir,
+    // ou o número de núcleos da máquina
+    explicit thread_pool(int num_threads = 0) {
+        if (num_threads <= 0)
+            num_threads = default_thread_count();
+
+        for (int i = 0; i < num_threads; i++)
+            queues.push_back(std::make_unique<work_queue>());
+
+        for (int i = 1; i < num_threads; i++)
+            workers.emplace_back([this, i] { worker_loop(i); });
+    }
+
+    ~thread_pool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers)
+            worker.join();
+    }
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    // Número de threads que executam tarefas (incluindo a que chama run)
+    int size() const { return int(queues.size()); }
+
+    // Executa task(i, worker) para cada i em [0, task_count) e só retorna quando
+    // todas as tarefas terminarem. As tarefas começam divididas em blocos
+    // contíguos, um por thread, para manter tiles vizinhos na mesma thread.
+    void run(int task_count, const std::function<void(int task, int worker)>& task) {
+        if (task_count <= 0)
+            return;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &task;
+            pending = task_count;
+
+            int n = size();
+            for (int w = 0; w < n; w++) {
+                std::lock_guard<std::mutex> queue_lock(queues[w]->mutex);
+                for (int t = task_count * w / n; t < task_count * (w+1) / n; t++)
+                    queues[w]->tasks.push_back(t);
+            }
+            generation++;
+        }
+        wake.notify_all();
+
+        execute(0);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return pending == 0; });
+        job = nullptr;
+    }
+
+    static int default_thread_count() {
+        if (const char* env = std::getenv("RT_THREADS")) {
+            int n = std::atoi(env);
+            if (n > 0)
+                return n;
+        }
+        int n = int(std::thread::hardware_concurrency());
+        return (n > 0) ? n : 1;
+    }
+
+  private:
+    struct work_queue {
+        std::mutex mutex;
+        std::deque<int> tasks;
+    };
+
+    std::vector<std::unique_ptr<work_queue>> queues;
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable wake;  // Acorda as threads quando há trabalho novo
+    std::condition_variable done;  // Avisa run() que todas as tarefas terminaram
+    const std::function<void(int, int)>* job = nullptr;
+    std::atomic<int> pending{0};
+    unsigned long generation = 0;
+    bool stopping = false;
+
+    // Pega a próxima tarefa da própria fila (pela frente) ou rouba de outra (pelo fim)
+    bool next_task(int worker, int& task) {
+        {
+            auto& own = *queues[worker];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty()) {
+                task = own.tasks.front();
+                own.tasks.pop_front();
+                return true;
+            }
+        }
+
+        int n = size();
+        for (int k = 1; k < n; k++) {
+            auto& victim = *queues[(worker + k) % n];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                task = victim.tasks.back();
+                victim.tasks.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void execute(int worker) {
+        int task;
+        while (next_task(worker, task)) {
+            (*job)(task, worker);
+            if (--pending == 0) {
+                std::lock_guard<std::mutex> lock(mutex);
+                done.notify_all();
+            }
+        }
+    }
+
+    void worker_loop(int worker) {
+        unsigned long seen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping)
+                    return;
+                seen = generation;
+            }
+            execute(worker);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,253 @@
+#ifndef TRIANGLE_MESH_H
+#define TRIANGLE_MESH_H
+
+#include "bvh.h"
+#include "hittable.h"
+#include "render_stats.h"
+#include "rtweekend.h"
+#include "simd.h"
+
+#include <cstdint>
+#include <vector>
+
+
+// Malha de triângulos indexada. Os vértices ficam num array plano (x, y, z
+// seguidos, na precisão do renderizador) e as normais, quando existem, num
+// array de floats paralelo; cada triângulo são três índices de vértice. Não há
+// um objeto por triângulo: uma BVH interna agrupa os triângulos em folhas
+// contíguas, e cada folha é testada com Möller–Trumbore em SIMD, simd_width
+// triângulos por vez (os vértices de cada grupo são reunidos antes do teste).
+//
+// Sem normais por vértice o sombreamento é plano, com a normal geométrica. Com
+// elas, a normal do acerto é a interpolada pelas coordenadas baricêntricas,
+// virada para o mesmo lado da normal geométrica.
+//
+// Depois de adicionar os triângulos é preciso chamar build() antes de renderizar.
+class triangle_mesh : public hittable {
+  public:
+    material_id mat = 0;  // Material de toda a malha
+
+    uint32_t add_vertex(const point3& p) {
+        positions.insert(positions.end(), { p.x(), p.y(), p.z() });
+        if (!normals.empty())
+            normals.insert(normals.end(), { 0.0f, 0.0f, 0.0f });
+        return uint32_t(positions.size() / 3 - 1);
+    }
+
+    // Vértice com normal. Vértices sem normal numa malha que tem normais ficam
+    // com normal nula e usam a normal geométrica.
+    uint32_t add_vertex(const point3& p, const vec3& n) {
+        if (normals.empty())
+            normals.resize(positions.size(), 0.0f);
+        positions.insert(positions.end(), { p.x(), p.y(), p.z() });
+        normals.insert(normals.end(), { float(n.x()), float(n.y()), float(n.z()) });
+        return uint32_t(positions.size() / 3 - 1);
+    }
+
+    void add_triangle(uint32_t a, uint32_t b, uint32_t c) {
+        indices.insert(indices.end(), { a, b, c });
+    }
+
+    size_t vertex_count() const { return positions.size() / 3; }
+    size_t triangle_count() const { return indices.size() / 3; }
+
+    // Constrói a BVH interna e reordena os triângulos na ordem das folhas
+    void build() {
+        size_t n = triangle_count();
+        std::vector<aabb> boxes(n);
+        for (size_t k = 0; k < n; k++) {
+            point3 a = vertex(indices[3*k]), b = vertex(indices[3*k + 1]), c = vertex(indices[3*k + 2]);
+            boxes[k] = aabb(aabb(a, b), aabb(c, c));
+        }
+
+        // Folhas com até dois vetores SIMD de triângulos, como no sphere_batch
+        tree.build(boxes, 2 * simd_width, simd_width);
+
+        std::vector<uint32_t> sorted(indices.size());
+        for (size_t k = 0; k < n; k++)
+            for (int j = 0; j < 3; j++)
+                sorted[3*k + j] = indices[3*size_t(tree.order[k]) + j];
+        indices.swap(sorted);
+        tree.order.clear();
+
+        bbox = tree.bounds();
+    }
+
+    // Arrays internos, com os triângulos já na ordem das folhas da BVH.
+    // 'normals' é nulo se a malha não tem normais por vértice.
+    struct arrays {
+        size_t vertex_count;
+        const real* positions;
+        const float* normals;
+        size_t triangle_count;
+        const uint32_t* indices;
+        const bvh_node* nodes;
+        size_t node_count;
+    };
+
+    arrays data() const {
+        return { vertex_count(), positions.data(), normals.empty() ? nullptr : normals.data(),
+                 triangle_count(), indices.data(), tree.nodes.data(), tree.nodes.size() };
+    }
+
+    // Restaura a malha a partir de arrays e nós de BVH prontos (por exemplo,
+    // lidos de um arquivo binário), sem reconstruir a BVH
+    void restore(const arrays& src) {
+        positions.assign(src.positions, src.positions + 3 * src.vertex_count);
+        if (src.normals)
+            normals.assign(src.normals, src.normals + 3 * src.vertex_count);
+        else
+            normals.clear();
+        indices.assign(src.indices, src.indices + 3 * src.triangle_count);
+        tree.nodes.assign(src.nodes, src.nodes + src.node_count);
+        tree.order.clear();
+        bbox = tree.bounds();
+    }
+
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        return tree.traverse(r, ray_t, [&](uint32_t first, uint32_t n, interval& t) {
+            real t_hit, u, v;
+            int k = nearest(r, t, first, n, t_hit, u, v);
+            if (k < 0)
+                return false;
+
+            set_hit_record(r, uint32_t(k), t_hit, u, v, rec);
+            t.max = t_hit;
+            return true;
+        });
+    }
+
+    bool hit_any(const ray& r, interval ray_t) const override {
+        return tree.occluded(r, ray_t, [&](uint32_t first, uint32_t n, interval& t) {
+            real t_hit, u, v;
+            return nearest(r, t, first, n, t_hit, u, v) >= 0;
+        });
+    }
+
+    aabb bounding_box() const override { return bbox; }
+
+  private:
+    std::vector<real> positions;
+    std::vector<float> normals;
+    std::vector<uint32_t> indices;
+    bvh_tree tree;
+    aabb bbox;
+
+    point3 vertex(uint32_t i) const {
+        return point3(positions[3*size_t(i)], positions[3*size_t(i) + 1], positions[3*size_t(i) + 2]);
+    }
+
+    // Testa o raio contra os triângulos [first, first+n) e retorna o índice da
+    // interseção mais próxima dentro de ray_t (ou -1), com t e as coordenadas
+    // baricêntricas u e v (dos vértices 1 e 2) do acerto
+    int nearest(const ray& r, const interval& ray_t, uint32_t first, uint32_t n,
+                real& t_hit, real& u_hit, real& v_hit) const {
+        RT_STAT(intersection_tests += n);
+        const point3& o = r.origin();
+        const vec3& d = r.direction();
+
+        const vreal ox = vset1(o.x()), oy = vset1(o.y()), oz = vset1(o.z());
+        const vreal dx = vset1(d.x()), dy = vset1(d.y()), dz = vset1(d.z());
+        const vreal tmin = vset1(ray_t.min), tmax = vset1(ray_t.max);
+        const vreal zero = vset1(real(0)), one = vset1(real(1));
+
+        vreal best_t = vset1(std::numeric_limits<real>::infinity());
+        vreal best_k = vset1(real(-1));
+        vreal best_u = zero, best_v = zero;
+
+        for (uint32_t k = first; k < first + n; k += simd_width) {
+            // Reúne o vértice 0 e as arestas de cada triângulo do grupo. As
+            // lanes além do fim da folha ficam com arestas nulas, que dão
+            // determinante zero e são descartadas.
+            alignas(64) real v0[3][simd_width] = {}, e1[3][simd_width] = {}, e2[3][simd_width] = {};
+            uint32_t lanes = std::min<uint32_t>(simd_width, first + n - k);
+            for (uint32_t l = 0; l < lanes; l++) {
+                const real* a = &positions[3*size_t(indices[3*size_t(k + l)])];
+                const real* b = &positions[3*size_t(indices[3*size_t(k + l) + 1])];
+                const real* c = &positions[3*size_t(indices[3*size_t(k + l) + 2])];
+                for (int j = 0; j < 3; j++) {
+                    v0[j][l] = a[j];
+                    e1[j][l] = b[j] - a[j];
+                    e2[j][l] = c[j] - a[j];
+                }
+            }
+            vreal e1x = vload(e1[0]), e1y = vload(e1[1]), e1z = vload(e1[2]);
+            vreal e2x = vload(e2[0]), e2y = vload(e2[1]), e2z = vload(e2[2]);
+
+            // p = d × e2, det = e1 · p
+            vreal px = dy*e2z - dz*e2y, py = dz*e2x - dx*e2z, pz = dx*e2y - dy*e2x;
+            vreal det = e1x*px + e1y*py + e1z*pz;
+            auto valid = (det > zero) | (det < zero);
+            if (!vany(valid))
+                continue;
+            vreal inv_det = one / det;
+
+            // s = o - v0, u = (s · p) / det
+            vreal sx = ox - vload(v0[0]), sy = oy - vload(v0[1]), sz = oz - vload(v0[2]);
+            vreal u = (sx*px + sy*py + sz*pz) * inv_det;
+
+            // q = s × e1, v = (d · q) / det, t = (e2 · q) / det
+            vreal qx = sy*e1z - sz*e1y, qy = sz*e1x - sx*e1z, qz = sx*e1y - sy*e1x;
+            vreal v = (dx*qx + dy*qy + dz*qz) * inv_det;
+            vreal t = (e2x*qx + e2y*qy + e2z*qz) * inv_det;
+
+            auto inside = (u >= zero) & (v >= zero) & (one >= u + v);
+            auto closer = valid & inside & (t > tmin) & (t < tmax) & (t < best_t);
+            if (!vany(closer))
+                continue;
+            best_t = vselect(closer, t, best_t);
+            best_k = vselect(closer, viota(real(k - first)), best_k);
+            best_u = vselect(closer, u, best_u);
+            best_v = vselect(closer, v, best_v);
+        }
+
+        // Redução horizontal entre as lanes
+        real ts[simd_width], ks[simd_width], us[simd_width], vs[simd_width];
+        vstore(ts, best_t);
+        vstore(ks, best_k);
+        vstore(us, best_u);
+        vstore(vs, best_v);
+
+        int best = -1;
+        t_hit = std::numeric_limits<real>::infinity();
+        for (int l = 0; l < simd_width; l++) {
+            if (ks[l] >= 0 && ts[l] < t_hit) {
+                t_hit = ts[l];
+                u_hit = us[l];
+                v_hit = vs[l];
+                best = int(first) + int(ks[l]);
+            }
+        }
+        return best;
+    }
+
+    // O ponto é calculado pelas coordenadas baricêntricas, e não por r.at(t):
+    // assim o seu erro só depende das coordenadas dos vértices
+    void set_hit_record(const ray& r, uint32_t k, real t, real u, real v, hit_record& rec) const {
+        uint32_t i0 = indices[3*size_t(k)], i1 = indices[3*size_t(k) + 1], i2 = indices[3*size_t(k) + 2];
+        point3 a = vertex(i0), b = vertex(i1), c = vertex(i2);
+        real w = 1 - u - v;
+
+        rec.t = t;
+        rec.p = w*a + u*b + v*c;
+        vec3 magnitude(std::fabs(w*a.x()) + std::fabs(u*b.x()) + std::fabs(v*c.x()),
+                       std::fabs(w*a.y()) + std::fabs(u*b.y()) + std::fabs(v*c.y()),
+                       std::fabs(w*a.z()) + std::fabs(u*b.z()) + std::fabs(v*c.z()));
+        rec.error = rounding_error<real>(7) * std::fmax(magnitude.x(), std::fmax(magnitude.y(), magnitude.z()));
+        rec.set_face_normal(r, unit_vector(cross(b - a, c - a)));
+        rec.mat = mat;
+
+        if (!normals.empty()) {
+            auto normal = [&](uint32_t i) {
+                return vec3(normals[3*size_t(i)], normals[3*size_t(i) + 1], normals[3*size_t(i) + 2]);
+            };
+            vec3 shading = w*normal(i0) + u*normal(i1) + v*normal(i2);
+            if (shading.length_squared() > 0) {
+                shading = unit_vector(shading);
+                rec.normal = dot(shading, rec.normal) < 0 ? -shading : shading;
+            }
+        }
+    }
+};
+
+#endif